@@ -0,0 +1,31 @@
+/*
+ * Copyright (c) 2022 Valentin B.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include "bench/bench_harness.hpp"
+
+namespace ptor::bench {
+
+    /* Byte and bit level decoding with `io::BinaryBuffer` and `util::Decode`. */
+    void RunIoBenchmarks(Runner &runner);
+
+    /* Decompression with `util::Inflater`. */
+    void RunZlibBenchmarks(Runner &runner);
+
+    /* File table parsing and end-to-end extraction of synthetic archives. */
+    void RunWadBenchmarks(Runner &runner);
+
+}
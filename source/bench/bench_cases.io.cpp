@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2022 Valentin B.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "bench/bench_cases.hpp"
+
+#include <bit>
+
+#include "gen/gen_content.hpp"
+#include "io/io_binary_buffer.hpp"
+#include "util/util_encoding.hpp"
+#include "util/util_literals.hpp"
+
+namespace ptor::bench {
+
+    namespace {
+
+        /* Small enough to stay in the L1 cache, so only decoding is measured. */
+        constexpr inline size_t BufferSize = 4_KB;
+
+        template <std::integral T, std::endian BO>
+        void RunReadValue(Runner &runner, const char *name, u8 *data) {
+            runner.Run(name, BufferSize, util::IFunction<void(u64)>::Make([data](u64 iterations) {
+                for (u64 i = 0; i < iterations; ++i) {
+                    /* Buffers over borrowed memory are cheap to set up, and rewinding keeps the bit offset. */
+                    io::BinaryBuffer buffer{data, BufferSize};
+
+                    T sum = 0;
+                    for (size_t j = 0; j < BufferSize / sizeof(T); ++j) {
+                        sum += buffer.ReadValue<T, BO>();
+                    }
+                    DoNotOptimize(sum);
+                }
+            }));
+        }
+
+        void RunReadBits(Runner &runner, const char *name, u8 *data, size_t bits) {
+            runner.Run(name, BufferSize, util::IFunction<void(u64)>::Make([data, bits](u64 iterations) {
+                for (u64 i = 0; i < iterations; ++i) {
+                    /* Buffers over borrowed memory are cheap to set up, and rewinding keeps the bit offset. */
+                    io::BinaryBuffer buffer{data, BufferSize};
+
+                    u32 sum = 0;
+                    for (size_t j = 0; j < BufferSize * BITSIZEOF(u8) / bits; ++j) {
+                        sum += buffer.ReadBits(bits);
+                    }
+                    DoNotOptimize(sum);
+                }
+            }));
+        }
+
+        template <typename T, std::endian BO>
+        void RunDecode(Runner &runner, const char *name, const u8 *data, size_t nbytes) {
+            runner.Run(name, BufferSize, util::IFunction<void(u64)>::Make([data, nbytes](u64 iterations) {
+                for (u64 i = 0; i < iterations; ++i) {
+                    T sum = 0;
+                    for (size_t offset = 0; offset + nbytes <= BufferSize; offset += nbytes) {
+                        sum += util::Decode<T, BO>(data + offset, nbytes);
+                    }
+                    DoNotOptimize(sum);
+                }
+            }));
+        }
+
+    }
+
+    void RunIoBenchmarks(Runner &runner) {
+        gen::Random rng{0x10};
+        auto data = std::make_unique<u8[]>(BufferSize);
+        gen::FillNoise(rng, data.get(), BufferSize);
+
+        RunReadValue<u8, std::endian::little>(runner, "binary_buffer/read_value/u8", data.get());
+        RunReadValue<u32, std::endian::little>(runner, "binary_buffer/read_value/u32le", data.get());
+        RunReadValue<u32, std::endian::big>(runner, "binary_buffer/read_value/u32be", data.get());
+        RunReadValue<u64, std::endian::little>(runner, "binary_buffer/read_value/u64le", data.get());
+
+        RunReadBits(runner, "binary_buffer/read_bits/1", data.get(), 1);
+        RunReadBits(runner, "binary_buffer/read_bits/7", data.get(), 7);
+        RunReadBits(runner, "binary_buffer/read_bits/24", data.get(), 24);
+
+        RunDecode<u32, std::endian::little>(runner, "decode/u32le", data.get(), sizeof(u32));
+        RunDecode<u32, std::endian::big>(runner, "decode/u32be", data.get(), sizeof(u32));
+        RunDecode<i32, std::endian::little>(runner, "decode/i24le", data.get(), 3);
+        RunDecode<u64, std::endian::big>(runner, "decode/u64be", data.get(), sizeof(u64));
+    }
+
+}
@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2022 Valentin B.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "bench/bench_cases.hpp"
+
+#include <system_error>
+#include <vector>
+
+#include "assert.hpp"
+#include "bin/ptor_content_processor.hpp"
+#include "gen/gen_archive.hpp"
+#include "util/util_literals.hpp"
+#include "wad/wad_archive.hpp"
+
+namespace ptor::bench {
+
+    namespace {
+
+        /* Many small files with a few large ones, about like the game's own archives. */
+        constexpr inline gen::ArchiveSpec SmallArchive  = {.file_count = 1'000, .min_size = 64, .max_size = 256_KB, .min_depth = 3, .max_depth = 3, .seed = 0x31};
+        constexpr inline gen::ArchiveSpec MediumArchive = {.file_count = 20'000, .min_size = 16, .max_size = 64_KB, .min_depth = 4, .max_depth = 4, .seed = 0x32};
+        constexpr inline gen::ArchiveSpec LargeArchive  = {.file_count = 100'000, .min_size = 16, .max_size = 64_KB, .min_depth = 4, .max_depth = 4, .seed = 0x33};
+
+        void RunLoad(Runner &runner, const char *name, const gen::ArchiveSpec &spec, bool index) {
+            if (!runner.IsSelected(name)) {
+                return;
+            }
+
+            std::vector<u8> data = gen::BuildArchive(spec);
+            runner.Run(name, 0, util::IFunction<void(u64)>::Make([&](u64 iterations) {
+                for (u64 i = 0; i < iterations; ++i) {
+                    std::error_code ec;
+                    wad::Archive archive;
+                    archive.Load(data.data(), data.size(), ec);
+                    P_ASSERT(!ec, "failed to load synthetic archive");
+
+                    if (index) {
+                        archive.BuildIndex();
+                    }
+                    DoNotOptimize(archive.GetFiles().GetCount());
+                }
+            }));
+        }
+
+        void RunExtract(Runner &runner, const char *name, const fs::path &workdir, const gen::ArchiveSpec &spec, u32 jobs, bool verify_only) {
+            if (!runner.IsSelected(name)) {
+                return;
+            }
+
+            /* Extraction works on archives on disk, so that's where it goes. */
+            const fs::path archive_path = workdir / "archive.wad";
+            const fs::path output_path  = workdir / "out";
+            gen::ArchiveGenerator generator{spec};
+            {
+                std::error_code ec;
+                gen::WriteArchive(generator, archive_path, ec);
+                P_ASSERT(!ec, "failed to write synthetic archive: {}", ec.message());
+            }
+
+            cli::Options options;
+            options.encode_opt  = cli::EncodeOpt::Decode;
+            options.input_type  = cli::InputType::File;
+            options.data_kind   = cli::DataKind::Wad;
+            options.input_file  = archive_path;
+            options.output      = verify_only ? fs::path{} : output_path;
+            options.jobs        = jobs;
+            options.verify      = verify_only;
+            options.verify_only = verify_only;
+            options.quiet       = true;
+
+            /* Every sample starts out from an empty output directory. */
+            const auto setup = util::IFunction<void()>::Make([&] {
+                std::error_code ec;
+                fs::remove_all(output_path, ec);
+            });
+
+            runner.RunOnce(name, generator.GetContentSize(), setup, util::IFunction<void(u64)>::Make([&](u64) {
+                std::error_code ec;
+                ContentProcessor processor{options};
+                processor.Process(ec);
+                P_ASSERT(!ec, "failed to process synthetic archive");
+            }));
+
+            std::error_code ec;
+            fs::remove_all(output_path, ec);
+            fs::remove(archive_path, ec);
+        }
+
+    }
+
+    void RunWadBenchmarks(Runner &runner) {
+        RunLoad(runner, "archive/load/1k", SmallArchive, false);
+        RunLoad(runner, "archive/load/100k", LargeArchive, false);
+        RunLoad(runner, "archive/load-and-index/100k", LargeArchive, true);
+
+        /* Macro benchmarks run in a scratch directory of their own. */
+        std::error_code ec;
+        const fs::path workdir = fs::temp_directory_path(ec) / "printrospector_bench";
+        P_ASSERT(!ec, "no temporary directory to run benchmarks in");
+        fs::remove_all(workdir, ec);
+        fs::create_directories(workdir, ec);
+        P_ASSERT(!ec, "failed to create {}", workdir.string());
+
+        RunExtract(runner, "extract/1k/1-job", workdir, SmallArchive, 1, false);
+        RunExtract(runner, "extract/1k/4-jobs", workdir, SmallArchive, 4, false);
+        RunExtract(runner, "extract/20k/4-jobs", workdir, MediumArchive, 4, false);
+        RunExtract(runner, "verify/100k/1-job", workdir, LargeArchive, 1, true);
+
+        fs::remove_all(workdir, ec);
+    }
+
+}
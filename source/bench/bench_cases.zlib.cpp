@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2022 Valentin B.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "bench/bench_cases.hpp"
+
+#include <system_error>
+#include <vector>
+
+#include "assert.hpp"
+#include "gen/gen_content.hpp"
+#include "util/util_literals.hpp"
+#include "util/util_zlib_deflater.hpp"
+#include "util/util_zlib_inflater.hpp"
+
+namespace ptor::bench {
+
+    namespace {
+
+        struct CompressedInput {
+            std::vector<u8> data;
+            size_t size;
+        };
+
+        CompressedInput Compress(const u8 *contents, size_t len, u32 level) {
+            std::error_code ec;
+            auto deflater = util::Deflater::Allocate(level, ec);
+            P_ASSERT(!ec, "failed to allocate deflater");
+
+            CompressedInput input{std::vector<u8>(deflater.GetBound(len)), len};
+            input.data.resize(deflater.CompressInto(contents, len, input.data.data(), input.data.size()));
+            return input;
+        }
+
+        void RunDecompress(Runner &runner, const char *name, const CompressedInput &input) {
+            std::error_code ec;
+            auto inflater = util::Inflater::Allocate(input.size, ec);
+            P_ASSERT(!ec, "failed to allocate inflater");
+
+            runner.Run(name, input.size, util::IFunction<void(u64)>::Make([&](u64 iterations) {
+                for (u64 i = 0; i < iterations; ++i) {
+                    std::error_code decompress_ec;
+                    DoNotOptimize(inflater.Decompress(input.data.data(), input.data.size(), input.size, decompress_ec));
+                }
+            }));
+        }
+
+    }
+
+    void RunZlibBenchmarks(Runner &runner) {
+        gen::Random rng{0x21};
+
+        std::vector<u8> text(1_MB), noise(64_KB);
+        gen::FillText(rng, text.data(), text.size());
+        gen::FillNoise(rng, noise.data(), noise.size());
+
+        RunDecompress(runner, "inflater/decompress/text/4KiB", Compress(text.data(), 4_KB, util::Deflater::DefaultLevel));
+        RunDecompress(runner, "inflater/decompress/text/64KiB", Compress(text.data(), 64_KB, util::Deflater::DefaultLevel));
+        RunDecompress(runner, "inflater/decompress/text/1MiB", Compress(text.data(), 1_MB, util::Deflater::DefaultLevel));
+        RunDecompress(runner, "inflater/decompress/text-max-level/1MiB", Compress(text.data(), 1_MB, util::Deflater::MaxLevel));
+        RunDecompress(runner, "inflater/decompress/stored/64KiB", Compress(noise.data(), noise.size(), util::Deflater::DefaultLevel));
+    }
+
+}
@@ -0,0 +1,154 @@
+/*
+ * Copyright (c) 2022 Valentin B.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "bench/bench_harness.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+
+#include "fmt/core.h"
+
+namespace ptor::bench {
+
+    namespace {
+
+        using Clock = std::chrono::steady_clock;
+
+        /* Calibration never grows the iterations of a sample by more than this at once. */
+        constexpr inline u64 MaxGrowthFactor = 100;
+
+        constexpr inline u64 MaxIterations = u64{1} << 40;
+
+        P_ALWAYS_INLINE double ToNanoseconds(Clock::duration duration) {
+            return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+        }
+
+        /* Throughput in decimal megabytes per second, from bytes per nanosecond. */
+        P_ALWAYS_INLINE double GetThroughput(const Runner::Result &result) {
+            return result.median_ns > 0 ? static_cast<double>(result.bytes_per_op) * 1e3 / result.median_ns : 0;
+        }
+
+        P_ALWAYS_INLINE double GetVariation(const Runner::Result &result) {
+            return result.mean_ns > 0 ? result.stddev_ns / result.mean_ns * 100 : 0;
+        }
+
+    }
+
+    Runner::Runner(const Config &config, FILE *out) : m_config{config}, m_out{out} {
+        if (!m_config.json) {
+            fmt::print(m_out, "{:<44} {:>12} {:>14} {:>8} {:>14} {:>10}\n", "benchmark", "iterations", "median ns/op", "cv %", "min ns/op", "MB/s");
+        }
+    }
+
+    bool Runner::IsSelected(const char *name) const {
+        return m_config.filter == nullptr || std::strstr(name, m_config.filter) != nullptr;
+    }
+
+    void Runner::Run(const char *name, u64 bytes_per_op, const BodyType &body) {
+        if (!this->IsSelected(name)) {
+            return;
+        }
+
+        auto measure = [&body](u64 iterations) {
+            const auto start = Clock::now();
+            body(iterations);
+            return Clock::now() - start;
+        };
+
+        /* Find the amount of iterations which takes the minimum sample time; this also warms up caches. */
+        u64 iterations = 1;
+        for (auto elapsed = measure(iterations); elapsed < m_config.min_sample_time && iterations < MaxIterations; elapsed = measure(iterations)) {
+            const double target = ToNanoseconds(m_config.min_sample_time) * 1.2;
+            const double factor = elapsed.count() > 0 ? target / ToNanoseconds(elapsed) : MaxGrowthFactor;
+            iterations = std::min(MaxIterations, static_cast<u64>(static_cast<double>(iterations) * std::clamp<double>(factor, 2, MaxGrowthFactor)));
+        }
+
+        std::vector<double> samples;
+        samples.reserve(m_config.repetitions);
+        for (u32 i = 0; i < m_config.repetitions; ++i) {
+            samples.push_back(ToNanoseconds(measure(iterations)) / static_cast<double>(iterations));
+        }
+
+        this->Record(name, iterations, bytes_per_op, samples);
+    }
+
+    void Runner::RunOnce(const char *name, u64 bytes_per_op, const SetupType &setup, const BodyType &body) {
+        if (!this->IsSelected(name)) {
+            return;
+        }
+
+        /* The first run only warms up caches; its result is discarded. */
+        std::vector<double> samples;
+        samples.reserve(m_config.repetitions);
+        for (u32 i = 0; i <= m_config.repetitions; ++i) {
+            setup();
+
+            const auto start = Clock::now();
+            body(1);
+            const auto elapsed = Clock::now() - start;
+
+            if (i != 0) {
+                samples.push_back(ToNanoseconds(elapsed));
+            }
+        }
+
+        this->Record(name, 1, bytes_per_op, samples);
+    }
+
+    void Runner::Record(const char *name, u64 iterations, u64 bytes_per_op, std::vector<double> &samples) {
+        Result result{name, iterations, bytes_per_op, 0, 0, 0, 0};
+
+        if (!samples.empty()) {
+            std::sort(samples.begin(), samples.end());
+
+            const size_t mid = samples.size() / 2;
+            result.median_ns = samples.size() % 2 != 0 ? samples[mid] : (samples[mid - 1] + samples[mid]) / 2;
+            result.mean_ns   = std::accumulate(samples.begin(), samples.end(), 0.0) / static_cast<double>(samples.size());
+            result.min_ns    = samples.front();
+
+            double variance = 0;
+            for (const double sample : samples) {
+                variance += (sample - result.mean_ns) * (sample - result.mean_ns);
+            }
+            result.stddev_ns = std::sqrt(variance / static_cast<double>(samples.size()));
+        }
+
+        if (!m_config.json) {
+            fmt::print(m_out, "{:<44} {:>12} {:>14.1f} {:>8.2f} {:>14.1f} {:>10}\n", result.name, result.iterations, result.median_ns, GetVariation(result), result.min_ns,
+                       result.bytes_per_op != 0 ? fmt::format("{:.1f}", GetThroughput(result)) : "-");
+            std::fflush(m_out);
+        }
+
+        m_results.push_back(std::move(result));
+    }
+
+    void Runner::Finish() {
+        if (!m_config.json) {
+            return;
+        }
+
+        fmt::print(m_out, "{{\"repetitions\":{},\"benchmarks\":[", m_config.repetitions);
+        for (size_t i = 0; i < m_results.size(); ++i) {
+            const auto &result = m_results[i];
+            fmt::print(m_out, "{}{{\"name\":\"{}\",\"iterations\":{},\"bytes_per_op\":{},\"median_ns\":{:.3f},\"mean_ns\":{:.3f},\"stddev_ns\":{:.3f},\"min_ns\":{:.3f},\"mb_per_s\":{:.3f}}}",
+                       i == 0 ? "" : ",", result.name, result.iterations, result.bytes_per_op, result.median_ns, result.mean_ns, result.stddev_ns, result.min_ns, GetThroughput(result));
+        }
+        fmt::print(m_out, "]}}\n");
+    }
+
+}
@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2022 Valentin B.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifdef _MSC_VER
+    #include <intrin.h>
+#endif
+
+#include "ptor_defines.hpp"
+#include "ptor_types.hpp"
+#include "util/util_i_function.hpp"
+
+namespace ptor::bench {
+
+    /* Keeps the compiler from optimizing away the computation of `value`. */
+    template <typename T>
+    P_ALWAYS_INLINE void DoNotOptimize(const T &value) {
+    #if defined(P_COMPILER_MSVC)
+        static_cast<void>(*reinterpret_cast<const volatile char *>(std::addressof(value)));
+        _ReadWriteBarrier();
+    #else
+        asm volatile("" : : "r,m"(value) : "memory");
+    #endif
+    }
+
+    /* Runs benchmarks and reports how long their operations take. Every benchmark is  */
+    /* measured over a number of samples, so the spread between them can be judged;    */
+    /* results are only comparable between runs with the same build and repetitions.   */
+    class Runner final {
+        P_DISALLOW_COPY_AND_ASSIGN(Runner);
+        P_DISALLOW_MOVE(Runner);
+
+    public:
+        /* Runs the operation under test the given amount of times. */
+        using BodyType = util::IFunction<void(u64)>;
+
+        /* Prepares for a sample of a macro benchmark; not part of the measured time. */
+        using SetupType = util::IFunction<void()>;
+
+        struct Config {
+            const char *filter = nullptr; /* Only run benchmarks whose name contains this.  */
+            u32 repetitions    = 10;      /* The amount of samples taken per benchmark.     */
+            std::chrono::nanoseconds min_sample_time{std::chrono::milliseconds{100}};
+            bool json          = false;   /* Report a JSON document instead of a table.     */
+        };
+
+        struct Result {
+            std::string name;
+            u64 iterations;  /* Operations per sample. */
+            u64 bytes_per_op;
+            double median_ns; /* All times are per operation. */
+            double mean_ns;
+            double stddev_ns;
+            double min_ns;
+        };
+
+    private:
+        Config m_config;
+        FILE *m_out;
+        std::vector<Result> m_results;
+
+    public:
+        Runner(const Config &config, FILE *out);
+
+        /* Checks whether a benchmark of the given name is selected to run. */
+        bool IsSelected(const char *name) const;
+
+        /* Measures a micro benchmark, whose samples run enough operations to take at least */
+        /* the minimum sample time. `bytes_per_op` is the amount of data one operation      */
+        /* processes, for reporting throughput; 0 if that's not meaningful.                 */
+        void Run(const char *name, u64 bytes_per_op, const BodyType &body);
+
+        /* Measures a macro benchmark, whose samples run a single operation each after an */
+        /* untimed call to `setup`.                                                        */
+        void RunOnce(const char *name, u64 bytes_per_op, const SetupType &setup, const BodyType &body);
+
+        /* Reports all results, when they weren't reported as they came in. */
+        void Finish();
+
+    private:
+        void Record(const char *name, u64 iterations, u64 bytes_per_op, std::vector<double> &samples);
+    };
+
+}
@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2022 Valentin B.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+#include <fmt/core.h>
+
+#include "bench/bench_cases.hpp"
+#include "bench/bench_harness.hpp"
+
+void PrintBenchUsage(const char *name);
+
+int main(int argc, char **argv) {
+    ptor::bench::Runner::Config config;
+
+    /* Parse command line options. */
+    for (int i = 1; i < argc; ++i) {
+        const bool has_value = i + 1 < argc;
+        if (std::strcmp(argv[i], "--filter") == 0 && has_value) {
+            config.filter = argv[++i];
+        } else if (std::strcmp(argv[i], "--repetitions") == 0 && has_value) {
+            config.repetitions = static_cast<u32>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (std::strcmp(argv[i], "--min-time") == 0 && has_value) {
+            config.min_sample_time = std::chrono::milliseconds{std::strtoul(argv[++i], nullptr, 10)};
+        } else if (std::strcmp(argv[i], "--json") == 0) {
+            config.json = true;
+        } else {
+            PrintBenchUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (config.repetitions == 0) {
+        PrintBenchUsage(argv[0]);
+        return 1;
+    }
+
+    /* Run all the selected benchmarks. */
+    ptor::bench::Runner runner{config, stdout};
+    ptor::bench::RunIoBenchmarks(runner);
+    ptor::bench::RunZlibBenchmarks(runner);
+    ptor::bench::RunWadBenchmarks(runner);
+    runner.Finish();
+
+    return 0;
+}
+
+void PrintBenchUsage(const char *name) {
+    fmt::print("Usage: {} [options...]\n\n", name);
+    fmt::print("    --filter <text>       only run benchmarks whose name contains the text\n");
+    fmt::print("    --repetitions <n>     the amount of samples per benchmark; defaults to 10\n");
+    fmt::print("    --min-time <ms>       the minimum time of a micro benchmark sample; defaults to 100\n");
+    fmt::print("    --json                report the results as a JSON document\n");
+}
@@ -17,6 +17,8 @@
 #include "bin/cli_options.hpp"
 
 #include <cstdlib>
+#include <cstring>
+#include <limits>
 #include <string>
 
 #include "fmt/color.h"
@@ -24,6 +26,8 @@
 
 #include "ptor_version.hpp"
 #include "bin/cli_option_processor.hpp"
+#include "util/util_thread_pool.hpp"
+#include "util/util_zlib_deflater.hpp"
 
 namespace ptor::cli {
 
@@ -42,6 +46,31 @@ namespace ptor::cli {
             return value;
         }
 
+        inline u64 SizeParseHelper(const char *str, bool &success) {
+            /* strtoull() happily negates values with a leading minus, which is no valid size. */
+            if (str[std::strspn(str, " \t\n\v\f\r")] == '-') {
+                success = false;
+                return 0;
+            }
+
+            char *end;
+            errno = 0;
+            u64 value = std::strtoull(str, std::addressof(end), 0);
+            success = (str != end && errno == 0);
+
+            /* Sizes may be given in binary units, as in 512M or 2G. */
+            u32 shift = 0;
+            switch (*end) {
+                case 'k': case 'K': shift = 10; ++end; break;
+                case 'm': case 'M': shift = 20; ++end; break;
+                case 'g': case 'G': shift = 30; ++end; break;
+                default: break;
+            }
+
+            success &= (*end == 0 && value <= (std::numeric_limits<u64>::max() >> shift));
+            return value << shift;
+        }
+
         P_NORETURN void HelpCommandImpl(Options &opts, const char *value);
 
         /* Global list of `OptionProcessor`s for all command-line options we accept. */
@@ -109,6 +138,12 @@ namespace ptor::cli {
                 "As an alternative to specifying hexadecimal data with the [--hex] option, printrospector"
                 "supports reading the contents of binary files by path.\n\n"
                 "Relative and absolute paths are supported.\n\n"
+                "WAD archives may also be read from pipes, sockets or other files which can't be mapped "
+                "into memory, and from stdin by passing -. These are extracted while they stream in, "
+                "holding only a bounded window of the archive in memory; entries too large for it are "
+                "staged in a temporary spill file.\n\n"
+                "When packing a WAD archive, this is the directory whose files are archived; the "
+                "archive is written to [--out/-o].\n\n"
                 "Note: When this option is followed by [--hex], it will be ignored. Only one source of "
                 "input is allowed at a time.",
                 [](Options &opts, const char *value) {
@@ -116,6 +151,22 @@ namespace ptor::cli {
                     opts.input_file = value;
                 }
             ),
+            MakeProcessor(
+                "batch", "specifies a directory or a list of WAD archives to process in one go",
+                "Processing a whole game client one archive at a time pays for startup and leaves "
+                "workers idle on the many small archives. With this option, all the given archives are "
+                "opened up front and the files of all of them are distributed over one set of workers.\n\n"
+                "The value is either a directory, which is searched recursively for .wad files, or a text "
+                "file listing one archive path per line. Relative paths in such a list are resolved "
+                "against the directory of the list; empty lines and lines starting with # are ignored.\n\n"
+                "Every archive is extracted into its own directory below [--out/-o], named after its path "
+                "without the extension. A summary over all archives is printed at the end.\n\n"
+                "Note: When [--data-kind/-k] is not set to wad, this option will be ignored.",
+                [](Options &opts, const char *value) {
+                    opts.input_type = InputType::Batch;
+                    opts.input_file = value;
+                }
+            ),
             MakeProcessor(
                 "out", 'o', "specifies a path to the output file for (de)serialized contents",
                 "When this option is missing, information will be printed to stdout on a"
@@ -124,6 +175,21 @@ namespace ptor::cli {
                     opts.output = value;
                 }
             ),
+            MakeProcessor(
+                "tar", "writes extracted WAD contents into a single tar stream",
+                "Creating many thousands of small files is often the slowest part of extracting an "
+                "archive, and pointless when they are packed up again right after. With this option, "
+                "all extracted files are written into one POSIX tar stream at the given path instead, "
+                "or to stdout when the path is -.\n\n"
+                "In batch mode, the files of every archive are put below the same relative directory "
+                "they would be extracted to otherwise. When writing to stdout, all logging goes to "
+                "stderr instead. If extraction fails, a partially written tar file is removed.\n\n"
+                "Note: This option takes precedence over [--out/-o] and [--incremental], and is "
+                "ignored with [--verify-only] or when [--data-kind/-k] is not set to wad.",
+                [](Options &opts, const char *value) {
+                    opts.tar_output = value;
+                }
+            ),
             MakeProcessor(
                 "type-list", 't', "specifies a wizwalker type list file",
                 "The type list is a big JSON dump of type information crafted for ObjectProperty "
@@ -214,6 +280,193 @@ namespace ptor::cli {
                 "Note: When [--data-kind/-k] is not set to op, this option will be ignored.",
                 [](Options &opts) { opts.manual_compression = true; }
             ),
+            MakeProcessor(
+                "jobs", 'j', "the amount of worker threads to use for processing",
+                "Work which can be split up into independent items, such as extracting the files in a "
+                "WAD archive, may be distributed over several worker threads.\n\n"
+                "By default, printrospector operates on a single thread. A value of 0 will spawn one "
+                "worker for every hardware thread of the machine.\n\n"
+                "Input can be either in decimal or in hexadecimal (using a 0x prefix).",
+                [](Options &opts, const char *value) {
+                    bool success = false;
+                    opts.jobs = IntParseHelper(value, success);
+                    if (opts.jobs == 0) {
+                        opts.jobs = util::ThreadPool::GetDefaultWorkerCount();
+                    }
+                    return success;
+                }
+            ),
+            MakeProcessor(
+                "max-memory", "limits the memory used for file contents during processing",
+                "Extracting an archive on several workers may hold the contents of several large files "
+                "in memory at once. With this option, workers reserve the memory for every file before "
+                "inflating it and wait while the given limit is used up by the others, so peak usage "
+                "stays bounded no matter the size of the files or the amount of workers.\n\n"
+                "The size is given in bytes, optionally with a K, M or G suffix: --max-memory 1G. "
+                "Workers keep a few MiB each, and a streamed archive a window of up to a quarter of "
+                "the limit; those come out of the limit first. Files too large for what is left are "
+                "processed one at a time.\n\n"
+                "Note: When [--data-kind/-k] is not set to wad, this option will be ignored.",
+                [](Options &opts, const char *value) {
+                    bool success = false;
+                    opts.max_memory = SizeParseHelper(value, success);
+                    return success;
+                }
+            ),
+            MakeProcessor(
+                "level", "the compression level to use when packing archives",
+                "When packing a WAD archive, every file is compressed with zlib at the given level, "
+                "from 0 (fastest) to 12 (smallest). Files which don't get any smaller are stored "
+                "uncompressed. The default level is 6.\n\n"
+                "Packing distributes the files over all workers given by [--jobs/-j]; the archive is "
+                "the same regardless of how many of them are used.\n\n"
+                "Note: When [--data-kind/-k] is not set to wad, this option will be ignored.",
+                [](Options &opts, const char *value) {
+                    bool success = false;
+                    opts.compression_level = IntParseHelper(value, success);
+                    return success && opts.compression_level <= util::Deflater::MaxLevel;
+                }
+            ),
+            MakeProcessor(
+                "mmap-out", "decompress extracted files directly into memory-mapped outputs",
+                "By default, compressed files are inflated into an intermediate buffer before their "
+                "contents are written out to disk.\n\n"
+                "With this option, every output file is instead preallocated to its final size and "
+                "mapped into memory, so the decompressor can write into the page cache directly. This "
+                "saves a copy and keeps memory usage independent of the largest file in an archive.\n\n"
+                "Note: When [--data-kind/-k] is not set to wad, this option will be ignored.",
+                [](Options &opts) { opts.map_output = true; }
+            ),
+            MakeProcessor(
+                "drop-cache", "release archive contents from the page cache once they were extracted",
+                "Extracting large archives pulls all of their contents into the page cache, where they "
+                "may push out data other programs on the machine are actively working with.\n\n"
+                "With this option, printrospector tells the kernel to drop the pages it has already "
+                "processed as it goes. Repeated runs over the same archive will be slower for it.\n\n"
+                "Note: When [--data-kind/-k] is not set to wad, this option will be ignored.",
+                [](Options &opts) { opts.drop_cache = true; }
+            ),
+            MakeProcessor(
+                "verify", "check the checksums of extracted files",
+                "Every file in a WAD archive comes with a CRC32 checksum of its contents. With this "
+                "option, the checksum of every file is computed while it is being extracted and compared "
+                "against the stored one.\n\n"
+                "All mismatching files are listed at the end and extraction is reported as failed.\n\n"
+                "Note: When [--data-kind/-k] is not set to wad, this option will be ignored.",
+                [](Options &opts) { opts.verify = true; }
+            ),
+            MakeProcessor(
+                "verify-only", "check the checksums of archived files without extracting them",
+                "Same as [--verify], but no files are written to disk. This is useful for checking "
+                "the integrity of an archive as quickly as possible.\n\n"
+                "Note: When [--data-kind/-k] is not set to wad, this option will be ignored.",
+                [](Options &opts) {
+                    opts.verify      = true;
+                    opts.verify_only = true;
+                }
+            ),
+            MakeProcessor(
+                "incremental", "skip archived files whose extracted outputs are up to date",
+                "When extracting a WAD archive, printrospector keeps a manifest of all extracted files "
+                "in the output directory, recording their checksums and the size and modification time "
+                "of the files written.\n\n"
+                "With this option, files are only extracted when their checksum in the archive differs "
+                "from the manifest, or when their output was modified or removed since. Re-extracting an "
+                "archive after an update then only writes the files which actually changed.\n\n"
+                "Every output directory should hold the files of a single archive.\n\n"
+                "Note: When [--data-kind/-k] is not set to wad, this option will be ignored.",
+                [](Options &opts) { opts.incremental = true; }
+            ),
+            MakeProcessor(
+                "diff", "compares a WAD archive against an earlier revision of it",
+                "Lists the files which were added, modified or removed since the given base archive:\n\n"
+                "    - printrospector -k wad -i Root.wad --diff Root.old.wad\n\n"
+                "Only the file tables of both archives are compared, so this takes no longer than "
+                "opening them. Files are matched by path and count as modified when their size or "
+                "checksum changed.\n\n"
+                "When [--out/-o] or [--tar] is given as well, the added and modified files are extracted; "
+                "everything else is left out. [--entry] and [--filter] narrow down both archives.\n\n"
+                "Note: When [--data-kind/-k] is not set to wad, or in [--batch] mode, this option will be ignored.",
+                [](Options &opts, const char *value) {
+                    opts.diff_base = value;
+                }
+            ),
+            MakeProcessor(
+                "toc-cache", "specifies a directory for caching the file tables of archives",
+                "Before any files can be processed, the file table of a WAD archive must be parsed and "
+                "validated entry by entry, which adds up for archives with many files.\n\n"
+                "With this option, printrospector stores the validated file table together with an index "
+                "of all paths in the given directory, and reuses it on later runs as long as the size, "
+                "modification time and header of the archive are unchanged. This makes repeated queries "
+                "with [--entry] or [--filter] against the same archives start almost instantly.\n\n"
+                "The directory is created when it doesn't exist. Caches that cannot be read or written "
+                "are silently ignored.\n\n"
+                "Note: When [--data-kind/-k] is not set to wad, this option will be ignored.",
+                [](Options &opts, const char *value) {
+                    opts.toc_cache = value;
+                }
+            ),
+            MakeProcessor(
+                "entry", "only process the archive entry at the given path",
+                "Instead of extracting a whole WAD archive, printrospector may look up single files "
+                "by their archive-relative path and only decompress those:\n\n"
+                "    - printrospector -k wad -i Root.wad -o out --entry GUI/Map/Map.xml\n\n"
+                "The option may be repeated to select several entries. Processing fails when any of "
+                "them does not exist in the archive.\n\n"
+                "Note: When [--data-kind/-k] is not set to wad, this option will be ignored.",
+                [](Options &opts, const char *value) {
+                    opts.entries.push_back(value);
+                }
+            ),
+            MakeProcessor(
+                "filter", "only process archive entries whose path matches a glob",
+                "Selects the files of a WAD archive to process by matching their archive-relative "
+                "paths against a glob pattern:\n\n"
+                "    - ?     matches any single character except /\n"
+                "    - *     matches anything within a single path component\n"
+                "    - **    matches anything, including /\n"
+                "    - [a-z] matches a set of characters; [!a-z] negates the set\n\n"
+                "For example, --filter \"**/*.xml\" selects all XML files in the archive. When combined "
+                "with [--entry], files selected by either option are processed.\n\n"
+                "Note: When [--data-kind/-k] is not set to wad, this option will be ignored.",
+                [](Options &opts, const char *value) {
+                    opts.filter = value;
+                }
+            ),
+            MakeProcessor(
+                "stats", "reports timings and counters for the run when it is done",
+                "Records how much time every phase of processing took, both on the wall clock and on "
+                "the CPU, together with the amount of items and bytes it processed and a histogram of "
+                "the time spent on every single archive entry.\n\n"
+                "Supported values to this option are:\n\n"
+                "    - text: A table for humans to read.\n"
+                "    - json: A single JSON object for tracking runs over time.\n\n"
+                "The report is written to stdout, or stderr when [--tar] writes to stdout, unless "
+                "[--stats-file] is given. Phases which run on several workers add up the time of all "
+                "of them, so they may exceed the elapsed time of the run.",
+                [](Options &opts, const char *value) {
+                    if (std::strcmp(value, "text") == 0) {
+                        opts.stats_format = StatsFormat::Text;
+                    } else if (std::strcmp(value, "json") == 0) {
+                        opts.stats_format = StatsFormat::Json;
+                    } else {
+                        return false;
+                    }
+
+                    return true;
+                }
+            ),
+            MakeProcessor(
+                "stats-file", "writes the report of [--stats] into a file",
+                "Writes the report of [--stats] into the given file instead of the log, replacing "
+                "whatever it contained before. Without [--stats], the report is given as JSON.",
+                [](Options &opts, const char *value) {
+                    opts.stats_file = value;
+                    if (opts.stats_format == StatsFormat::None) {
+                        opts.stats_format = StatsFormat::Json;
+                    }
+                }
+            ),
             MakeProcessor(
                 "quiet", 'q', "do all processing quietly",
                 "By default, printrospector will log relevant details and progress to stdout/stderr.\n\n"
@@ -16,6 +16,7 @@
 #pragma once
 
 #include <optional>
+#include <vector>
 
 #include "ptor_types.hpp"
 
@@ -29,6 +30,7 @@ namespace ptor::cli {
     enum class InputType {
         Hex,
         File,
+        Batch,
 
         Unknown,
     };
@@ -44,6 +46,12 @@ namespace ptor::cli {
         Mannequin,
     };
 
+    enum class StatsFormat {
+        None,
+        Text,
+        Json,
+    };
+
     struct Options {
         /* Input/output sources for data to serialize/deserialize. */
         EncodeOpt encode_opt = EncodeOpt::Decode;
@@ -53,6 +61,9 @@ namespace ptor::cli {
         fs::path input_file{};
         fs::path output{};
 
+        /* Write extracted archive contents into a single tar stream instead; `-` for stdout. */
+        fs::path tar_output{};
+
         /* Path to the wizwalker type list. */
         fs::path type_list{};
 
@@ -63,6 +74,42 @@ namespace ptor::cli {
         bool shallow = false;
         bool manual_compression = false;
 
+        /* The amount of worker threads to use for processing. */
+        u32 jobs = 1;
+
+        /* Limit for the memory which holds file contents during processing; 0 for none. */
+        u64 max_memory = 0;
+
+        /* The zlib compression level for packing archives, from 0 to 12. */
+        u32 compression_level = 6;
+
+        /* Decompress into memory-mapped output files. */
+        bool map_output = false;
+
+        /* Release input pages from the page cache once processed. */
+        bool drop_cache = false;
+
+        /* Check the integrity of archived files, optionally without extracting them. */
+        bool verify = false;
+        bool verify_only = false;
+
+        /* Only extract files whose outputs are missing or out of date. */
+        bool incremental = false;
+
+        /* An earlier revision of the archive; only files which differ from it are processed. */
+        fs::path diff_base{};
+
+        /* Directory for caching the file tables of archives between runs. */
+        fs::path toc_cache{};
+
+        /* Restrict processing to the named archive entries and/or those matching a glob. */
+        std::vector<const char *> entries{};
+        const char *filter = nullptr;
+
+        /* Report where the time of the run went at its end, optionally into a file. */
+        StatsFormat stats_format = StatsFormat::None;
+        fs::path stats_file{};
+
         /* Don't log during processing. */
         bool quiet = false;
     };
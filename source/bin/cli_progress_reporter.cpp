@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2022 Valentin B.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "bin/cli_progress_reporter.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+#ifdef PTOR_OS_WINDOWS
+    #include <io.h>
+#else
+    #include <unistd.h>
+#endif
+
+#include "fmt/core.h"
+
+namespace ptor::cli {
+
+    namespace {
+
+        constexpr inline char Cell  = '=';
+        constexpr inline char Empty = ' ';
+
+        constexpr inline double MiB = 1024.0 * 1024.0;
+
+        std::string FormatDuration(u64 seconds) {
+            if (seconds >= 3600) {
+                return fmt::format("{}:{:02}:{:02}", seconds / 3600, (seconds / 60) % 60, seconds % 60);
+            }
+            return fmt::format("{}:{:02}", seconds / 60, seconds % 60);
+        }
+
+    }
+
+    ProgressReporter::ProgressReporter(const char *prefix, u32 workers, const Totals &totals, FILE *out, bool enabled)
+        : m_prefix{prefix}, m_out{out}, m_totals{totals}, m_workers{workers}, m_counters{std::make_unique<Counters[]>(workers)},
+          m_start{std::chrono::steady_clock::now()}, m_stopping{false}
+    {
+        if (enabled) {
+            this->Render();
+            m_thread = std::thread{[this] { this->Run(); }};
+        }
+    }
+
+    ProgressReporter::~ProgressReporter() {
+        if (!m_thread.joinable()) {
+            return;
+        }
+
+        {
+            std::scoped_lock lk{m_mutex};
+            m_stopping = true;
+        }
+        m_wake.notify_one();
+        m_thread.join();
+
+        this->Render();
+        fmt::print(m_out, " Done!\n");
+        std::fflush(m_out);
+    }
+
+    bool ProgressReporter::IsTerminal(FILE *file) {
+    #ifdef PTOR_OS_WINDOWS
+        return _isatty(_fileno(file)) != 0;
+    #else
+        return isatty(fileno(file)) != 0;
+    #endif
+    }
+
+    void ProgressReporter::Run() {
+        std::unique_lock lk{m_mutex};
+        while (!m_wake.wait_for(lk, TickInterval, [this] { return m_stopping; })) {
+            this->Render();
+        }
+    }
+
+    void ProgressReporter::Render() {
+        /* Sum up the counters of all workers; slightly stale values are fine for display. */
+        u64 files = 0, bytes_in = 0, bytes_out = 0;
+        for (u32 i = 0; i < m_workers; ++i) {
+            files     += m_counters[i].files.load(std::memory_order_relaxed);
+            bytes_in  += m_counters[i].bytes_in.load(std::memory_order_relaxed);
+            bytes_out += m_counters[i].bytes_out.load(std::memory_order_relaxed);
+        }
+
+        /* Estimate the remaining time from the most meaningful total we know. */
+        const u64 done  = m_totals.bytes_out != 0 ? bytes_out : m_totals.bytes_in != 0 ? bytes_in : files;
+        const u64 total = m_totals.bytes_out != 0 ? m_totals.bytes_out : m_totals.bytes_in != 0 ? m_totals.bytes_in : m_totals.files;
+        const u32 cells = total != 0 ? static_cast<u32>(std::min<u64>(done, total) * BarWidth / total) : BarWidth;
+
+        char bar[BarWidth + 1];
+        std::memset(bar, Cell, cells);
+        std::memset(bar + cells, Empty, BarWidth - cells);
+        bar[BarWidth] = 0;
+
+        const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count();
+        const double rate    = elapsed > 0 ? static_cast<double>(bytes_out != 0 ? bytes_out : bytes_in) / elapsed : 0;
+        const double speed   = elapsed > 0 ? static_cast<double>(done) / elapsed : 0;
+        const std::string eta = speed > 0 && done < total ? FormatDuration(static_cast<u64>(static_cast<double>(total - done) / speed)) : "-:--";
+
+        /* Redraw the line in place and clear whatever a longer previous line left behind. */
+        fmt::print(m_out, "\r{} [{}] {}/{} files, {:.1f} MiB in, {:.1f} MiB out, {:.1f} MiB/s, ETA {}\x1b[K",
+                   m_prefix, bar, files, m_totals.files, static_cast<double>(bytes_in) / MiB, static_cast<double>(bytes_out) / MiB, rate / MiB, eta);
+        std::fflush(m_out);
+    }
+
+}
@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2022 Valentin B.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "ptor_defines.hpp"
+#include "ptor_types.hpp"
+
+namespace ptor::cli {
+
+    /* Shows the progress and throughput of work spread over several workers.             */
+    /* Workers only bump counters of their own, which a separate thread samples and draws */
+    /* at a fixed tick; nothing on the workers' side ever blocks or touches the terminal. */
+    class ProgressReporter final {
+        P_DISALLOW_COPY_AND_ASSIGN(ProgressReporter);
+        P_DISALLOW_MOVE(ProgressReporter);
+
+    public:
+        static constexpr u32 BarWidth = 30;
+        static constexpr std::chrono::milliseconds TickInterval{250};
+
+        /* The expected amounts of work; unknown amounts are left at 0. */
+        struct Totals {
+            u32 files;
+            u64 bytes_in;
+            u64 bytes_out;
+        };
+
+    private:
+        static constexpr size_t CacheLineSize = 64;
+
+        /* The counters of a single worker, padded to avoid false sharing with its siblings. */
+        struct alignas(CacheLineSize) Counters {
+            std::atomic<u64> files{0};
+            std::atomic<u64> bytes_in{0};
+            std::atomic<u64> bytes_out{0};
+        };
+
+    private:
+        const char *m_prefix;
+        FILE *m_out;
+        Totals m_totals;
+        u32 m_workers;
+        std::unique_ptr<Counters[]> m_counters;
+        std::chrono::steady_clock::time_point m_start;
+
+        std::mutex m_mutex;
+        std::condition_variable m_wake;
+        bool m_stopping;
+        std::thread m_thread;
+
+    public:
+        /* Creates a reporter for `workers` workers, which only draws anything when `enabled`. */
+        ProgressReporter(const char *prefix, u32 workers, const Totals &totals, FILE *out, bool enabled);
+
+        /* Draws the final state and stops the reporting thread. */
+        ~ProgressReporter();
+
+        /* Checks whether `file` is connected to a terminal which progress can be drawn to. */
+        static bool IsTerminal(FILE *file);
+
+        /* Records completed work; every worker must only pass its own index. */
+        P_ALWAYS_INLINE void Add(u32 worker, u32 files, u64 bytes_in, u64 bytes_out) {
+            /* Only the owning worker writes its counters, so there's no need for atomic updates. */
+            auto &counters = m_counters[worker];
+            counters.files.store(counters.files.load(std::memory_order_relaxed) + files, std::memory_order_relaxed);
+            counters.bytes_in.store(counters.bytes_in.load(std::memory_order_relaxed) + bytes_in, std::memory_order_relaxed);
+            counters.bytes_out.store(counters.bytes_out.load(std::memory_order_relaxed) + bytes_out, std::memory_order_relaxed);
+        }
+
+    private:
+        void Run();
+
+        void Render();
+    };
+
+}
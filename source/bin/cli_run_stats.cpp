@@ -0,0 +1,218 @@
+/*
+ * Copyright (c) 2022 Valentin B.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "bin/cli_run_stats.hpp"
+
+#include <ctime>
+#include <string>
+
+#ifdef PTOR_OS_WINDOWS
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+#endif
+
+#include "fmt/core.h"
+
+namespace ptor::cli {
+
+    namespace {
+
+        constexpr inline const char *PhaseNames[RunStats::PhaseCount] = {
+            "open",
+            "parse_toc",
+            "read",
+            "create_directories",
+            "inflate",
+            "checksum",
+            "write",
+            "scan",
+            "pack",
+        };
+
+        constexpr inline double MiB = 1024.0 * 1024.0;
+
+        /* Percentiles of entry latency given in the report. */
+        constexpr inline u32 Percentiles[] = {50, 90, 99};
+
+        P_ALWAYS_INLINE double ToSeconds(u64 ns) {
+            return static_cast<double>(ns) / 1e9;
+        }
+
+        /* Gets the exclusive upper bound of a latency bucket, in nanoseconds. */
+        P_ALWAYS_INLINE u64 GetBucketLimit(u32 bucket) {
+            return u64{1} << bucket;
+        }
+
+        std::string FormatLatency(u64 ns) {
+            if (ns < 1'000) {
+                return fmt::format("{} ns", ns);
+            } else if (ns < 1'000'000) {
+                return fmt::format("{:.3g} us", static_cast<double>(ns) / 1e3);
+            } else if (ns < 1'000'000'000) {
+                return fmt::format("{:.3g} ms", static_cast<double>(ns) / 1e6);
+            }
+            return fmt::format("{:.3g} s", ToSeconds(ns));
+        }
+
+        /* Gets the bucket which the given percentile of all entries falls into. */
+        u32 FindPercentile(const u64 (&latencies)[RunStats::LatencyBuckets], u64 count, u32 percentile) {
+            const u64 rank = (count * percentile + 99) / 100;
+
+            u64 seen = 0;
+            for (u32 i = 0; i < RunStats::LatencyBuckets; ++i) {
+                if (seen += latencies[i]; seen >= rank) {
+                    return i;
+                }
+            }
+            return RunStats::LatencyBuckets - 1;
+        }
+
+        std::string FormatRatio(const RunStats::PhaseTotals &phase) {
+            if (phase.bytes_in == 0 || phase.bytes_out == 0) {
+                return "-";
+            }
+            return fmt::format("{:.3f}", static_cast<double>(phase.bytes_out) / static_cast<double>(phase.bytes_in));
+        }
+
+    }
+
+    RunStats::RunStats() : m_recorders(1), m_start{Now(true)} {}
+
+    void RunStats::Prepare(u32 workers) {
+        if (m_recorders.size() < workers) {
+            m_recorders.resize(workers);
+        }
+    }
+
+    RunStats::Duration RunStats::Now(bool process_cpu) {
+        u64 cpu_ns = 0;
+
+    #ifdef PTOR_OS_WINDOWS
+        FILETIME creation, exit, kernel, user;
+        const BOOL success = process_cpu ? GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user)
+                                         : GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user);
+        if (success) {
+            /* Both times are given in units of 100 nanoseconds. */
+            const u64 kernel_time = (static_cast<u64>(kernel.dwHighDateTime) << 32) | kernel.dwLowDateTime;
+            const u64 user_time   = (static_cast<u64>(user.dwHighDateTime) << 32) | user.dwLowDateTime;
+            cpu_ns = (kernel_time + user_time) * 100;
+        }
+    #else
+        struct timespec ts{};
+        if (clock_gettime(process_cpu ? CLOCK_PROCESS_CPUTIME_ID : CLOCK_THREAD_CPUTIME_ID, std::addressof(ts)) == 0) {
+            cpu_ns = static_cast<u64>(ts.tv_sec) * 1'000'000'000 + static_cast<u64>(ts.tv_nsec);
+        }
+    #endif
+
+        return {GetWallTime(), cpu_ns};
+    }
+
+    void RunStats::Print(FILE *out, StatsFormat format) const {
+        const Duration elapsed = Now(true) - m_start;
+
+        /* Merge what all the workers recorded. */
+        PhaseTotals phases[PhaseCount]{};
+        u64 latencies[LatencyBuckets]{};
+        u64 entries = 0;
+        for (const auto &recorder : m_recorders) {
+            for (u32 i = 0; i < PhaseCount; ++i) {
+                phases[i].time       = phases[i].time + recorder.m_phases[i].time;
+                phases[i].items     += recorder.m_phases[i].items;
+                phases[i].bytes_in  += recorder.m_phases[i].bytes_in;
+                phases[i].bytes_out += recorder.m_phases[i].bytes_out;
+            }
+            for (u32 i = 0; i < LatencyBuckets; ++i) {
+                latencies[i] += recorder.m_latencies[i];
+                entries      += recorder.m_latencies[i];
+            }
+        }
+
+        /* Phases which never ran are left out of the report. */
+        auto has_run = [](const PhaseTotals &phase) {
+            return phase.items != 0 || phase.time.wall_ns != 0;
+        };
+
+        if (format == StatsFormat::Json) {
+            fmt::print(out, "{{\"workers\":{},\"elapsed\":{{\"wall_ns\":{},\"cpu_ns\":{}}},\"phases\":{{", m_recorders.size(), elapsed.wall_ns, elapsed.cpu_ns);
+
+            bool first = true;
+            for (u32 i = 0; i < PhaseCount; ++i) {
+                const auto &phase = phases[i];
+                if (!has_run(phase)) {
+                    continue;
+                }
+
+                fmt::print(out, "{}\"{}\":{{\"wall_ns\":{},\"cpu_ns\":{},\"items\":{},\"bytes_in\":{},\"bytes_out\":{}}}",
+                           first ? "" : ",", PhaseNames[i], phase.time.wall_ns, phase.time.cpu_ns, phase.items, phase.bytes_in, phase.bytes_out);
+                first = false;
+            }
+
+            fmt::print(out, "}},\"entry_latency\":{{\"count\":{},\"buckets\":[", entries);
+
+            first = true;
+            for (u32 i = 0; i < LatencyBuckets; ++i) {
+                if (latencies[i] == 0) {
+                    continue;
+                }
+
+                /* The last bucket has no upper bound. */
+                if (i == LatencyBuckets - 1) {
+                    fmt::print(out, "{}{{\"lt_ns\":null,\"count\":{}}}", first ? "" : ",", latencies[i]);
+                } else {
+                    fmt::print(out, "{}{{\"lt_ns\":{},\"count\":{}}}", first ? "" : ",", GetBucketLimit(i), latencies[i]);
+                }
+                first = false;
+            }
+
+            fmt::print(out, "]}}}}\n");
+        } else {
+            fmt::print(out, "Statistics for {} worker{}: {:.3f} s elapsed, {:.3f} s of CPU time.\n\n",
+                       m_recorders.size(), m_recorders.size() == 1 ? "" : "s", ToSeconds(elapsed.wall_ns), ToSeconds(elapsed.cpu_ns));
+
+            fmt::print(out, "{:<20} {:>10} {:>10} {:>10} {:>12} {:>12} {:>8}\n", "phase", "wall (s)", "cpu (s)", "items", "in (MiB)", "out (MiB)", "out/in");
+            for (u32 i = 0; i < PhaseCount; ++i) {
+                const auto &phase = phases[i];
+                if (!has_run(phase)) {
+                    continue;
+                }
+
+                fmt::print(out, "{:<20} {:>10.3f} {:>10.3f} {:>10} {:>12.1f} {:>12.1f} {:>8}\n", PhaseNames[i],
+                           ToSeconds(phase.time.wall_ns), ToSeconds(phase.time.cpu_ns), phase.items,
+                           static_cast<double>(phase.bytes_in) / MiB, static_cast<double>(phase.bytes_out) / MiB, FormatRatio(phase));
+            }
+
+            if (entries == 0) {
+                return;
+            }
+
+            fmt::print(out, "\nLatency of {} entries:", entries);
+            for (const u32 percentile : Percentiles) {
+                fmt::print(out, " p{} < {},", percentile, FormatLatency(GetBucketLimit(FindPercentile(latencies, entries, percentile))));
+            }
+            fmt::print(out, " max < {}\n", FormatLatency(GetBucketLimit(FindPercentile(latencies, entries, 100))));
+
+            for (u32 i = 0; i < LatencyBuckets; ++i) {
+                if (latencies[i] == 0) {
+                    continue;
+                }
+
+                const std::string limit = i == LatencyBuckets - 1 ? "more" : fmt::format("< {}", FormatLatency(GetBucketLimit(i)));
+                fmt::print(out, "  {:>12} {:>10}\n", limit, latencies[i]);
+            }
+        }
+    }
+
+}
@@ -0,0 +1,193 @@
+/*
+ * Copyright (c) 2022 Valentin B.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+#include "ptor_defines.hpp"
+#include "ptor_types.hpp"
+#include "bin/cli_options.hpp"
+
+namespace ptor::cli {
+
+    /* The phases of a run which time is attributed to. */
+    enum class Phase : u32 {
+        Open,              /* Opening the input archives and mapping them into memory. */
+        ParseToc,          /* Parsing or loading the file tables of the archives.      */
+        Read,              /* Waiting for the contents of streamed archives.           */
+        CreateDirectories, /* Creating the output directory trees.                     */
+        Inflate,           /* Decompressing the contents of files.                     */
+        Checksum,          /* Computing checksums over the contents of files.          */
+        Write,             /* Writing files and waiting for queued writes to complete. */
+        Scan,              /* Gathering the files to pack from the input directory.    */
+        Pack,              /* Reading, compressing and writing out the files to pack.  */
+
+        Count,
+    };
+
+    /* Timings and counters for all phases of a run, which are reported at its end.   */
+    /* Every worker records into a `Recorder` of its own, so recording never contends */
+    /* with other threads. Time is exclusive: nested phases don't count towards the  */
+    /* phases around them.                                                           */
+    class RunStats final {
+        P_DISALLOW_COPY_AND_ASSIGN(RunStats);
+        P_DISALLOW_MOVE(RunStats);
+
+    public:
+        /* Entry latencies are bucketed by powers of two nanoseconds; the last bucket takes the rest. */
+        static constexpr u32 LatencyBuckets = 40;
+
+        static constexpr u32 PhaseCount = static_cast<u32>(Phase::Count);
+
+        /* A point in time, or the time between two of them, on the wall and the CPU clock. */
+        struct Duration {
+            u64 wall_ns;
+            u64 cpu_ns;
+
+            P_ALWAYS_INLINE Duration operator-(const Duration &rhs) const {
+                return {wall_ns - rhs.wall_ns, cpu_ns - rhs.cpu_ns};
+            }
+
+            P_ALWAYS_INLINE Duration operator+(const Duration &rhs) const {
+                return {wall_ns + rhs.wall_ns, cpu_ns + rhs.cpu_ns};
+            }
+        };
+
+        struct PhaseTotals {
+            Duration time;
+            u64 items;
+            u64 bytes_in;
+            u64 bytes_out;
+        };
+
+        /* The statistics gathered by a single worker; only ever touched by its own thread. */
+        class alignas(64) Recorder {
+            friend class RunStats;
+
+        private:
+            PhaseTotals m_phases[PhaseCount]{};
+            u64 m_latencies[LatencyBuckets]{};
+            Duration m_nested{};
+
+        public:
+            P_ALWAYS_INLINE void Record(Phase phase, const Duration &time, u64 items, u64 bytes_in, u64 bytes_out) {
+                auto &totals = m_phases[static_cast<u32>(phase)];
+                totals.time       = totals.time + time;
+                totals.items     += items;
+                totals.bytes_in  += bytes_in;
+                totals.bytes_out += bytes_out;
+            }
+
+            P_ALWAYS_INLINE void RecordLatency(u64 ns) {
+                m_latencies[std::min<u32>(std::bit_width(ns), LatencyBuckets - 1)] += 1;
+            }
+
+            P_ALWAYS_INLINE Duration &GetNested() { return m_nested; }
+        };
+
+        /* Attributes the time until its destruction to a phase. Does nothing without a recorder. */
+        class ScopedTimer {
+            P_DISALLOW_COPY_AND_ASSIGN(ScopedTimer);
+            P_DISALLOW_MOVE(ScopedTimer);
+
+        private:
+            Recorder *m_recorder;
+            Phase m_phase;
+            bool m_process_cpu;
+            Duration m_start;
+            Duration m_nested;
+            u64 m_items;
+            u64 m_bytes_in;
+            u64 m_bytes_out;
+
+        public:
+            /* With `process_cpu`, the CPU time of all threads is counted rather than the current one's. */
+            P_ALWAYS_INLINE ScopedTimer(Recorder *recorder, Phase phase, u64 items = 0, u64 bytes_in = 0, u64 bytes_out = 0, bool process_cpu = false)
+                : m_recorder{recorder}, m_phase{phase}, m_process_cpu{process_cpu}, m_start{}, m_nested{}, m_items{items}, m_bytes_in{bytes_in}, m_bytes_out{bytes_out}
+            {
+                if (m_recorder != nullptr) {
+                    m_start  = RunStats::Now(m_process_cpu);
+                    m_nested = m_recorder->GetNested();
+                }
+            }
+
+            P_ALWAYS_INLINE ~ScopedTimer() {
+                if (m_recorder != nullptr) {
+                    const Duration elapsed = RunStats::Now(m_process_cpu) - m_start;
+                    const Duration nested  = m_recorder->GetNested() - m_nested;
+
+                    m_recorder->Record(m_phase, elapsed - nested, m_items, m_bytes_in, m_bytes_out);
+                    m_recorder->GetNested() = m_nested + elapsed;
+                }
+            }
+
+            /* Sets the work done in the phase, when it's only known at the end. */
+            P_ALWAYS_INLINE void SetWork(u64 items, u64 bytes_in, u64 bytes_out) {
+                m_items     = items;
+                m_bytes_in  = bytes_in;
+                m_bytes_out = bytes_out;
+            }
+        };
+
+        /* Records the wall time until its destruction as the latency of an archive entry. */
+        class EntryTimer {
+            P_DISALLOW_COPY_AND_ASSIGN(EntryTimer);
+            P_DISALLOW_MOVE(EntryTimer);
+
+        private:
+            Recorder *m_recorder;
+            u64 m_start;
+
+        public:
+            P_ALWAYS_INLINE explicit EntryTimer(Recorder *recorder) : m_recorder{recorder}, m_start{recorder != nullptr ? RunStats::GetWallTime() : 0} {}
+
+            P_ALWAYS_INLINE ~EntryTimer() {
+                if (m_recorder != nullptr) {
+                    m_recorder->RecordLatency(RunStats::GetWallTime() - m_start);
+                }
+            }
+        };
+
+    private:
+        std::vector<Recorder> m_recorders;
+        Duration m_start;
+
+    public:
+        RunStats();
+
+        /* Makes sure there's a recorder for each of `workers` workers. Must not be called while any are recording. */
+        void Prepare(u32 workers);
+
+        /* Gets the recorder of the given worker. Worker 0 also records the phases outside of worker pools. */
+        P_ALWAYS_INLINE Recorder *GetRecorder(u32 worker) { return std::addressof(m_recorders[worker]); }
+
+        /* Writes the statistics of all workers in the given format. */
+        void Print(FILE *out, StatsFormat format) const;
+
+        /* Gets the current wall time, and the CPU time of either the calling thread or the whole process. */
+        static Duration Now(bool process_cpu);
+
+        P_ALWAYS_INLINE static u64 GetWallTime() {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+    };
+
+}
@@ -17,14 +17,16 @@
 
 #include <cstdio>
 #include <memory>
+#include <optional>
 #include <system_error>
 #include <utility>
 
 #include "ptor_defines.hpp"
 #include "ptor_types.hpp"
 #include "bin/cli_options.hpp"
+#include "bin/cli_run_stats.hpp"
 #include "io/io_memory_mapped.hpp"
-#include "wad/wad_types.hpp"
+#include "util/util_thread_pool.hpp"
 
 namespace ptor {
 
@@ -32,53 +34,12 @@ namespace ptor {
         P_DISALLOW_COPY_AND_ASSIGN(ContentProcessor);
         P_DISALLOW_MOVE(ContentProcessor);
 
-    public:
-        template <u32 Width>
-        class ProgressBar {
-            P_DISALLOW_COPY_AND_ASSIGN(ProgressBar);
-            P_DISALLOW_MOVE(ProgressBar);
-
-        private:
-            static constexpr char Cell  = '=';
-            static constexpr char Empty = ' ';
-
-        private:
-            const char *m_prefix;
-            u32 m_cells;
-            u32 m_current;
-            u32 m_total;
-
-        public:
-            ProgressBar(const char *p, u32 total) : m_prefix{p}, m_cells{0}, m_current{0}, m_total{total} {
-                this->Render();
-            }
-
-            ~ProgressBar() {
-                fmt::print(" Done!\n");
-            }
-
-            P_ALWAYS_INLINE void Update(size_t new_current) {
-                m_current = new_current;
-
-                if (const u32 cells = (m_current * Width) / m_total; cells != m_cells) {
-                    m_cells = cells;
-                    this->Render();
-                }
-            }
-
-            void Render() {
-                char bar[Width + 1];
-                std::memset(bar, Cell, m_cells);
-                std::memset(bar + m_cells, Empty, Width - m_cells);
-                bar[Width] = 0;
-
-                fmt::print("\r{} [{}] {}/{}", m_prefix, bar, m_current, m_total);
-                std::fflush(stdout);
-            }
-        };
-
     private:
         cli::Options m_options;
+        std::optional<cli::RunStats> m_stats;
+
+        /* Shared by all the phases, so the worker threads are only started once. */
+        util::ThreadPool m_pool;
 
     public:
         explicit ContentProcessor(cli::Options options);
@@ -88,14 +49,13 @@ namespace ptor {
         void Save(std::error_code &ec);
 
     private:
-        struct ProcessWadContext {
-            u8 *raw_data;
-            wad::Header header;
-            std::unique_ptr<wad::File[]> files;
-        };
+        P_ALWAYS_INLINE cli::RunStats *GetStats() { return m_stats.has_value() ? std::addressof(*m_stats) : nullptr; }
+
+        void ReportStats(std::error_code &ec);
 
-    private:
         void ProcessWad(std::error_code &ec);
+
+        void SaveWad(std::error_code &ec);
     };
 
 }
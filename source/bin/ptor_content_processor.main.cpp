@@ -16,9 +16,15 @@
 
 #include "bin/ptor_content_processor.hpp"
 
+#include "util/util_scope_guard.hpp"
+
 namespace ptor {
 
-    ContentProcessor::ContentProcessor(cli::Options options) : m_options{std::move(options)} {}
+    ContentProcessor::ContentProcessor(cli::Options options) : m_options{std::move(options)}, m_pool{m_options.jobs} {
+        if (m_options.stats_format != cli::StatsFormat::None) {
+            m_stats.emplace();
+        }
+    }
 
     void ContentProcessor::Process(std::error_code &ec) {
         P_DEBUG_ASSERT(m_options.encode_opt == cli::EncodeOpt::Decode);
@@ -29,10 +35,17 @@ namespace ptor {
         /* Decode the format we got. */
         switch (m_options.data_kind) {
             case cli::DataKind::ObjectProperty: P_TODO(); break;
-            case cli::DataKind::Wad:            return this->ProcessWad(ec);
+            case cli::DataKind::Wad:            this->ProcessWad(ec); break;
 
             default: P_UNREACHABLE();
         }
+
+        /* A failed report doesn't hide the actual error of the run. */
+        std::error_code stats_ec;
+        this->ReportStats(stats_ec);
+        if (!ec) {
+            ec = stats_ec;
+        }
     }
 
     void ContentProcessor::Save(std::error_code &ec) {
@@ -41,7 +54,46 @@ namespace ptor {
         /* Reset the error code back into a successful state. */
         ec.clear();
 
-        P_TODO();
+        /* Encode the format we got. */
+        switch (m_options.data_kind) {
+            case cli::DataKind::ObjectProperty: P_TODO(); break;
+            case cli::DataKind::Wad:            this->SaveWad(ec); break;
+
+            default: P_UNREACHABLE();
+        }
+
+        /* A failed report doesn't hide the actual error of the run. */
+        std::error_code stats_ec;
+        this->ReportStats(stats_ec);
+        if (!ec) {
+            ec = stats_ec;
+        }
+    }
+
+    void ContentProcessor::ReportStats(std::error_code &ec) {
+        /* Reset the error code back into a successful state. */
+        ec.clear();
+
+        if (!m_stats.has_value()) {
+            return;
+        }
+
+        /* Without a file of its own, the report goes with the rest of the log. */
+        if (m_options.stats_file.empty()) {
+            return m_stats->Print(m_options.tar_output == "-" ? stderr : stdout, m_options.stats_format);
+        }
+
+        FILE *out = std::fopen(m_options.stats_file.string().c_str(), "w");
+        if (out == nullptr) {
+            ec = std::make_error_code(std::errc::io_error);
+            return;
+        }
+        P_ON_SCOPE_EXIT { std::fclose(out); };
+
+        m_stats->Print(out, m_options.stats_format);
+        if (std::ferror(out)) {
+            ec = std::make_error_code(std::errc::io_error);
+        }
     }
 
 }
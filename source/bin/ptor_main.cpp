@@ -24,6 +24,7 @@
 
 #include "bin/cli_options.hpp"
 #include "bin/ptor_content_processor.hpp"
+#include "io/io_directory_tree.hpp"
 
 void EnableConsoleColors();
 
@@ -40,6 +41,12 @@ int main(int argc, char **argv) {
         return 1;
     }
 
+    /* Extracted archives may keep many output directories open at once. */
+    ptor::io::DirectoryTree::RaiseDescriptorLimit();
+
+    /* Errors must not end up in a tar stream written to stdout. */
+    FILE *log = options->tar_output == "-" ? stderr : stdout;
+
     /* Process the given arguments. */
     auto processor = ptor::ContentProcessor{std::move(*options)};
     if (options->encode_opt == ptor::cli::EncodeOpt::Decode) {
@@ -50,7 +57,7 @@ int main(int argc, char **argv) {
 
     /* Check the result. */
     if (ec) {
-        fmt::print(fg(fmt::color::red), "Error during processing: {} (code {})!\n", ec.message(), ec.value());
+        fmt::print(log, fg(fmt::color::red), "Error during processing: {} (code {})!\n", ec.message(), ec.value());
         return 1;
     } else {
         return 0;
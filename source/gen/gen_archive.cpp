@@ -0,0 +1,213 @@
+/*
+ * Copyright (c) 2022 Valentin B.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gen/gen_archive.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+
+#include "fmt/core.h"
+
+#include "assert.hpp"
+#include "gen/gen_content.hpp"
+#include "gen/gen_random.hpp"
+#include "util/util_crc32.hpp"
+#include "util/util_encoding.hpp"
+#include "util/util_zlib_deflater.hpp"
+#include "wad/wad_file_table.hpp"
+
+namespace ptor::gen {
+
+    namespace {
+
+        constexpr inline size_t MagicSize = 5;
+
+        /* Stored files have no compressed size. */
+        constexpr inline u32 StoredSize = 0xFFFFFFFF;
+
+        P_ALWAYS_INLINE u8 *EncodeU32(u8 *out, u32 value) {
+            util::Encode<u32, std::endian::little>(out, value);
+            return out + sizeof(u32);
+        }
+
+        P_ALWAYS_INLINE size_t GetHeaderSize(u32 version) {
+            return MagicSize + 2 * sizeof(u32) + (version >= 2 ? sizeof(u8) : 0);
+        }
+
+        u32 PickSize(const ArchiveSpec &spec, Random &rng) {
+            const u32 min = spec.min_size;
+            const u32 max = std::max(spec.max_size, spec.min_size);
+
+            switch (spec.distribution) {
+                case SizeDistribution::Fixed:
+                    return min;
+                case SizeDistribution::Uniform:
+                    return rng.NextInRange(min, max);
+                case SizeDistribution::LogUniform:
+                    break;
+            }
+
+            /* Pick a power of two first, then a size within it. */
+            const u32 bit = rng.NextInRange(std::bit_width(std::max<u32>(min, 1)) - 1, std::bit_width(max) - 1);
+            const u32 lo  = std::max<u32>(min, u32{1} << bit);
+            const u32 hi  = bit == 31 ? max : std::min<u32>(max, (u32{2} << bit) - 1);
+            return rng.NextInRange(lo, hi);
+        }
+
+    }
+
+    ArchiveGenerator::ArchiveGenerator(const ArchiveSpec &spec) : m_spec{spec}, m_content_size{0}, m_archive_size{0} {
+        P_ASSERT(spec.version == 1 || spec.version == 2, "unsupported archive version {}", spec.version);
+
+        /* Decide on the paths and sizes of all files up front; contents get seeds of their own. */
+        Random rng{spec.seed};
+        const u32 fanout    = std::max<u32>(spec.fanout, 1);
+        const u32 max_depth = std::max(spec.max_depth, spec.min_depth);
+
+        size_t table_size = GetHeaderSize(spec.version);
+        m_files.resize(spec.file_count);
+        for (u32 i = 0; i < spec.file_count; ++i) {
+            auto &file = m_files[i];
+
+            const u32 depth = rng.NextInRange(spec.min_depth, max_depth);
+            for (u32 level = 0; level < depth; ++level) {
+                file.path += fmt::format("dir{}/", rng.NextBelow(fanout));
+            }
+            file.path += fmt::format("file{:06}.bin", i);
+
+            file.size  = PickSize(spec, rng);
+            file.noise = rng.NextBelow(100) < spec.stored_percent;
+            file.seed  = rng.Next();
+
+            m_content_size += file.size;
+            table_size     += wad::FileTable::EntryHeaderSize + file.path.size() + 1;
+        }
+
+        /* Lay out the header right away; the entries are filled in during generation. */
+        m_table.resize(table_size);
+        std::memcpy(m_table.data(), wad::ArchiveMagic, MagicSize);
+        u8 *cursor = EncodeU32(m_table.data() + MagicSize, spec.version);
+        cursor     = EncodeU32(cursor, spec.file_count);
+        if (spec.version >= 2) {
+            *cursor = spec.flags;
+        }
+    }
+
+    void ArchiveGenerator::Generate(const WriteCallbackType &write, std::error_code &ec) {
+        /* Reset the error code back into a successful state. */
+        ec.clear();
+
+        auto deflater = util::Deflater::Allocate(m_spec.level, ec);
+        if (ec) {
+            return;
+        }
+
+        std::vector<u8> contents, compressed;
+        u64 offset = m_table.size();
+        u8 *cursor = m_table.data() + GetHeaderSize(m_spec.version);
+        for (const auto &file : m_files) {
+            Random rng{file.seed};
+            contents.resize(file.size);
+            if (file.noise) {
+                FillNoise(rng, contents.data(), file.size);
+            } else {
+                FillCompressible(rng, contents.data(), file.size, m_spec.ratio_percent);
+            }
+
+            /* Only keep the compressed contents when they're actually smaller. */
+            compressed.resize(deflater.GetBound(file.size));
+            const size_t compressed_size = file.size != 0 ? deflater.CompressInto(contents.data(), file.size, compressed.data(), file.size - 1) : 0;
+            const u8 *data    = compressed_size != 0 ? compressed.data() : contents.data();
+            const size_t size = compressed_size != 0 ? compressed_size : file.size;
+
+            /* Offsets in the file table are only 32 bits wide. */
+            if (offset + size > std::numeric_limits<u32>::max()) {
+                ec = std::make_error_code(std::errc::file_too_large);
+                return;
+            }
+            if (size != 0 && !write(data, size)) {
+                ec = std::make_error_code(std::errc::io_error);
+                return;
+            }
+
+            cursor    = EncodeU32(cursor, static_cast<u32>(offset));
+            cursor    = EncodeU32(cursor, file.size);
+            cursor    = EncodeU32(cursor, compressed_size != 0 ? static_cast<u32>(compressed_size) : StoredSize);
+            *cursor++ = compressed_size != 0 ? 1 : 0;
+            cursor    = EncodeU32(cursor, util::Crc32(contents.data(), file.size));
+            cursor    = EncodeU32(cursor, static_cast<u32>(file.path.size() + 1));
+            std::memcpy(cursor, file.path.c_str(), file.path.size() + 1);
+            cursor   += file.path.size() + 1;
+
+            offset += size;
+        }
+
+        m_archive_size = offset;
+    }
+
+    std::vector<u8> BuildArchive(const ArchiveSpec &spec) {
+        ArchiveGenerator generator{spec};
+
+        std::vector<u8> archive(generator.GetTable().size());
+        std::error_code ec;
+        generator.Generate(util::IFunction<bool(const u8 *, size_t)>::Make([&archive](const u8 *data, size_t len) {
+            archive.insert(archive.end(), data, data + len);
+            return true;
+        }), ec);
+        P_ASSERT(!ec, "failed to build synthetic archive: {}", ec.message());
+
+        const auto table = generator.GetTable();
+        std::memcpy(archive.data(), table.data(), table.size());
+        return archive;
+    }
+
+    void WriteArchive(ArchiveGenerator &generator, const fs::path &path, std::error_code &ec) {
+        /* Reset the error code back into a successful state. */
+        ec.clear();
+
+        FILE *file = std::fopen(path.string().c_str(), "wb");
+        if (file == nullptr) {
+            ec = std::make_error_code(std::errc::io_error);
+            return;
+        }
+
+        /* Reserve room for the file table, which is only complete once all contents are written. */
+        bool success = std::fseek(file, static_cast<long>(generator.GetTable().size()), SEEK_SET) == 0;
+        if (success) {
+            generator.Generate(util::IFunction<bool(const u8 *, size_t)>::Make([file](const u8 *data, size_t len) {
+                return std::fwrite(data, 1, len, file) == len;
+            }), ec);
+
+            const auto table = generator.GetTable();
+            success = !ec && std::fseek(file, 0, SEEK_SET) == 0 && std::fwrite(table.data(), 1, table.size(), file) == table.size();
+        }
+
+        success &= std::fclose(file) == 0;
+        if (!success) {
+            if (!ec) {
+                ec = std::make_error_code(std::errc::io_error);
+            }
+
+            /* Don't leave an incomplete archive behind. */
+            std::error_code remove_ec;
+            fs::remove(path, remove_ec);
+        }
+    }
+
+}
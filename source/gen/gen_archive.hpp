@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2022 Valentin B.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <span>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "ptor_defines.hpp"
+#include "ptor_types.hpp"
+#include "util/util_i_function.hpp"
+#include "util/util_literals.hpp"
+#include "wad/wad_types.hpp"
+
+namespace ptor::gen {
+
+    /* How the sizes of synthetic files are spread between the bounds. */
+    enum class SizeDistribution {
+        Fixed,      /* Every file has the minimum size.                          */
+        Uniform,    /* All sizes are equally likely.                             */
+        LogUniform, /* Every power of two is equally likely; many small files.  */
+    };
+
+    /* Describes a synthetic KIWAD archive. The same spec always gives the same archive */
+    /* for a given version of libdeflate.                                               */
+    struct ArchiveSpec {
+        u32 file_count = 1'000;
+        SizeDistribution distribution = SizeDistribution::LogUniform;
+        u32 min_size = 64;
+        u32 max_size = 256_KB;
+        u32 ratio_percent = 30;          /* The targeted compressed size of compressed files. */
+        u32 stored_percent = 10;         /* The share of files with incompressible contents.  */
+        u32 min_depth = 3;               /* The amount of directories above every file.       */
+        u32 max_depth = 3;
+        u32 fanout = 8;                  /* The amount of distinct directories per level.     */
+        u32 level = 6;                   /* The zlib compression level.                       */
+        u32 version = 2;                 /* The archive format version, either 1 or 2.        */
+        wad::ArchiveFlags flags = wad::ArchiveFlag_MemoryMapped;
+        u64 seed = 0;
+    };
+
+    /* Generates a synthetic archive: the file table is planned up front, and the file */
+    /* contents are generated one at a time and handed out in archive order, so even   */
+    /* archives of many GiB can be written out without holding them in memory.         */
+    class ArchiveGenerator final {
+        P_DISALLOW_COPY_AND_ASSIGN(ArchiveGenerator);
+        P_DISALLOW_MOVE(ArchiveGenerator);
+
+    public:
+        /* Receives the next `len` bytes of the archive after the file table. */
+        using WriteCallbackType = util::IFunction<bool(const u8 *data, size_t len)>;
+
+    private:
+        struct PlannedFile {
+            std::string path;
+            u32 size;
+            bool noise;
+            u64 seed;
+        };
+
+    private:
+        ArchiveSpec m_spec;
+        std::vector<PlannedFile> m_files;
+        std::vector<u8> m_table;
+        u64 m_content_size;
+        u64 m_archive_size;
+
+    public:
+        explicit ArchiveGenerator(const ArchiveSpec &spec);
+
+        /* Generates all the file contents and completes the file table. */
+        void Generate(const WriteCallbackType &write, std::error_code &ec);
+
+        /* Gets the archive header and file table, which are only complete after generation. */
+        P_ALWAYS_INLINE std::span<const u8> GetTable() const { return m_table; }
+
+        /* Gets the combined uncompressed size of all files, which is known up front. */
+        P_ALWAYS_INLINE u64 GetContentSize() const { return m_content_size; }
+
+        /* Gets the total size of the archive, which is only known after generation. */
+        P_ALWAYS_INLINE u64 GetArchiveSize() const { return m_archive_size; }
+    };
+
+    /* Builds a complete archive from `spec` in memory. */
+    std::vector<u8> BuildArchive(const ArchiveSpec &spec);
+
+    /* Writes a complete archive from `generator` to the file at `path`. */
+    void WriteArchive(ArchiveGenerator &generator, const fs::path &path, std::error_code &ec);
+
+}
@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2022 Valentin B.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gen/gen_content.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace ptor::gen {
+
+    namespace {
+
+        constexpr inline const char *Words[] = {
+            "the", "of", "and", "to", "in", "is", "that", "for", "it", "as", "was", "with", "be", "by", "on",
+            "not", "he", "this", "are", "or", "his", "from", "at", "which", "but", "have", "an", "had", "they",
+            "you", "were", "their", "one", "all", "we", "can", "her", "has", "there", "been", "if", "more",
+            "when", "will", "would", "who", "so", "no", "<Object>", "</Object>", "Name=", "Value=", "0x1f",
+        };
+
+        constexpr inline u32 WordCount = sizeof(Words) / sizeof(Words[0]);
+
+        /* The granularity at which content kinds are mixed. */
+        constexpr inline size_t BlockSize = 2048;
+
+        /* Repetitions stay well within the deflate window, so they cost next to nothing. */
+        constexpr inline size_t MaxRepeatDistance = 12 * BlockSize;
+
+    }
+
+    void FillText(Random &rng, u8 *out, size_t len) {
+        size_t offset = 0;
+        while (offset < len) {
+            const char *word = Words[rng.NextBelow(WordCount)];
+            const size_t word_len = std::min(std::strlen(word), len - offset);
+            std::memcpy(out + offset, word, word_len);
+            offset += word_len;
+
+            if (offset < len) {
+                out[offset++] = rng.NextBelow(12) == 0 ? '\n' : ' ';
+            }
+        }
+    }
+
+    void FillNoise(Random &rng, u8 *out, size_t len) {
+        size_t offset = 0;
+        for (; offset + sizeof(u64) <= len; offset += sizeof(u64)) {
+            const u64 value = rng.Next();
+            std::memcpy(out + offset, std::addressof(value), sizeof(u64));
+        }
+        for (; offset < len; ++offset) {
+            out[offset] = static_cast<u8>(rng.Next());
+        }
+    }
+
+    void FillCompressible(Random &rng, u8 *out, size_t len, u32 ratio_percent) {
+        ratio_percent = std::min<u32>(ratio_percent, 100);
+
+        /* Below the ratio of text, trade text for repetitions; above it, trade text for noise. */
+        /* Both shares are in 1/1000 of all blocks.                                             */
+        u32 repeat_share = 0, noise_share = 0;
+        if (ratio_percent < TextRatioPercent) {
+            repeat_share = 1000 - (ratio_percent * 1000) / TextRatioPercent;
+        } else {
+            noise_share = ((ratio_percent - TextRatioPercent) * 1000) / (100 - TextRatioPercent);
+        }
+
+        for (size_t offset = 0; offset < len; offset += BlockSize) {
+            const size_t block_len = std::min(BlockSize, len - offset);
+
+            const u32 pick = rng.NextBelow(1000);
+            if (pick < noise_share) {
+                FillNoise(rng, out + offset, block_len);
+            } else if (pick < repeat_share && offset >= BlockSize) {
+                const size_t distance = BlockSize * rng.NextInRange(1, static_cast<u32>(std::min(offset, MaxRepeatDistance) / BlockSize));
+                std::memcpy(out + offset, out + offset - distance, block_len);
+            } else {
+                FillText(rng, out + offset, block_len);
+            }
+        }
+    }
+
+}
@@ -0,0 +1,36 @@
+/*
+ * Copyright (c) 2022 Valentin B.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include "gen/gen_random.hpp"
+
+namespace ptor::gen {
+
+    /* The compressed size of text from FillText at the default level, in percent. */
+    constexpr inline u32 TextRatioPercent = 30;
+
+    /* Fills `len` bytes with text made up of common words, which deflates to roughly a quarter. */
+    void FillText(Random &rng, u8 *out, size_t len);
+
+    /* Fills `len` bytes with noise that doesn't compress at all. */
+    void FillNoise(Random &rng, u8 *out, size_t len);
+
+    /* Fills `len` bytes with data that deflates to about `ratio_percent` of its size.   */
+    /* The data is a mix of blocks of text, noise and repetitions of earlier text, so the */
+    /* targeted ratio is met within a few percent for anything beyond a few KiB.          */
+    void FillCompressible(Random &rng, u8 *out, size_t len, u32 ratio_percent);
+
+}
@@ -0,0 +1,271 @@
+/*
+ * Copyright (c) 2022 Valentin B.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <system_error>
+
+#include <fmt/core.h>
+
+#include "gen/gen_archive.hpp"
+#include "gen/gen_object_property.hpp"
+#include "gen/gen_random.hpp"
+#include "util/util_zlib_deflater.hpp"
+
+namespace {
+
+    using namespace ptor;
+
+    struct GeneratorOptions {
+        fs::path output = "corpus";
+        u64 seed = 0;
+        u32 archive_count = 1;
+        gen::ArchiveSpec archive;
+        gen::ObjectSpec object;
+        bool archives = true;
+        bool objects = true;
+    };
+
+    bool ParseInt(const char *str, u64 max, u64 &out) {
+        char *end;
+        errno = 0;
+        out = std::strtoull(str, std::addressof(end), 0);
+        return str != end && *end == 0 && errno == 0 && out <= max;
+    }
+
+    bool ParseInt(const char *str, u32 max, u32 &out) {
+        u64 value;
+        const bool success = ParseInt(str, static_cast<u64>(max), value);
+        out = static_cast<u32>(value);
+        return success;
+    }
+
+    /* Sizes may be given in binary units, as in 64K or 2M. */
+    bool ParseSize(const char *str, u32 &out) {
+        char *end;
+        errno = 0;
+        const u64 value = std::strtoull(str, std::addressof(end), 0);
+
+        u32 shift = 0;
+        bool success = str != end && errno == 0;
+        switch (*end) {
+            case 'k': case 'K': shift = 10; ++end; break;
+            case 'm': case 'M': shift = 20; ++end; break;
+            case 'g': case 'G': shift = 30; ++end; break;
+            default: break;
+        }
+
+        success &= *end == 0 && value <= (std::numeric_limits<u32>::max() >> shift);
+        out = static_cast<u32>(value << shift);
+        return success;
+    }
+
+    bool ParseDistribution(const char *str, gen::SizeDistribution &out) {
+        if (std::strcmp(str, "fixed") == 0) {
+            out = gen::SizeDistribution::Fixed;
+        } else if (std::strcmp(str, "uniform") == 0) {
+            out = gen::SizeDistribution::Uniform;
+        } else if (std::strcmp(str, "log") == 0) {
+            out = gen::SizeDistribution::LogUniform;
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    bool ParseOptions(int argc, char **argv, GeneratorOptions &opts) {
+        auto &archive = opts.archive;
+        for (int i = 1; i < argc; ++i) {
+            const char *name = argv[i];
+
+            /* Switches first, then everything that takes a value. */
+            if (std::strcmp(name, "--no-wad") == 0) {
+                opts.archives = false;
+                continue;
+            } else if (std::strcmp(name, "--no-op") == 0) {
+                opts.objects = false;
+                continue;
+            }
+
+            if (i + 1 >= argc) {
+                return false;
+            }
+            const char *value = argv[++i];
+
+            bool success = true;
+            if (std::strcmp(name, "--output") == 0) {
+                opts.output = value;
+            } else if (std::strcmp(name, "--seed") == 0) {
+                success = ParseInt(value, std::numeric_limits<u64>::max(), opts.seed);
+            } else if (std::strcmp(name, "--archives") == 0) {
+                success = ParseInt(value, 1000u, opts.archive_count);
+            } else if (std::strcmp(name, "--files") == 0) {
+                success = ParseInt(value, std::numeric_limits<u32>::max(), archive.file_count);
+            } else if (std::strcmp(name, "--distribution") == 0) {
+                success = ParseDistribution(value, archive.distribution);
+            } else if (std::strcmp(name, "--min-size") == 0) {
+                success = ParseSize(value, archive.min_size);
+            } else if (std::strcmp(name, "--max-size") == 0) {
+                success = ParseSize(value, archive.max_size);
+            } else if (std::strcmp(name, "--ratio") == 0) {
+                success = ParseInt(value, 100u, archive.ratio_percent);
+            } else if (std::strcmp(name, "--stored") == 0) {
+                success = ParseInt(value, 100u, archive.stored_percent);
+            } else if (std::strcmp(name, "--min-depth") == 0) {
+                success = ParseInt(value, 64u, archive.min_depth);
+            } else if (std::strcmp(name, "--max-depth") == 0) {
+                success = ParseInt(value, 64u, archive.max_depth);
+            } else if (std::strcmp(name, "--fanout") == 0) {
+                success = ParseInt(value, std::numeric_limits<u32>::max(), archive.fanout);
+            } else if (std::strcmp(name, "--level") == 0) {
+                success = ParseInt(value, util::Deflater::MaxLevel, archive.level);
+            } else if (std::strcmp(name, "--version") == 0) {
+                success = ParseInt(value, 2u, archive.version) && archive.version != 0;
+            } else if (std::strcmp(name, "--children") == 0) {
+                success = ParseInt(value, 1'000'000u, opts.object.child_count);
+            } else if (std::strcmp(name, "--optional") == 0) {
+                success = ParseInt(value, 100u, opts.object.optional_percent);
+            } else {
+                return false;
+            }
+
+            if (!success) {
+                return false;
+            }
+        }
+
+        return archive.min_size <= archive.max_size && archive.min_depth <= archive.max_depth;
+    }
+
+    bool WriteBlob(const fs::path &path, const std::vector<u8> &data) {
+        FILE *file = std::fopen(path.string().c_str(), "wb");
+        if (file == nullptr) {
+            return false;
+        }
+
+        bool success = std::fwrite(data.data(), 1, data.size(), file) == data.size();
+        success &= std::fclose(file) == 0;
+        return success;
+    }
+
+    bool GenerateArchives(const GeneratorOptions &opts, gen::Random &rng) {
+        for (u32 i = 0; i < opts.archive_count; ++i) {
+            gen::ArchiveSpec spec = opts.archive;
+            spec.seed = rng.Next();
+
+            const fs::path path = opts.output / fmt::format("synthetic_{:03}.wad", i);
+            gen::ArchiveGenerator generator{spec};
+
+            std::error_code ec;
+            gen::WriteArchive(generator, path, ec);
+            if (ec) {
+                fmt::print(stderr, "Failed to write {}: {}\n", path.string(), ec.message());
+                return false;
+            }
+
+            const u64 content_size = generator.GetContentSize();
+            const u64 data_size    = generator.GetArchiveSize() - generator.GetTable().size();
+            fmt::print("{}: {} files, {} bytes of contents, {} bytes in archive ({:.1f}% of contents)\n",
+                       path.string(), spec.file_count, content_size, generator.GetArchiveSize(),
+                       content_size != 0 ? 100.0 * static_cast<f64>(data_size) / static_cast<f64>(content_size) : 100.0);
+        }
+
+        return true;
+    }
+
+    /* Emits state for every combination of serializer flags, in both deep and shallow mode. */
+    bool GenerateObjects(const GeneratorOptions &opts, gen::Random &rng) {
+        for (const bool shallow : {false, true}) {
+            const fs::path directory = opts.output / "op" / (shallow ? "shallow" : "deep");
+
+            std::error_code ec;
+            if (fs::create_directories(directory, ec); ec) {
+                fmt::print(stderr, "Failed to create {}: {}\n", directory.string(), ec.message());
+                return false;
+            }
+
+            for (u32 flags = 0; flags <= gen::SerializerFlag_All; ++flags) {
+                gen::ObjectSpec spec = opts.object;
+                spec.flags   = flags;
+                spec.shallow = shallow;
+                spec.seed    = rng.Next();
+
+                const fs::path path = directory / fmt::format("flags_{:02X}.bin", flags);
+                if (!WriteBlob(path, gen::BuildObjectProperty(spec))) {
+                    fmt::print(stderr, "Failed to write {}\n", path.string());
+                    return false;
+                }
+            }
+        }
+
+        fmt::print("{}: {} ObjectProperty blobs\n", (opts.output / "op").string(), 2 * (gen::SerializerFlag_All + 1));
+        return true;
+    }
+
+    void PrintGeneratorUsage(const char *name) {
+        fmt::print("Usage: {} [options...]\n\n", name);
+        fmt::print("Generates a corpus of synthetic KIWAD archives and ObjectProperty state. The same\n");
+        fmt::print("options always produce the same files.\n\n");
+        fmt::print("    --output <dir>         the directory to write to; defaults to corpus\n");
+        fmt::print("    --seed <n>             the seed for everything generated; defaults to 0\n");
+        fmt::print("    --archives <n>         the amount of archives to generate; defaults to 1\n");
+        fmt::print("    --files <n>            the amount of files per archive; defaults to 1000\n");
+        fmt::print("    --distribution <kind>  how file sizes are spread: fixed, uniform or log (default)\n");
+        fmt::print("    --min-size <size>      the smallest file size, with an optional K/M/G suffix; defaults to 64\n");
+        fmt::print("    --max-size <size>      the largest file size; defaults to 256K\n");
+        fmt::print("    --ratio <percent>      the targeted compressed size of compressible files; defaults to 30\n");
+        fmt::print("    --stored <percent>     the share of incompressible files; defaults to 10\n");
+        fmt::print("    --min-depth <n>        the least amount of directories above a file; defaults to 3\n");
+        fmt::print("    --max-depth <n>        the most directories above a file; defaults to 3\n");
+        fmt::print("    --fanout <n>           the amount of distinct directories per level; defaults to 8\n");
+        fmt::print("    --level <n>            the zlib compression level, from 0 to 12; defaults to 6\n");
+        fmt::print("    --version <n>          the archive format version, 1 or 2; defaults to 2\n");
+        fmt::print("    --children <n>         the amount of nested objects in ObjectProperty state; defaults to 16\n");
+        fmt::print("    --optional <percent>   the share of optional values that are present; defaults to 50\n");
+        fmt::print("    --no-wad               don't generate any archives\n");
+        fmt::print("    --no-op                don't generate any ObjectProperty state\n");
+    }
+
+}
+
+int main(int argc, char **argv) {
+    GeneratorOptions opts;
+    if (!ParseOptions(argc, argv, opts)) {
+        PrintGeneratorUsage(argv[0]);
+        return 1;
+    }
+
+    std::error_code ec;
+    if (fs::create_directories(opts.output, ec); ec) {
+        fmt::print(stderr, "Failed to create {}: {}\n", opts.output.string(), ec.message());
+        return 1;
+    }
+
+    /* Archives and objects draw from separate sequences, so either stays the same without the other. */
+    ptor::gen::Random archive_rng{opts.seed};
+    ptor::gen::Random object_rng{~opts.seed};
+    if (opts.archives && !GenerateArchives(opts, archive_rng)) {
+        return 1;
+    }
+    if (opts.objects && !GenerateObjects(opts, object_rng)) {
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,231 @@
+/*
+ * Copyright (c) 2022 Valentin B.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gen/gen_object_property.hpp"
+
+#include <bit>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+#include "fmt/core.h"
+
+#include "assert.hpp"
+#include "gen/gen_random.hpp"
+#include "io/io_binary_buffer.hpp"
+#include "util/util_crc32.hpp"
+#include "util/util_encoding.hpp"
+#include "util/util_zlib_deflater.hpp"
+
+namespace ptor::gen {
+
+    namespace {
+
+        constexpr inline std::string_view TypeDeclaration = "class SyntheticObject";
+
+        constexpr inline const char *KindVariants[] = {"Kind_None", "Kind_Small", "Kind_Large", "Kind_Unique"};
+        constexpr inline u32 KindCount = sizeof(KindVariants) / sizeof(KindVariants[0]);
+
+        /* Compact length prefixes switch to the wide form from this length on. */
+        constexpr inline u32 CompactLengthLimit = 1u << 7;
+
+        constexpr inline u32 MaxValueCount = 8;
+
+        /* Null children are rare, but should still be covered. */
+        constexpr inline u32 NullChildDivisor = 16;
+
+        P_ALWAYS_INLINE u32 HashDeclaration(std::string_view declaration) {
+            return util::Crc32(declaration.data(), declaration.size());
+        }
+
+        class ObjectWriter final {
+            P_DISALLOW_COPY_AND_ASSIGN(ObjectWriter);
+            P_DISALLOW_MOVE(ObjectWriter);
+
+        private:
+            io::BinaryBuffer &m_buffer;
+            const ObjectSpec &m_spec;
+            Random &m_rng;
+
+        public:
+            ObjectWriter(io::BinaryBuffer &buffer, const ObjectSpec &spec, Random &rng) : m_buffer{buffer}, m_spec{spec}, m_rng{rng} {}
+
+        private:
+            /* Writes a placeholder for a size in bits and returns its offset. */
+            P_ALWAYS_INLINE ptrdiff_t BeginSize() {
+                m_buffer.WriteValue<u32>(0);
+                return m_buffer.GetCursorOffset() - static_cast<ptrdiff_t>(sizeof(u32));
+            }
+
+            /* Fills in the size in bits of everything from the placeholder at `offset` on. */
+            P_ALWAYS_INLINE void EndSize(ptrdiff_t offset) {
+                const size_t bits = m_buffer.GetPassedBits() - static_cast<size_t>(offset) * BITSIZEOF(u8);
+                util::Encode<u32, std::endian::little>(m_buffer.GetOffsetPtr(offset), static_cast<u32>(bits));
+            }
+
+            template <typename F>
+            void WriteProperty(std::string_view declaration, bool optional, F &&write_value) {
+                /* Optional values may only be left out when the configuration allows it. */
+                const bool may_omit = optional && (m_spec.flags & SerializerFlag_RequireOptionalValues) == 0;
+                const bool present  = !may_omit || m_rng.NextBelow(100) < m_spec.optional_percent;
+
+                if (m_spec.shallow) {
+                    if (may_omit) {
+                        m_buffer.WriteBit(present);
+                    }
+                    if (present) {
+                        write_value();
+                    }
+                } else if (present) {
+                    const ptrdiff_t size_offset = this->BeginSize();
+                    m_buffer.WriteValue<u32>(HashDeclaration(declaration));
+                    write_value();
+                    this->EndSize(size_offset);
+                }
+            }
+
+            void WriteLength(u32 length, bool sequence) {
+                if ((m_spec.flags & SerializerFlag_CompactLengthPrefixes) != 0) {
+                    const bool wide = length >= CompactLengthLimit;
+                    m_buffer.WriteBit(wide);
+                    m_buffer.WriteBits(length, wide ? 31 : 7);
+                } else if (sequence) {
+                    m_buffer.WriteValue<u32>(length);
+                } else {
+                    m_buffer.WriteValue<u16>(static_cast<u16>(length));
+                }
+            }
+
+            void WriteString(std::string_view value) {
+                this->WriteLength(static_cast<u32>(value.size()), false);
+                m_buffer.WriteBytes(value.data(), value.size());
+            }
+
+        public:
+            void WriteObject(u32 child_count) {
+                m_buffer.WriteValue<u32>(HashDeclaration(TypeDeclaration));
+
+                ptrdiff_t size_offset = 0;
+                if (!m_spec.shallow) {
+                    size_offset = this->BeginSize();
+                }
+
+                this->WriteProperty("unsigned int m_id", false, [this] {
+                    m_buffer.WriteValue<u32>(static_cast<u32>(m_rng.Next()));
+                });
+                this->WriteProperty("int m_delta", false, [this] {
+                    m_buffer.WriteValue<i32>(static_cast<i32>(m_rng.Next()));
+                });
+                this->WriteProperty("unsigned char m_level", false, [this] {
+                    m_buffer.WriteValue<u8>(static_cast<u8>(m_rng.NextBelow(100)));
+                });
+                this->WriteProperty("float m_scale", false, [this] {
+                    /* Dividing by a power of two is exact, so the value is the same everywhere. */
+                    const f32 scale = static_cast<f32>(m_rng.NextBelow(1u << 20)) / 1024.0f;
+                    m_buffer.WriteValue<u32>(std::bit_cast<u32>(scale));
+                });
+                this->WriteProperty("bool m_enabled", false, [this] {
+                    m_buffer.WriteBit(m_rng.NextBelow(2) != 0);
+                });
+                this->WriteProperty("std::string m_name", false, [this] {
+                    this->WriteString(fmt::format("Object_{:08X}", static_cast<u32>(m_rng.Next())));
+                });
+                this->WriteProperty("enum Kind m_kind", false, [this] {
+                    const u32 kind = m_rng.NextBelow(KindCount);
+                    if ((m_spec.flags & SerializerFlag_HumanReadableEnums) != 0) {
+                        this->WriteString(KindVariants[kind]);
+                    } else {
+                        m_buffer.WriteValue<u32>(kind);
+                    }
+                });
+                this->WriteProperty("unsigned int m_count", true, [this] {
+                    m_buffer.WriteValue<u32>(m_rng.NextBelow(1000));
+                });
+                this->WriteProperty("std::string m_comment", true, [this] {
+                    /* Long enough to need the wide form of compact length prefixes. */
+                    std::string comment;
+                    const u32 words = m_rng.NextInRange(1, 40);
+                    for (u32 i = 0; i < words; ++i) {
+                        comment += fmt::format("word{} ", m_rng.NextBelow(100));
+                    }
+                    this->WriteString(comment);
+                });
+                this->WriteProperty("std::vector<unsigned int> m_values", false, [this] {
+                    const u32 count = m_rng.NextBelow(MaxValueCount + 1);
+                    this->WriteLength(count, true);
+                    for (u32 i = 0; i < count; ++i) {
+                        m_buffer.WriteValue<u32>(static_cast<u32>(m_rng.Next()));
+                    }
+                });
+                this->WriteProperty("std::vector<class SyntheticObject*> m_children", false, [this, child_count] {
+                    this->WriteLength(child_count, true);
+                    for (u32 i = 0; i < child_count; ++i) {
+                        if (m_rng.NextBelow(NullChildDivisor) == 0) {
+                            m_buffer.WriteValue<u32>(0);
+                        } else {
+                            this->WriteObject(0);
+                        }
+                    }
+                });
+
+                if (!m_spec.shallow) {
+                    this->EndSize(size_offset);
+                }
+            }
+        };
+
+    }
+
+    std::vector<u8> BuildObjectProperty(const ObjectSpec &spec) {
+        Random rng{spec.seed};
+
+        io::BinaryBuffer body;
+        ObjectWriter{body, spec, rng}.WriteObject(spec.child_count);
+
+        /* Values end on any bit, but the state always spans whole bytes. */
+        const size_t body_size = (body.GetPassedBits() + BITSIZEOF(u8) - 1) / BITSIZEOF(u8);
+        const u8 *body_data    = body.GetOffsetPtr(0);
+
+        std::vector<u8> out;
+        const auto append_u32 = [&out](u32 value) {
+            u8 encoded[sizeof(u32)];
+            util::Encode<u32, std::endian::little>(encoded, value);
+            out.insert(out.end(), encoded, encoded + sizeof(u32));
+        };
+
+        if ((spec.flags & SerializerFlag_StatefulFlags) != 0) {
+            append_u32(spec.flags);
+        }
+
+        if ((spec.flags & SerializerFlag_Compressed) != 0) {
+            std::error_code ec;
+            auto deflater = util::Deflater::Allocate(util::Deflater::DefaultLevel, ec);
+            P_ASSERT(!ec, "failed to allocate deflater for synthetic state");
+
+            std::vector<u8> compressed(deflater.GetBound(body_size));
+            compressed.resize(deflater.CompressInto(body_data, body_size, compressed.data(), compressed.size()));
+
+            out.push_back(1);
+            append_u32(static_cast<u32>(body_size));
+            out.insert(out.end(), compressed.begin(), compressed.end());
+        } else {
+            out.insert(out.end(), body_data, body_data + body_size);
+        }
+
+        return out;
+    }
+
+}
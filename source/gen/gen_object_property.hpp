@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2022 Valentin B.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <vector>
+
+#include "ptor_types.hpp"
+
+namespace ptor::gen {
+
+    /* The configuration bits of ObjectProperty serializers; see [--serializer-flags/-f]. */
+    enum SerializerFlags : u32 {
+        SerializerFlag_None                  = 0,
+
+        SerializerFlag_StatefulFlags         = 1 << 0,
+        SerializerFlag_CompactLengthPrefixes = 1 << 1,
+        SerializerFlag_HumanReadableEnums    = 1 << 2,
+        SerializerFlag_Compressed            = 1 << 3,
+        SerializerFlag_RequireOptionalValues = 1 << 4,
+
+        SerializerFlag_All                   = 0x1F,
+    };
+
+    /* Describes synthetic ObjectProperty state of a SerializerBinary instance. */
+    struct ObjectSpec {
+        u32 flags = SerializerFlag_None;
+        bool shallow = false;
+        u32 child_count = 16;       /* The amount of objects in the list of the root object. */
+        u32 optional_percent = 50;  /* The share of optional values which are present.       */
+        u64 seed = 0;
+    };
+
+    /* Builds the binary state of a synthetic object from `spec`. The layout follows the  */
+    /* serializer configuration like this:                                                 */
+    /*                                                                                     */
+    /*   - With stateful flags, the flags lead the data as a u32.                          */
+    /*   - With compression, a u8 tells whether the rest is compressed. If it is, the      */
+    /*     uncompressed size follows as a u32, and then a zlib stream of the rest.         */
+    /*   - An object is the u32 hash of its type, 0 for null, followed by its properties.  */
+    /*     In deep mode, the type hash is followed by the object size in bits as a u32,    */
+    /*     and every property is prefixed with its size in bits and its hash as u32s. The  */
+    /*     sizes include themselves.                                                       */
+    /*   - Optional values may be missing unless they're required. Missing values leave    */
+    /*     out their property in deep mode, or are marked by a presence bit in front of    */
+    /*     every optional value in shallow mode.                                           */
+    /*   - Strings are prefixed with their length as a u16, and lists as a u32. Compact     */
+    /*     length prefixes are a bit instead which selects between a 7 or 31 bit length.   */
+    /*   - Enums are u32 values, or the names of their variants as strings when they're    */
+    /*     human readable.                                                                 */
+    /*   - Bools are single bits; every other value starts at a byte boundary.             */
+    /*                                                                                     */
+    /* Type and property hashes are the CRC32 of their declarations, as the schema is      */
+    /* made up and matches no type list of the game.                                       */
+    std::vector<u8> BuildObjectProperty(const ObjectSpec &spec);
+
+}
@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2022 Valentin B.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include "ptor_defines.hpp"
+#include "ptor_types.hpp"
+
+namespace ptor::gen {
+
+    /* A small and fast generator, so synthetic inputs are the same on every run and platform. */
+    /* Everything derived from it sticks to integer math for the same reason.                  */
+    class Random final {
+    private:
+        u64 m_state;
+
+    public:
+        explicit Random(u64 seed) : m_state{seed} {}
+
+        /* splitmix64; every seed gives a full-period sequence. */
+        P_ALWAYS_INLINE u64 Next() {
+            u64 z = (m_state += 0x9E3779B97F4A7C15);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+            return z ^ (z >> 31);
+        }
+
+        /* Gets a number in [0, bound). The bias for bounds far from a power of two is negligible here. */
+        P_ALWAYS_INLINE u32 NextBelow(u32 bound) {
+            return static_cast<u32>(((this->Next() >> 32) * bound) >> 32);
+        }
+
+        /* Gets a number in [min, max]. */
+        P_ALWAYS_INLINE u32 NextInRange(u32 min, u32 max) {
+            return min + static_cast<u32>(((this->Next() >> 32) * (static_cast<u64>(max - min) + 1)) >> 32);
+        }
+    };
+
+}
@@ -0,0 +1,443 @@
+/*
+ * Copyright (c) 2022 Valentin B.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "io/impl/io_file_writer.os.linux.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <new>
+#include <utility>
+
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "assert.hpp"
+
+namespace ptor::io::impl {
+
+    namespace {
+
+        /* Chains are open/write/close, so every one of them posts three completions. */
+        constexpr inline u32 CqesPerChain = 3;
+
+        /* Completions are tagged with the chain slot they belong to. */
+        constexpr inline u64 ChainTagShift = 8;
+
+        P_ALWAYS_INLINE std::error_code MakeOsError(int err) {
+            return {err, std::system_category()};
+        }
+
+        P_ALWAYS_INLINE int SysSetup(u32 entries, io_uring_params *params) {
+            return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+        }
+
+        P_ALWAYS_INLINE int SysEnter(int fd, u32 to_submit, u32 min_complete, u32 flags) {
+            return static_cast<int>(syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+        }
+
+        P_ALWAYS_INLINE int SysRegister(int fd, u32 opcode, const void *arg, u32 nr_args) {
+            return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+        }
+
+        P_ALWAYS_INLINE u32 LoadAcquire(u32 *ptr) {
+            return std::atomic_ref<u32>{*ptr}.load(std::memory_order_acquire);
+        }
+
+        P_ALWAYS_INLINE void StoreRelease(u32 *ptr, u32 value) {
+            std::atomic_ref<u32>{*ptr}.store(value, std::memory_order_release);
+        }
+
+        bool SupportsRequiredOps(int ring_fd) {
+            constexpr u32 OpCount = 256;
+
+            /* Allocate a probe structure with room for all the opcodes. */
+            const size_t probe_size = sizeof(io_uring_probe) + OpCount * sizeof(io_uring_probe_op);
+            auto *probe = static_cast<io_uring_probe *>(std::calloc(1, probe_size));
+            if (probe == nullptr) {
+                return false;
+            }
+
+            bool supported = false;
+            if (SysRegister(ring_fd, IORING_REGISTER_PROBE, probe, OpCount) == 0) {
+                const auto has_op = [probe](u8 op) {
+                    return op <= probe->last_op && (probe->ops[op].flags & IO_URING_OP_SUPPORTED) != 0;
+                };
+
+                supported = has_op(IORING_OP_OPENAT) && has_op(IORING_OP_WRITE) &&
+                            has_op(IORING_OP_WRITE_FIXED) && has_op(IORING_OP_CLOSE);
+            }
+
+            std::free(probe);
+            return supported;
+        }
+
+    }
+
+    UringFileWriter::UringFileWriter()
+        : m_ring_fd{-1}, m_ring_ptr{nullptr}, m_ring_len{0}, m_sqes{nullptr}, m_sqes_len{0},
+          m_sq_head{nullptr}, m_sq_tail{nullptr}, m_sq_array{nullptr}, m_sq_mask{0}, m_unsubmitted{0},
+          m_cq_head{nullptr}, m_cq_tail{nullptr}, m_cqes{nullptr}, m_cq_mask{0},
+          m_staging{nullptr}, m_fixed_buffers{false}, m_free_buffers{static_cast<u32>(P_LSBLL(StagingBufferCount))},
+          m_chains{}, m_free_chains{static_cast<u32>(P_LSBLL(MaxChains))}, m_active_chains{0}, m_error{}
+    {}
+
+    UringFileWriter::~UringFileWriter() {
+        /* Make sure the kernel is done with all our buffers before we release them. */
+        std::error_code ec;
+        this->Flush(ec);
+
+        if (m_ring_fd >= 0) {
+            close(m_ring_fd);
+        }
+        if (m_sqes != nullptr) {
+            munmap(m_sqes, m_sqes_len);
+        }
+        if (m_ring_ptr != nullptr) {
+            munmap(m_ring_ptr, m_ring_len);
+        }
+        std::free(m_staging);
+    }
+
+    std::unique_ptr<UringFileWriter> UringFileWriter::Create(std::error_code &ec) {
+        /* Reset the error code back into a successful state. */
+        ec.clear();
+
+        std::unique_ptr<UringFileWriter> writer{new (std::nothrow) UringFileWriter()};
+        if (writer == nullptr) {
+            ec = std::make_error_code(std::errc::not_enough_memory);
+            return nullptr;
+        }
+
+        if (writer->Setup(ec); ec) {
+            return nullptr;
+        }
+
+        return writer;
+    }
+
+    void UringFileWriter::Setup(std::error_code &ec) {
+        /* Create the ring itself. */
+        io_uring_params params{};
+        m_ring_fd = SysSetup(QueueDepth, std::addressof(params));
+        if (m_ring_fd < 0) {
+            ec = MakeOsError(errno);
+            return;
+        }
+
+        /* Linked chains need fixed files to be resolved at execution time, which */
+        /* also implies support for direct descriptors in open and close (5.17+). */
+        constexpr u32 RequiredFeatures = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP | IORING_FEAT_LINKED_FILE;
+        if ((params.features & RequiredFeatures) != RequiredFeatures || !SupportsRequiredOps(m_ring_fd)) {
+            ec = std::make_error_code(std::errc::function_not_supported);
+            return;
+        }
+
+        /* Map the submission and completion rings, which share a single mapping. */
+        m_ring_len = std::max(params.sq_off.array + params.sq_entries * sizeof(u32),
+                              params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe));
+        auto *ring = mmap(nullptr, m_ring_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring_fd, IORING_OFF_SQ_RING);
+        if (ring == MAP_FAILED) {
+            ec = MakeOsError(errno);
+            return;
+        }
+        m_ring_ptr = static_cast<u8 *>(ring);
+
+        /* Map the submission queue entries. */
+        m_sqes_len = params.sq_entries * sizeof(io_uring_sqe);
+        auto *sqes = mmap(nullptr, m_sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring_fd, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED) {
+            ec = MakeOsError(errno);
+            return;
+        }
+        m_sqes = static_cast<io_uring_sqe *>(sqes);
+
+        /* Resolve the ring offsets the kernel told us about. */
+        m_sq_head  = reinterpret_cast<u32 *>(m_ring_ptr + params.sq_off.head);
+        m_sq_tail  = reinterpret_cast<u32 *>(m_ring_ptr + params.sq_off.tail);
+        m_sq_array = reinterpret_cast<u32 *>(m_ring_ptr + params.sq_off.array);
+        m_sq_mask  = *reinterpret_cast<u32 *>(m_ring_ptr + params.sq_off.ring_mask);
+        m_cq_head  = reinterpret_cast<u32 *>(m_ring_ptr + params.cq_off.head);
+        m_cq_tail  = reinterpret_cast<u32 *>(m_ring_ptr + params.cq_off.tail);
+        m_cqes     = reinterpret_cast<io_uring_cqe *>(m_ring_ptr + params.cq_off.cqes);
+        m_cq_mask  = *reinterpret_cast<u32 *>(m_ring_ptr + params.cq_off.ring_mask);
+
+        /* Reserve a sparse table of direct descriptors, one for every chain slot. */
+        int files[MaxChains];
+        std::fill(std::begin(files), std::end(files), -1);
+        if (SysRegister(m_ring_fd, IORING_REGISTER_FILES, files, MaxChains) != 0) {
+            ec = MakeOsError(errno);
+            return;
+        }
+
+        /* Allocate the staging buffers. */
+        m_staging = static_cast<u8 *>(std::aligned_alloc(4_KB, StagingBufferCount * StagingBufferSize));
+        if (m_staging == nullptr) {
+            ec = std::make_error_code(std::errc::not_enough_memory);
+            return;
+        }
+
+        /* Try to register them with the kernel; this may fail due to a low RLIMIT_MEMLOCK. */
+        /* We can still write from them without registration, just not quite as cheaply.   */
+        iovec iovecs[StagingBufferCount];
+        for (u32 i = 0; i < StagingBufferCount; ++i) {
+            iovecs[i].iov_base = m_staging + i * StagingBufferSize;
+            iovecs[i].iov_len  = StagingBufferSize;
+        }
+        m_fixed_buffers = SysRegister(m_ring_fd, IORING_REGISTER_BUFFERS, iovecs, StagingBufferCount) == 0;
+    }
+
+    io_uring_sqe *UringFileWriter::GetSqe() {
+        /* We never queue more than `MaxChains` chains, so there's always room. */
+        const u32 tail = *m_sq_tail;
+        P_DEBUG_ASSERT(tail - LoadAcquire(m_sq_head) < QueueDepth);
+
+        const u32 index = tail & m_sq_mask;
+        m_sq_array[index] = index;
+        StoreRelease(m_sq_tail, tail + 1);
+        ++m_unsubmitted;
+
+        auto *sqe = m_sqes + index;
+        std::memset(sqe, 0, sizeof(io_uring_sqe));
+        return sqe;
+    }
+
+    void UringFileWriter::Submit(u32 min_complete, std::error_code &ec) {
+        /* Reset the error code back into a successful state. */
+        ec.clear();
+
+        while (m_unsubmitted != 0 || min_complete != 0) {
+            const u32 flags = (min_complete != 0) ? IORING_ENTER_GETEVENTS : 0;
+            const int res   = SysEnter(m_ring_fd, m_unsubmitted, min_complete, flags);
+            if (res < 0) {
+                if (errno == EINTR || errno == EAGAIN || errno == EBUSY) {
+                    continue;
+                }
+
+                ec = MakeOsError(errno);
+                return;
+            }
+
+            m_unsubmitted -= static_cast<u32>(res);
+            min_complete   = 0;
+        }
+    }
+
+    void UringFileWriter::ReapCompletions() {
+        u32 head = *m_cq_head;
+        const u32 tail = LoadAcquire(m_cq_tail);
+
+        for (; head != tail; ++head) {
+            const auto &cqe   = m_cqes[head & m_cq_mask];
+            const u32 slot    = static_cast<u32>(cqe.user_data >> ChainTagShift);
+            const auto op     = static_cast<u8>(cqe.user_data);
+            auto &chain       = m_chains[slot];
+
+            /* Record the first real failure; requests after it in a chain are canceled. */
+            if (!m_error) {
+                if (cqe.res < 0 && cqe.res != -ECANCELED) {
+                    m_error = MakeOsError(-cqe.res);
+                } else if (op == IORING_OP_WRITE_FIXED || op == IORING_OP_WRITE) {
+                    if (cqe.res >= 0 && static_cast<u32>(cqe.res) != chain.expected_len) {
+                        m_error = std::make_error_code(std::errc::io_error);
+                    }
+                }
+            }
+
+            /* When the whole chain is done, give its resources back. */
+            if (--chain.pending_cqes == 0) {
+                if (chain.staging_buffer >= 0) {
+                    m_free_buffers |= P_BIT(chain.staging_buffer);
+                }
+                m_free_chains |= P_BIT(slot);
+                --m_active_chains;
+            }
+        }
+
+        StoreRelease(m_cq_head, head);
+    }
+
+    u32 UringFileWriter::AcquireChain(std::error_code &ec) {
+        /* Wait for a chain to finish if all of them are in use. */
+        while (m_free_chains == 0) {
+            /* With nothing in flight, nothing would ever wake us up again. */
+            if (m_active_chains == 0 && m_unsubmitted == 0) {
+                ec = std::make_error_code(std::errc::resource_deadlock_would_occur);
+                return 0;
+            }
+            if (this->Submit(1, ec); ec) {
+                return 0;
+            }
+            this->ReapCompletions();
+        }
+
+        const u32 slot = static_cast<u32>(std::countr_zero(m_free_chains));
+        m_free_chains &= ~P_BIT(slot);
+        ++m_active_chains;
+        return slot;
+    }
+
+    u8 *UringFileWriter::AcquireBuffer(size_t size, std::error_code &ec) {
+        /* Reset the error code back into a successful state. */
+        ec.clear();
+
+        if (size > StagingBufferSize) {
+            return nullptr;
+        }
+
+        /* Wait for an in-flight write to give its buffer back, if necessary. */
+        this->ReapCompletions();
+        while (m_free_buffers == 0) {
+            /* With nothing in flight, all the buffers were lost and nothing would ever wake us up. */
+            if (m_active_chains == 0 && m_unsubmitted == 0) {
+                ec = std::make_error_code(std::errc::resource_deadlock_would_occur);
+                return nullptr;
+            }
+            if (this->Submit(1, ec); ec) {
+                return nullptr;
+            }
+            this->ReapCompletions();
+        }
+
+        const u32 index = static_cast<u32>(std::countr_zero(m_free_buffers));
+        m_free_buffers &= ~P_BIT(index);
+        return m_staging + index * StagingBufferSize;
+    }
+
+    void UringFileWriter::ReturnBuffer(i32 staging_buffer) {
+        if (staging_buffer >= 0) {
+            m_free_buffers |= P_BIT(staging_buffer);
+        }
+    }
+
+    void UringFileWriter::ReleaseBuffer(const u8 *data) {
+        const i32 index = this->GetStagingBufferIndex(data);
+        P_ASSERT(index >= 0, "not a staging buffer");
+
+        this->ReturnBuffer(index);
+    }
+
+    i32 UringFileWriter::GetStagingBufferIndex(const u8 *data) const {
+        if (data < m_staging || data >= m_staging + StagingBufferCount * StagingBufferSize) {
+            return -1;
+        }
+
+        return static_cast<i32>((data - m_staging) / StagingBufferSize);
+    }
+
+    void UringFileWriter::SubmitChain(int dirfd, const char *name, const u8 *data, size_t len, i32 staging_buffer, std::error_code &ec) {
+        /* Grab a free chain slot to track the requests. Until it owns the staging buffer, we do. */
+        const u32 slot = this->AcquireChain(ec);
+        if (ec) {
+            this->ReturnBuffer(staging_buffer);
+            return;
+        }
+
+        auto &chain = m_chains[slot];
+        chain.pending_cqes   = CqesPerChain;
+        chain.staging_buffer = staging_buffer;
+        chain.expected_len   = static_cast<u32>(len);
+
+        const u64 tag = static_cast<u64>(slot) << ChainTagShift;
+
+        /* Open the file into the direct descriptor owned by the slot. */
+        /* Direct descriptors are never installed into the file table, */
+        /* so the kernel rejects O_CLOEXEC for them.                   */
+        auto *open_sqe        = this->GetSqe();
+        open_sqe->opcode      = IORING_OP_OPENAT;
+        open_sqe->flags       = IOSQE_IO_LINK;
+        open_sqe->fd          = dirfd;
+        open_sqe->addr        = reinterpret_cast<u64>(name);
+        open_sqe->len         = 0644;
+        open_sqe->open_flags  = O_WRONLY | O_CREAT | O_TRUNC;
+        open_sqe->file_index  = slot + 1;
+        open_sqe->user_data   = tag | IORING_OP_OPENAT;
+
+        /* Write the contents; the close must happen regardless of the outcome. */
+        auto *write_sqe      = this->GetSqe();
+        write_sqe->opcode    = (m_fixed_buffers && staging_buffer >= 0) ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+        write_sqe->flags     = IOSQE_FIXED_FILE | IOSQE_IO_HARDLINK;
+        write_sqe->fd        = static_cast<i32>(slot);
+        write_sqe->addr      = reinterpret_cast<u64>(data);
+        write_sqe->len       = static_cast<u32>(len);
+        write_sqe->off       = 0;
+        write_sqe->buf_index = (write_sqe->opcode == IORING_OP_WRITE_FIXED) ? static_cast<u16>(staging_buffer) : 0;
+        write_sqe->user_data = tag | write_sqe->opcode;
+
+        /* Release the direct descriptor again. */
+        auto *close_sqe       = this->GetSqe();
+        close_sqe->opcode     = IORING_OP_CLOSE;
+        close_sqe->file_index = slot + 1;
+        close_sqe->user_data  = tag | IORING_OP_CLOSE;
+
+        /* Hand the requests to the kernel in batches. */
+        if (m_unsubmitted >= SubmitBatchSize * CqesPerChain) {
+            this->Submit(0, ec);
+        }
+    }
+
+    void UringFileWriter::Write(int dirfd, const char *name, const u8 *data, size_t len, std::error_code &ec) {
+        /* Reset the error code back into a successful state. */
+        ec.clear();
+
+        /* Staging buffers are handed to us; when we fail before queuing them, they go back right away. */
+        const i32 staging_buffer = this->GetStagingBufferIndex(data);
+
+        /* Report errors from previously completed writes as soon as we learn about them. */
+        if (this->ReapCompletions(); m_error) {
+            this->ReturnBuffer(staging_buffer);
+            ec = m_error;
+            return;
+        }
+
+        /* A single write request is limited to 32-bit lengths. */
+        if (len > std::numeric_limits<u32>::max()) {
+            this->ReturnBuffer(staging_buffer);
+            ec = std::make_error_code(std::errc::file_too_large);
+            return;
+        }
+
+        this->SubmitChain(dirfd, name, data, len, staging_buffer, ec);
+    }
+
+    void UringFileWriter::Flush(std::error_code &ec) {
+        /* Reset the error code back into a successful state. */
+        ec.clear();
+
+        /* Submit everything that's queued and wait until all chains completed. */
+        if (this->Submit(0, ec); ec) {
+            return;
+        }
+        while (m_active_chains != 0) {
+            if (this->Submit(1, ec); ec) {
+                return;
+            }
+            this->ReapCompletions();
+        }
+
+        /* Once reported, failures don't carry over into the writes after this. */
+        ec = std::exchange(m_error, {});
+    }
+
+}
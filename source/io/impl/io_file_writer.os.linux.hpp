@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2022 Valentin B.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <memory>
+#include <system_error>
+
+#include "ptor_defines.hpp"
+#include "ptor_types.hpp"
+#include "util/util_literals.hpp"
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+namespace ptor::io::impl {
+
+    /* An io_uring instance which writes files through linked open/write/close chains. */
+    class UringFileWriter final {
+        P_DISALLOW_COPY_AND_ASSIGN(UringFileWriter);
+        P_DISALLOW_MOVE(UringFileWriter);
+
+    public:
+        static constexpr u32 QueueDepth         = 128;
+        static constexpr u32 MaxChains          = 32;
+        static constexpr u32 SubmitBatchSize    = 8;
+        static constexpr u32 StagingBufferCount = 16;
+        static constexpr size_t StagingBufferSize = 256_KB;
+
+        static_assert(MaxChains * 3 <= QueueDepth);
+
+    private:
+        /* An in-flight open/write/close chain for a single file. */
+        struct Chain {
+            u32 pending_cqes;
+            i32 staging_buffer;
+            u32 expected_len;
+        };
+
+    private:
+        int m_ring_fd;
+
+        /* The memory-mapped ring buffers shared with the kernel. */
+        u8 *m_ring_ptr;
+        size_t m_ring_len;
+        io_uring_sqe *m_sqes;
+        size_t m_sqes_len;
+
+        /* Submission queue state. */
+        u32 *m_sq_head;
+        u32 *m_sq_tail;
+        u32 *m_sq_array;
+        u32 m_sq_mask;
+        u32 m_unsubmitted;
+
+        /* Completion queue state. */
+        u32 *m_cq_head;
+        u32 *m_cq_tail;
+        io_uring_cqe *m_cqes;
+        u32 m_cq_mask;
+
+        /* Staging buffers for writes, registered with the kernel when possible. */
+        u8 *m_staging;
+        bool m_fixed_buffers;
+        u32 m_free_buffers;
+
+        /* Chain slots; slot `i` also owns the direct file descriptor `i`. */
+        Chain m_chains[MaxChains];
+        u32 m_free_chains;
+        u32 m_active_chains;
+
+        /* The first error reported by any completed request. */
+        std::error_code m_error;
+
+    private:
+        UringFileWriter();
+
+        void Setup(std::error_code &ec);
+
+        io_uring_sqe *GetSqe();
+
+        void Submit(u32 min_complete, std::error_code &ec);
+
+        void ReapCompletions();
+
+        u32 AcquireChain(std::error_code &ec);
+
+        void ReturnBuffer(i32 staging_buffer);
+
+        void SubmitChain(int dirfd, const char *name, const u8 *data, size_t len, i32 staging_buffer, std::error_code &ec);
+
+    public:
+        ~UringFileWriter();
+
+        static std::unique_ptr<UringFileWriter> Create(std::error_code &ec);
+
+        u8 *AcquireBuffer(size_t size, std::error_code &ec);
+
+        void ReleaseBuffer(const u8 *data);
+
+        i32 GetStagingBufferIndex(const u8 *data) const;
+
+        /* Whether no writes are in flight and all the staging buffers are free. */
+        P_ALWAYS_INLINE bool IsIdle() const {
+            return m_active_chains == 0 && m_unsubmitted == 0 && m_free_buffers == static_cast<u32>(P_LSBLL(StagingBufferCount));
+        }
+
+        void Write(int dirfd, const char *name, const u8 *data, size_t len, std::error_code &ec);
+
+        void Flush(std::error_code &ec);
+    };
+
+}
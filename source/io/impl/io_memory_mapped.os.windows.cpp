@@ -80,7 +80,7 @@ namespace ptor::io::impl {
         return *this;
     }
 
-    void MemoryMappedImpl::Map(HANDLE handle, DWORD protect, DWORD access, size_t offset, size_t len, std::error_code &ec) {
+    void MemoryMappedImpl::Map(HANDLE handle, DWORD protect, DWORD access, size_t offset, size_t len, const MapOptions &options, std::error_code &ec) {
         /* Reset the error code back into a successful state. */
         ec.clear();
 
@@ -123,11 +123,16 @@ namespace ptor::io::impl {
         m_ptr    = static_cast<u8 *>(ptr) + alignment;
         m_len    = len;
         m_handle = new_handle;
+
+        /* Windows has no access pattern hints; populating is the closest we can get. */
+        if (options.populate || options.advice == Advice::WillNeed) {
+            this->Advise(0, len, Advice::WillNeed);
+        }
     }
 
     void MemoryMappedImpl::Unmap() {
         /* If we don't maintain an allocation, we have nothing to do. */
-        if (this->IsMapped()) {
+        if (!this->IsMapped()) {
             return;
         }
 
@@ -137,6 +142,33 @@ namespace ptor::io::impl {
         /* Unmap the file view and close the stored handle. */
         ::UnmapViewOfFile(m_ptr - alignment);
         ::CloseHandle(m_handle);
+
+        /* Reset back into the default object state. */
+        m_ptr    = nullptr;
+        m_len    = 0;
+        m_handle = INVALID_HANDLE_VALUE;
+    }
+
+    void MemoryMappedImpl::Advise(size_t offset, size_t len, Advice advice) {
+        /* If we don't maintain an allocation, we have nothing to do. */
+        if (!this->IsMapped() || len == 0) {
+            return;
+        }
+
+        /* Advice is only a hint; there's nothing to do about failures. */
+        switch (advice) {
+            case Advice::WillNeed: {
+                WIN32_MEMORY_RANGE_ENTRY range{m_ptr + offset, len};
+                ::PrefetchVirtualMemory(::GetCurrentProcess(), 1, std::addressof(range), 0);
+                break;
+            }
+            case Advice::DontNeed:
+                /* Unlocking pages which aren't locked removes them from our working set. */
+                ::VirtualUnlock(m_ptr + offset, len);
+                break;
+            default:
+                break;
+        }
     }
 
     void MemoryMappedImpl::Flush(size_t offset, size_t len, std::error_code &ec) {
@@ -156,7 +188,7 @@ namespace ptor::io::impl {
         ec.clear();
 
         /* If we don't maintain an allocation, we have nothing to do. */
-        if (this->IsMapped()) {
+        if (!this->IsMapped()) {
             return;
         }
 
@@ -23,6 +23,7 @@
 
 #include "ptor_defines.hpp"
 #include "ptor_types.hpp"
+#include "io/io_map_options.hpp"
 
 namespace ptor::io::impl {
 
@@ -53,10 +54,12 @@ namespace ptor::io::impl {
 
         P_ALWAYS_INLINE constexpr size_t GetLength() const { return m_len; }
 
-        void Map(HANDLE handle, DWORD protect, DWORD access, size_t offset, size_t len, std::error_code &ec);
+        void Map(HANDLE handle, DWORD protect, DWORD access, size_t offset, size_t len, const MapOptions &options, std::error_code &ec);
 
         void Unmap();
 
+        void Advise(size_t offset, size_t len, Advice advice);
+
         void Flush(size_t offset, size_t len, std::error_code &ec);
 
         void FlushAsync(size_t offset, size_t len, std::error_code &ec);
@@ -20,6 +20,7 @@
 #include <cerrno>
 #include <system_error>
 
+#include <fcntl.h>
 #include <unistd.h>
 #include <sys/stat.h>
 
@@ -35,16 +36,51 @@ namespace ptor::io::impl {
             return {errno, std::system_category()};
         }
 
+        int GetAdviceFlags(Advice advice) {
+            switch (advice) {
+                case Advice::Sequential:
+                    return MADV_SEQUENTIAL;
+                case Advice::Random:
+                    return MADV_RANDOM;
+                case Advice::WillNeed:
+                    return MADV_WILLNEED;
+                case Advice::DontNeed:
+                    return MADV_DONTNEED;
+                case Advice::Normal:
+                default:
+                    return MADV_NORMAL;
+            }
+        }
+
+        void AdvisePages(int fd, u8 *start, size_t file_offset, size_t len, Advice advice) {
+            /* Advice is only a hint; there's nothing to do about failures. */
+            madvise(start, len, GetAdviceFlags(advice));
+
+        #ifdef POSIX_FADV_DONTNEED
+            /* The above only unmaps the pages. Those which weren't touched through the mapping, */
+            /* e.g. because they were copied by the kernel, must be evicted from the cache too. */
+            if (advice == Advice::DontNeed) {
+                posix_fadvise(fd, static_cast<off_t>(file_offset), static_cast<off_t>(len), POSIX_FADV_DONTNEED);
+            }
+        #else
+            P_UNUSED(fd, file_offset);
+        #endif
+        }
+
     }
 
     MemoryMappedImpl::~MemoryMappedImpl() {
         this->Unmap();
     }
 
-    MemoryMappedImpl::MemoryMappedImpl(MemoryMappedImpl &&rhs) : m_ptr{rhs.m_ptr}, m_len{rhs.m_len} {
+    MemoryMappedImpl::MemoryMappedImpl(MemoryMappedImpl &&rhs)
+        : m_ptr{rhs.m_ptr}, m_len{rhs.m_len}, m_fd{rhs.m_fd}, m_offset{rhs.m_offset}
+    {
         /* Reset rhs back into the default object state. */
-        rhs.m_ptr = nullptr;
-        rhs.m_len = 0;
+        rhs.m_ptr    = nullptr;
+        rhs.m_len    = 0;
+        rhs.m_fd     = -1;
+        rhs.m_offset = 0;
     }
 
     MemoryMappedImpl &MemoryMappedImpl::operator=(MemoryMappedImpl &&rhs) {
@@ -52,17 +88,21 @@ namespace ptor::io::impl {
         this->Unmap();
 
         /* Move the state in rhs over. */
-        m_ptr = rhs.m_ptr;
-        m_len = rhs.m_len;
+        m_ptr    = rhs.m_ptr;
+        m_len    = rhs.m_len;
+        m_fd     = rhs.m_fd;
+        m_offset = rhs.m_offset;
 
         /* Reset rhs back into the default object state. */
-        rhs.m_ptr = nullptr;
-        rhs.m_len = 0;
+        rhs.m_ptr    = nullptr;
+        rhs.m_len    = 0;
+        rhs.m_fd     = -1;
+        rhs.m_offset = 0;
 
         return *this;
     }
 
-    void MemoryMappedImpl::Map(int fd, int protect, int flags, size_t offset, size_t len, std::error_code &ec) {
+    void MemoryMappedImpl::Map(int fd, int protect, int flags, size_t offset, size_t len, const MapOptions &options, std::error_code &ec) {
         /* Reset the error code back into a successful state. */
         ec.clear();
 
@@ -76,6 +116,13 @@ namespace ptor::io::impl {
             return;
         }
 
+    #ifdef MAP_POPULATE
+        /* Prefault the page tables for the whole mapping, if requested. */
+        if (options.populate) {
+            flags |= MAP_POPULATE;
+        }
+    #endif
+
         /* Memory-map the file view and ensure the operation succeeded. */
         auto *ptr = mmap(nullptr, aligned_len, protect, flags, fd, static_cast<off_t>(aligned_offset));
         if (ptr == MAP_FAILED) {
@@ -83,22 +130,71 @@ namespace ptor::io::impl {
             return;
         }
 
+        /* Duplicate the supplied descriptor so that the buffer alone can manage one. */
+        const int new_fd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+        if (new_fd < 0) {
+            munmap(ptr, aligned_len);
+            ec = GetLastOsError();
+            return;
+        }
+
+        /* Apply the access hints for the mapping. */
+        if (options.advice != Advice::Normal) {
+            AdvisePages(new_fd, static_cast<u8 *>(ptr), aligned_offset, aligned_len, options.advice);
+        }
+    #ifdef MADV_HUGEPAGE
+        if (options.huge_pages) {
+            madvise(ptr, aligned_len, MADV_HUGEPAGE);
+        }
+    #endif
+
         /* Commit the newly created state onto this object. */
-        m_ptr = static_cast<u8 *>(ptr) + alignment;
-        m_len = len;
+        m_ptr    = static_cast<u8 *>(ptr) + alignment;
+        m_len    = len;
+        m_fd     = new_fd;
+        m_offset = offset;
     }
 
     void MemoryMappedImpl::Unmap() {
         /* If we don't maintain an allocation, we have nothing to do. */
-        if (this->IsMapped()) {
+        if (!this->IsMapped()) {
             return;
         }
 
         /* Compute the pointer alignment to revert applied offsets from mapping. */
         const size_t alignment = reinterpret_cast<usize>(m_ptr) % PageSize;
 
-        /* Unmap the file view. */
+        /* Unmap the file view and close the stored descriptor. */
         munmap(m_ptr - alignment, m_len + alignment);
+        close(m_fd);
+
+        /* Reset back into the default object state. */
+        m_ptr    = nullptr;
+        m_len    = 0;
+        m_fd     = -1;
+        m_offset = 0;
+    }
+
+    void MemoryMappedImpl::Advise(size_t offset, size_t len, Advice advice) {
+        /* If we don't maintain an allocation, we have nothing to do. */
+        if (!this->IsMapped() || len == 0) {
+            return;
+        }
+
+        /* Compute the page range to advise. Pages only partially covered by the range may */
+        /* still be needed for neighboring data, so they are never released, except for   */
+        /* the last page of the mapping.                                                  */
+        const auto start = reinterpret_cast<usize>(m_ptr + offset);
+        const auto end   = start + len;
+        const usize aligned_start = advice == Advice::DontNeed ? util::AlignUp(start, PageSize) : util::AlignDown(start, PageSize);
+        const bool at_tail        = offset + len == m_len;
+        const usize aligned_end   = advice == Advice::DontNeed && !at_tail ? util::AlignDown(end, PageSize) : util::AlignUp(end, PageSize);
+        if (aligned_start >= aligned_end) {
+            return;
+        }
+
+        const size_t file_offset = m_offset + (aligned_start - reinterpret_cast<usize>(m_ptr));
+        AdvisePages(m_fd, reinterpret_cast<u8 *>(aligned_start), file_offset, aligned_end - aligned_start, advice);
     }
 
     void MemoryMappedImpl::Flush(size_t offset, size_t len, std::error_code &ec) {
@@ -106,7 +202,7 @@ namespace ptor::io::impl {
         ec.clear();
 
         /* If we don't maintain an allocation, we have nothing to do. */
-        if (this->IsMapped()) {
+        if (!this->IsMapped()) {
             return;
         }
 
@@ -126,7 +222,7 @@ namespace ptor::io::impl {
         ec.clear();
 
         /* If we don't maintain an allocation, we have nothing to do. */
-        if (this->IsMapped()) {
+        if (!this->IsMapped()) {
             return;
         }
 
@@ -21,6 +21,7 @@
 
 #include "ptor_defines.hpp"
 #include "ptor_types.hpp"
+#include "io/io_map_options.hpp"
 
 namespace ptor::io::impl {
 
@@ -32,6 +33,10 @@ namespace ptor::io::impl {
         u8 *m_ptr = nullptr;
         size_t m_len = 0;
 
+        /* The underlying file and the offset of the mapping within it. */
+        int m_fd = -1;
+        size_t m_offset = 0;
+
     public:
         constexpr MemoryMappedImpl() = default;
 
@@ -48,10 +53,12 @@ namespace ptor::io::impl {
 
         P_ALWAYS_INLINE constexpr size_t GetLength() const { return m_len; }
 
-        void Map(int fd, int protect, int flags, size_t offset, size_t len, std::error_code &ec);
+        void Map(int fd, int protect, int flags, size_t offset, size_t len, const MapOptions &options, std::error_code &ec);
 
         void Unmap();
 
+        void Advise(size_t offset, size_t len, Advice advice);
+
         void Flush(size_t offset, size_t len, std::error_code &ec);
 
         void FlushAsync(size_t offset, size_t len, std::error_code &ec);
@@ -14,6 +14,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <cstring>
 #include <new>
 
 #include "io/io_binary_buffer.hpp"
@@ -80,9 +81,7 @@ namespace ptor::io {
         RealignCursorToByte();
 
         /* If we don't have enough space to write, allocate more. */
-        if (this->HasSpaceForBytes(len)) {
-            this->Grow(m_capacity * 2);
-        }
+        this->ReserveBytes(len);
 
         /* Copy the bytes to the buffer. */
         std::memcpy(m_cursor, in, len);
@@ -101,9 +100,7 @@ namespace ptor::io {
 
     void BinaryBuffer::WriteBit(bool value) {
         /* If we don't have enough space to write, allocate more. */
-        if (this->HasSpaceForBits(1)) {
-            this->Grow(m_capacity * 2);
-        }
+        this->ReserveBits(1);
 
         /* Write the bit to the buffer. */
         *m_cursor |= (static_cast<u8>(value) << m_bit_offset);
@@ -138,9 +135,7 @@ namespace ptor::io {
 
     void BinaryBuffer::WriteBits(const u32 value, size_t len) {
         /* If we don't have enough space to write, allocate more. */
-        if (this->HasSpaceForBits(len)) {
-            this->Grow(m_capacity * 2);
-        }
+        this->ReserveBits(len);
 
         size_t count = 0;
         while (len != 0) {
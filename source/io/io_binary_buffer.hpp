@@ -15,6 +15,8 @@
  */
 #pragma once
 
+#include <algorithm>
+
 #include "assert.hpp"
 #include "ptor_defines.hpp"
 #include "ptor_types.hpp"
@@ -77,7 +79,7 @@ namespace ptor::io {
         }
 
         P_ALWAYS_INLINE size_t GetRemainingBits() const {
-            return (this->GetRemainingBytes() * BITSIZEOF(u8)) + (BITSIZEOF(u8) - m_bit_offset);
+            return (this->GetRemainingBytes() * BITSIZEOF(u8)) - m_bit_offset;
         }
 
         P_ALWAYS_INLINE size_t GetPassedBytes() const {
@@ -108,6 +110,17 @@ namespace ptor::io {
         /* Binary serialization and deserialization. */
 
     private:
+        /* Grows the buffer so that at least `nbytes` more bytes fit behind the cursor. */
+        P_ALWAYS_INLINE void ReserveBytes(size_t nbytes) {
+            if (!this->HasSpaceForBytes(nbytes)) {
+                this->Grow(std::max(m_capacity * 2, this->GetPassedBytes() + nbytes));
+            }
+        }
+
+        P_ALWAYS_INLINE void ReserveBits(size_t nbits) {
+            this->ReserveBytes((m_bit_offset + nbits + BITSIZEOF(u8) - 1) / BITSIZEOF(u8));
+        }
+
         P_ALWAYS_INLINE void RealignCursorToByte() {
             if (m_bit_offset != 0) {
                 m_cursor += 1;
@@ -154,9 +167,7 @@ namespace ptor::io {
 
             /* If we don't have enough space to write, allocate more. */
             constexpr size_t WriteSize = sizeof(T);
-            if (this->HasSpaceForBytes(WriteSize)) {
-                this->Grow(m_capacity * 2);
-            }
+            this->ReserveBytes(WriteSize);
 
             /* Write the value to the buffer. */
             util::Encode<T, BO>(m_cursor, value);
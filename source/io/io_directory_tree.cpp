@@ -0,0 +1,275 @@
+/*
+ * Copyright (c) 2022 Valentin B.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "io/io_directory_tree.hpp"
+
+#ifdef PTOR_OS_WINDOWS
+    #include <unordered_set>
+#else
+    #include <algorithm>
+    #include <cerrno>
+    #include <numeric>
+    #include <unordered_map>
+
+    #include <fcntl.h>
+    #include <sys/resource.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+#include "assert.hpp"
+
+namespace ptor::io {
+
+    namespace {
+
+        P_ALWAYS_INLINE bool IsSafeComponent(std::string_view component) {
+            return !component.empty() && component != "." && component != "..";
+        }
+
+    #ifndef PTOR_OS_WINDOWS
+
+        /* Keep this many descriptors free for the archive, the rings and the files being written. */
+        constexpr inline rlim_t ReservedFileDescriptors = 128;
+
+        /* There's little to gain from caching more directories than this. */
+        constexpr inline size_t MaxOpenDirectories = 4096;
+
+    #ifdef O_PATH
+        constexpr inline int DirectoryOpenFlags = O_PATH | O_DIRECTORY | O_CLOEXEC;
+    #else
+        constexpr inline int DirectoryOpenFlags = O_RDONLY | O_DIRECTORY | O_CLOEXEC;
+    #endif
+
+        P_ALWAYS_INLINE std::error_code GetLastOsError() {
+            return {errno, std::system_category()};
+        }
+
+    #endif
+
+    }
+
+#ifdef PTOR_OS_WINDOWS
+
+    DirectoryTree::DirectoryTree() = default;
+
+    DirectoryTree::~DirectoryTree() = default;
+
+    void DirectoryTree::RaiseDescriptorLimit() {}
+
+    size_t DirectoryTree::GetDirectoryBudget() {
+        return 0;
+    }
+
+    void DirectoryTree::Create(const fs::path &root, u32 count, const PathCallbackType &get_path, size_t max_open, std::error_code &ec) {
+        P_UNUSED(max_open);
+
+        /* Reset the error code back into a successful state. */
+        ec.clear();
+
+        if (fs::create_directories(root, ec); ec) {
+            return;
+        }
+
+        /* Validate all the paths and create every distinct parent directory once. */
+        std::unordered_set<fs::path::string_type> created;
+        m_full_paths.reserve(count);
+        for (u32 i = 0; i < count; ++i) {
+            const fs::path path{get_path(i)};
+            if (path.empty() || path.has_root_path()) {
+                ec = std::make_error_code(std::errc::invalid_argument);
+                return;
+            }
+            for (const auto &component : path) {
+                if (!IsSafeComponent(component.string())) {
+                    ec = std::make_error_code(std::errc::invalid_argument);
+                    return;
+                }
+            }
+
+            const fs::path full_path = root / path;
+            if (created.insert(full_path.parent_path().native()).second) {
+                if (fs::create_directories(full_path.parent_path(), ec); ec) {
+                    return;
+                }
+            }
+            m_full_paths.push_back(full_path.string());
+        }
+    }
+
+    FileLocation DirectoryTree::Resolve(u32 index) const {
+        return {-1, m_full_paths[index].c_str()};
+    }
+
+#else
+
+    DirectoryTree::DirectoryTree() : m_root_fd{-1} {}
+
+    DirectoryTree::~DirectoryTree() {
+        for (const auto &dir : m_directories) {
+            if (dir.fd >= 0 && dir.fd != m_root_fd) {
+                close(dir.fd);
+            }
+        }
+
+        if (m_root_fd >= 0) {
+            close(m_root_fd);
+        }
+    }
+
+    void DirectoryTree::RaiseDescriptorLimit() {
+        struct rlimit limit{};
+        if (getrlimit(RLIMIT_NOFILE, std::addressof(limit)) != 0) {
+            return;
+        }
+
+        /* We're allowed to raise our own soft limit up to the hard limit. */
+        if (limit.rlim_cur != limit.rlim_max) {
+            struct rlimit raised{limit.rlim_max, limit.rlim_max};
+            setrlimit(RLIMIT_NOFILE, std::addressof(raised));
+        }
+    }
+
+    size_t DirectoryTree::GetDirectoryBudget() {
+        struct rlimit limit{};
+        if (getrlimit(RLIMIT_NOFILE, std::addressof(limit)) != 0) {
+            return 0;
+        }
+
+        if (limit.rlim_cur == RLIM_INFINITY) {
+            return MaxOpenDirectories;
+        }
+        if (limit.rlim_cur <= ReservedFileDescriptors) {
+            return 0;
+        }
+        return std::min<size_t>(limit.rlim_cur - ReservedFileDescriptors, MaxOpenDirectories);
+    }
+
+    void DirectoryTree::Create(const fs::path &root, u32 count, const PathCallbackType &get_path, size_t max_open, std::error_code &ec) {
+        /* Reset the error code back into a successful state. */
+        ec.clear();
+
+        P_ASSERT(m_root_fd < 0, "directory tree was already created");
+
+        /* Create and open the root directory, which all other paths are relative to. */
+        if (fs::create_directories(root, ec); ec) {
+            return;
+        }
+        if (m_root_fd = open(root.c_str(), DirectoryOpenFlags); m_root_fd < 0) {
+            ec = GetLastOsError();
+            return;
+        }
+
+        /* Plan the tree; parents are always assigned lower indices than their children. */
+        std::unordered_map<std::string_view, u32> lookup;
+        m_directories.push_back({{}, 0, m_root_fd});
+        lookup.emplace(std::string_view{}, 0);
+
+        m_files.resize(count);
+        for (u32 i = 0; i < count; ++i) {
+            const std::string_view path = get_path(i);
+            if (path.empty() || path.front() == '/') {
+                ec = std::make_error_code(std::errc::invalid_argument);
+                return;
+            }
+
+            /* Split the path into its parent directory and the file name. */
+            const size_t split = path.rfind('/');
+            const std::string_view parent = split == std::string_view::npos ? std::string_view{} : path.substr(0, split);
+            const size_t name_offset = split == std::string_view::npos ? 0 : split + 1;
+            if (!IsSafeComponent(path.substr(name_offset))) {
+                ec = std::make_error_code(std::errc::invalid_argument);
+                return;
+            }
+
+            /* Most files share their directory with others, so look up the full parent first. */
+            auto it = lookup.find(parent);
+            if (it == lookup.end()) {
+                /* Register every missing directory on the way, outermost first. */
+                size_t start = 0;
+                while (start <= parent.size()) {
+                    const size_t end = std::min(parent.find('/', start), parent.size());
+                    if (!IsSafeComponent(parent.substr(start, end - start))) {
+                        ec = std::make_error_code(std::errc::invalid_argument);
+                        return;
+                    }
+
+                    const std::string_view prefix = parent.substr(0, end);
+                    it = lookup.try_emplace(prefix, static_cast<u32>(m_directories.size())).first;
+                    if (it->second == m_directories.size()) {
+                        m_directories.push_back({prefix, 0, -1});
+                    }
+
+                    start = end + 1;
+                }
+            }
+
+            m_directories[it->second].file_count += 1;
+            m_files[i] = {path.data(), it->second, static_cast<u32>(name_offset)};
+        }
+
+        /* Create all the directories in the planned order. */
+        std::string scratch;
+        for (size_t i = 1; i < m_directories.size(); ++i) {
+            scratch.assign(m_directories[i].path);
+            if (mkdirat(m_root_fd, scratch.c_str(), 0755) != 0 && errno != EEXIST) {
+                ec = GetLastOsError();
+                return;
+            }
+        }
+
+        /* Keep the busiest directories open, as far as the descriptor limit allows. */
+        std::vector<u32> busiest(m_directories.size() - 1);
+        std::iota(busiest.begin(), busiest.end(), 1);
+        const size_t budget = std::min(max_open, busiest.size());
+        std::partial_sort(busiest.begin(), busiest.begin() + budget, busiest.end(), [this](u32 lhs, u32 rhs) {
+            return m_directories[lhs].file_count > m_directories[rhs].file_count;
+        });
+
+        for (size_t i = 0; i < budget; ++i) {
+            auto &dir = m_directories[busiest[i]];
+
+            /* Directories without files of their own are never opened relative to. */
+            if (dir.file_count == 0) {
+                break;
+            }
+
+            /* Running out of descriptors is no error; those files just use the full path. */
+            scratch.assign(dir.path);
+            if (dir.fd = openat(m_root_fd, scratch.c_str(), DirectoryOpenFlags); dir.fd < 0) {
+                break;
+            }
+        }
+    }
+
+    FileLocation DirectoryTree::Resolve(u32 index) const {
+        const auto &file = m_files[index];
+        const auto &dir  = m_directories[file.directory];
+
+        if (dir.fd >= 0) {
+            return {dir.fd, file.path + file.name_offset};
+        } else {
+            return {m_root_fd, file.path};
+        }
+    }
+
+#endif
+
+    void DirectoryTree::Create(const fs::path &root, u32 count, const PathCallbackType &get_path, std::error_code &ec) {
+        return this->Create(root, count, get_path, GetDirectoryBudget(), ec);
+    }
+
+}
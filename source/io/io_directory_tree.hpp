@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2022 Valentin B.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include "ptor_defines.hpp"
+#include "ptor_types.hpp"
+#include "io/io_file_writer.hpp"
+#include "util/util_i_function.hpp"
+
+namespace ptor::io {
+
+    /* The directory structure for a known set of output files.                     */
+    /* All the directories are planned and created in a single pass up front. Where */
+    /* supported, the ones holding the most files are kept open so that files can   */
+    /* be created relative to them without walking the full path every time.       */
+    class DirectoryTree final {
+        P_DISALLOW_COPY_AND_ASSIGN(DirectoryTree);
+        P_DISALLOW_MOVE(DirectoryTree);
+
+    public:
+        /* Yields the root-relative, '/'-separated path of a file. The */
+        /* viewed string must be followed by a NUL terminator.         */
+        using PathCallbackType = util::IFunction<std::string_view(u32)>;
+
+    private:
+    #ifdef PTOR_OS_WINDOWS
+        /* Windows has no notion of directory-relative opens; we keep full paths instead. */
+        std::vector<std::string> m_full_paths;
+    #else
+        struct Directory {
+            std::string_view path;
+            u32 file_count;
+            int fd;
+        };
+
+        struct FileEntry {
+            const char *path;
+            u32 directory;
+            u32 name_offset;
+        };
+
+        int m_root_fd;
+        std::vector<Directory> m_directories;
+        std::vector<FileEntry> m_files;
+    #endif
+
+    public:
+        DirectoryTree();
+
+        ~DirectoryTree();
+
+        /* Creates `root` and all the directories needed for `count` files within it.  */
+        /* The paths returned by `get_path` must outlive this object; unsafe paths,    */
+        /* e.g. absolute ones or those with `..` components, are rejected with errors. */
+        void Create(const fs::path &root, u32 count, const PathCallbackType &get_path, std::error_code &ec);
+
+        /* Same as above, but keeps at most `max_open` directories open. This is useful */
+        /* when several trees share the descriptor limit of the process.                */
+        void Create(const fs::path &root, u32 count, const PathCallbackType &get_path, size_t max_open, std::error_code &ec);
+
+        /* Raises the soft limit on open file descriptors to the hard limit, so that more */
+        /* directories can be kept open. This is meant to be called once at startup.      */
+        static void RaiseDescriptorLimit();
+
+        /* Gets the amount of directories a single tree may keep open in this process. */
+        static size_t GetDirectoryBudget();
+
+        /* Gets the location to create the file with the given index at. */
+        FileLocation Resolve(u32 index) const;
+    };
+
+}
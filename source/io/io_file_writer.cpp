@@ -0,0 +1,392 @@
+/*
+ * Copyright (c) 2022 Valentin B.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "io/io_file_writer.hpp"
+
+#include <cstdio>
+
+#ifndef PTOR_OS_WINDOWS
+    #include <cerrno>
+
+    #include <fcntl.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+#ifdef PTOR_OS_LINUX
+    #include <linux/fs.h>
+    #include <sys/ioctl.h>
+    #include <sys/sendfile.h>
+#endif
+
+#include "io/io_memory_mapped.hpp"
+#include "util/util_alignment.hpp"
+#include "util/util_literals.hpp"
+#include "util/util_scope_guard.hpp"
+
+namespace ptor::io {
+
+    namespace {
+
+    #ifdef PTOR_OS_WINDOWS
+
+        void WriteBlocking(const FileLocation &location, const u8 *data, size_t len, std::error_code &ec) {
+            /* Reset the error code back into a successful state. */
+            ec.clear();
+
+            /* Write the file contents to the designated output file. */
+            FILE *fp = std::fopen(location.name, "wb");
+            if (fp != nullptr) {
+                if (std::fwrite(data, sizeof(u8), len, fp) != len) {
+                    ec = std::make_error_code(std::errc::io_error);
+                }
+                std::fclose(fp);
+            } else {
+                ec = std::make_error_code(std::errc::invalid_argument);
+            }
+        }
+
+    #else
+
+        P_ALWAYS_INLINE std::error_code GetLastOsError() {
+            return {errno, std::system_category()};
+        }
+
+        P_ALWAYS_INLINE int OpenOutputFile(const FileLocation &location) {
+            return openat(location.dirfd, location.name, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        }
+
+        void Preallocate(int fd, size_t len, std::error_code &ec) {
+        #ifdef PTOR_OS_LINUX
+            /* Reserving the blocks up front turns a full disk into an error here rather than a SIGBUS later. */
+            if (fallocate(fd, 0, 0, static_cast<off_t>(len)) == 0) {
+                return;
+            } else if (errno != EOPNOTSUPP) {
+                ec = GetLastOsError();
+                return;
+            }
+        #endif
+
+            /* Filesystems without preallocation support only get a sparse file. */
+            if (ftruncate(fd, static_cast<off_t>(len)) != 0) {
+                ec = GetLastOsError();
+            }
+        }
+
+        void WriteRange(int out_fd, const u8 *data, size_t done, size_t len, std::error_code &ec) {
+            while (done < len) {
+                const ssize_t res = pwrite(out_fd, data + done, len - done, static_cast<off_t>(done));
+                if (res < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+
+                    ec = GetLastOsError();
+                    return;
+                }
+
+                done += static_cast<size_t>(res);
+            }
+        }
+
+        void WriteBlocking(const FileLocation &location, const u8 *data, size_t len, std::error_code &ec) {
+            /* Reset the error code back into a successful state. */
+            ec.clear();
+
+            /* Create the output file relative to its directory. */
+            const int out_fd = OpenOutputFile(location);
+            if (out_fd < 0) {
+                ec = GetLastOsError();
+                return;
+            }
+            P_ON_SCOPE_EXIT { close(out_fd); };
+
+            /* Write the file contents. */
+            WriteRange(out_fd, data, 0, len, ec);
+        }
+
+    #endif
+
+    #ifdef PTOR_OS_LINUX
+
+        /* Reflinks only pay off for larger files; don't bother below this size. */
+        constexpr inline size_t MinReflinkSize = 64_KB;
+
+        /* Below this size, batching the syscalls on the ring is worth more than avoiding the copy. */
+        [[maybe_unused]] constexpr inline size_t MinKernelCopySize = 16_KB;
+
+        P_ALWAYS_INLINE bool IsUnsupportedError(int err) {
+            return err == ENOSYS || err == EOPNOTSUPP || err == ENOTTY || err == EXDEV || err == EINVAL;
+        }
+
+        size_t CloneRange(int out_fd, int in_fd, u64 offset, size_t len, bool &supported) {
+            /* Clones must start and end at block boundaries of the filesystem. */
+            struct stat sb{};
+            if (fstat(in_fd, std::addressof(sb)) != 0 || sb.st_blksize <= 0) {
+                return 0;
+            }
+
+            const auto block_size = static_cast<size_t>(sb.st_blksize);
+            const size_t clone_len = util::AlignDown(len, block_size);
+            if (!util::IsAligned(offset, block_size) || clone_len == 0) {
+                return 0;
+            }
+
+            /* Share the aligned part of the contents with the source file. */
+            file_clone_range range{in_fd, offset, clone_len, 0};
+            if (ioctl(out_fd, FICLONERANGE, std::addressof(range)) != 0) {
+                supported = !IsUnsupportedError(errno) || errno == EINVAL;
+                return 0;
+            }
+
+            return clone_len;
+        }
+
+        size_t CopyRange(int out_fd, int in_fd, u64 offset, size_t done, size_t len, bool &supported) {
+            auto in_off  = static_cast<loff_t>(offset + done);
+            auto out_off = static_cast<loff_t>(done);
+
+            while (done < len) {
+                const ssize_t res = copy_file_range(in_fd, std::addressof(in_off), out_fd, std::addressof(out_off), len - done, 0);
+                if (res <= 0) {
+                    if (res < 0 && errno == EINTR) {
+                        continue;
+                    }
+
+                    supported = !(res < 0 && IsUnsupportedError(errno));
+                    break;
+                }
+
+                done += static_cast<size_t>(res);
+            }
+
+            return done;
+        }
+
+        size_t SendRange(int out_fd, int in_fd, u64 offset, size_t done, size_t len, bool &supported) {
+            /* sendfile() writes at the current position of the output file. */
+            if (lseek(out_fd, static_cast<off_t>(done), SEEK_SET) < 0) {
+                return done;
+            }
+
+            auto in_off = static_cast<off_t>(offset + done);
+            while (done < len) {
+                const ssize_t res = sendfile(out_fd, in_fd, std::addressof(in_off), len - done);
+                if (res <= 0) {
+                    if (res < 0 && errno == EINTR) {
+                        continue;
+                    }
+
+                    supported = !(res < 0 && IsUnsupportedError(errno));
+                    break;
+                }
+
+                done += static_cast<size_t>(res);
+            }
+
+            return done;
+        }
+
+    #endif
+
+    }
+
+    FileWriter::FileWriter() : m_try_reflink{true}, m_try_copy_range{true}, m_try_sendfile{true} {
+    #ifdef PTOR_HAVE_IO_URING
+        /* Kernels may lack io_uring or have it disabled; we fall back to blocking I/O then. */
+        std::error_code ec;
+        m_uring = impl::UringFileWriter::Create(ec);
+    #endif
+    }
+
+    FileWriter::FileWriter(FileWriter &&) = default;
+
+    FileWriter &FileWriter::operator=(FileWriter &&) = default;
+
+    FileWriter::~FileWriter() = default;
+
+    bool FileWriter::IsAsynchronous() const {
+    #ifdef PTOR_HAVE_IO_URING
+        return m_uring != nullptr;
+    #else
+        return false;
+    #endif
+    }
+
+    size_t FileWriter::GetStagingMemorySize() const {
+    #ifdef PTOR_HAVE_IO_URING
+        if (m_uring != nullptr) {
+            return impl::UringFileWriter::StagingBufferCount * impl::UringFileWriter::StagingBufferSize;
+        }
+    #endif
+
+        return 0;
+    }
+
+    bool FileWriter::IsIdle() const {
+    #ifdef PTOR_HAVE_IO_URING
+        if (m_uring != nullptr) {
+            return m_uring->IsIdle();
+        }
+    #endif
+
+        return true;
+    }
+
+    u8 *FileWriter::AcquireBuffer(size_t size, std::error_code &ec) {
+        /* Reset the error code back into a successful state. */
+        ec.clear();
+
+    #ifdef PTOR_HAVE_IO_URING
+        if (m_uring != nullptr) {
+            return m_uring->AcquireBuffer(size, ec);
+        }
+    #endif
+
+        P_UNUSED(size);
+        return nullptr;
+    }
+
+    void FileWriter::ReleaseBuffer(u8 *data) {
+    #ifdef PTOR_HAVE_IO_URING
+        if (m_uring != nullptr) {
+            return m_uring->ReleaseBuffer(data);
+        }
+    #endif
+
+        P_UNUSED(data);
+    }
+
+    void FileWriter::Write(const FileLocation &location, const u8 *data, size_t len, std::error_code &ec) {
+    #ifdef PTOR_HAVE_IO_URING
+        /* Staging buffers are owned by the ring and can be written out asynchronously. */
+        if (m_uring != nullptr && m_uring->GetStagingBufferIndex(data) >= 0) {
+            return m_uring->Write(location.dirfd, location.name, data, len, ec);
+        }
+    #endif
+
+        WriteBlocking(location, data, len, ec);
+    }
+
+    void FileWriter::WritePinned(const FileLocation &location, const u8 *data, size_t len, std::error_code &ec) {
+    #ifdef PTOR_HAVE_IO_URING
+        if (m_uring != nullptr) {
+            return m_uring->Write(location.dirfd, location.name, data, len, ec);
+        }
+    #endif
+
+        WriteBlocking(location, data, len, ec);
+    }
+
+    void FileWriter::WriteFromFile(const FileLocation &location, FILE *source, u64 offset, const u8 *data, size_t len, std::error_code &ec) {
+    #ifdef PTOR_OS_LINUX
+        /* Reset the error code back into a successful state. */
+        ec.clear();
+
+    #ifdef PTOR_HAVE_IO_URING
+        if (m_uring != nullptr && len < MinKernelCopySize) {
+            return m_uring->Write(location.dirfd, location.name, data, len, ec);
+        }
+    #endif
+
+        /* Create the output file relative to its directory. */
+        const int out_fd = OpenOutputFile(location);
+        if (out_fd < 0) {
+            ec = GetLastOsError();
+            return;
+        }
+        P_ON_SCOPE_EXIT { close(out_fd); };
+
+        /* Try the cheapest available mechanism first and let the next one pick up after it. */
+        const int in_fd = fileno(source);
+        size_t done = 0;
+        if (m_try_reflink && len >= MinReflinkSize) {
+            done = CloneRange(out_fd, in_fd, offset, len, m_try_reflink);
+        }
+        if (done < len && m_try_copy_range) {
+            done = CopyRange(out_fd, in_fd, offset, done, len, m_try_copy_range);
+        }
+        if (done < len && m_try_sendfile) {
+            done = SendRange(out_fd, in_fd, offset, done, len, m_try_sendfile);
+        }
+
+        /* Whatever's left is copied out of the mapping. */
+        WriteRange(out_fd, data, done, len, ec);
+    #else
+        P_UNUSED(source, offset);
+        this->Write(location, data, len, ec);
+    #endif
+    }
+
+    void FileWriter::WriteMapped(const FileLocation &location, size_t len, const FillCallbackType &fill, std::error_code &ec) {
+        /* Reset the error code back into a successful state. */
+        ec.clear();
+
+        /* Empty files can't be mapped; just create them. */
+        if (len == 0) {
+            return WriteBlocking(location, nullptr, 0, ec);
+        }
+
+    #ifdef PTOR_OS_WINDOWS
+        /* Create the output file and extend it to its final size. */
+        FILE *fp = std::fopen(location.name, "w+b");
+        if (fp == nullptr) {
+            ec = std::make_error_code(std::errc::invalid_argument);
+            return;
+        }
+        P_ON_SCOPE_EXIT { std::fclose(fp); };
+
+        if (_chsize_s(_fileno(fp), static_cast<__int64>(len)) != 0) {
+            ec = std::make_error_code(std::errc::no_space_on_device);
+            return;
+        }
+
+        auto mapped = ReadWriteMapped::MapWithOffsetAndLength(fp, 0, len, ec);
+    #else
+        /* Create the output file and reserve storage for its final size. */
+        const int fd = openat(location.dirfd, location.name, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            ec = GetLastOsError();
+            return;
+        }
+        P_ON_SCOPE_EXIT { close(fd); };
+
+        if (Preallocate(fd, len, ec); ec) {
+            return;
+        }
+
+        auto mapped = ReadWriteMapped::MapWithOffsetAndLength(fd, 0, len, ec);
+    #endif
+        if (ec) {
+            return;
+        }
+
+        /* Dirty pages are written back by the kernel once the mapping goes away. */
+        fill(mapped.GetPtr(), len, ec);
+    }
+
+    void FileWriter::Flush(std::error_code &ec) {
+        /* Reset the error code back into a successful state. */
+        ec.clear();
+
+    #ifdef PTOR_HAVE_IO_URING
+        if (m_uring != nullptr) {
+            m_uring->Flush(ec);
+        }
+    #endif
+    }
+
+}
@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2022 Valentin B.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstdio>
+#include <memory>
+#include <system_error>
+
+#ifdef PTOR_HAVE_IO_URING
+    #include "io/impl/io_file_writer.os.linux.hpp"
+#endif
+
+#include "ptor_defines.hpp"
+#include "ptor_types.hpp"
+#include "util/util_i_function.hpp"
+
+namespace ptor::io {
+
+    /* Where to create an output file: a name relative to an open directory. */
+    /* On Windows, `dirfd` is unused and `name` always holds a full path.    */
+    struct FileLocation {
+        int dirfd;
+        const char *name;
+    };
+
+    /* Writes the contents of whole files to disk.                                  */
+    /* Where io_uring is available, opening, writing and closing a file are queued  */
+    /* as one linked chain of requests and submitted to the kernel in batches, so   */
+    /* callers can keep producing data while earlier files are still being written. */
+    /* Without it, every write is carried out immediately with blocking calls.      */
+    class FileWriter final {
+        P_DISALLOW_COPY_AND_ASSIGN(FileWriter);
+
+    public:
+        /* Produces the contents of a file in place; invoked as `fill(ptr, len, ec)`. */
+        using FillCallbackType = util::IFunction<void(u8 *, size_t, std::error_code &)>;
+
+    private:
+    #ifdef PTOR_HAVE_IO_URING
+        std::unique_ptr<impl::UringFileWriter> m_uring;
+    #endif
+
+        /* Kernel copy mechanisms we haven't yet found to be unsupported. */
+        bool m_try_reflink;
+        bool m_try_copy_range;
+        bool m_try_sendfile;
+
+    public:
+        FileWriter();
+
+        FileWriter(FileWriter &&);
+
+        FileWriter &operator=(FileWriter &&);
+
+        ~FileWriter();
+
+        /* Whether writes are queued instead of being carried out immediately. */
+        bool IsAsynchronous() const;
+
+        /* Gets the size of the staging buffers this writer holds on to for its whole lifetime. */
+        size_t GetStagingMemorySize() const;
+
+        /* Whether no writes are queued and no staging buffers are handed out. */
+        bool IsIdle() const;
+
+        /* Gets a staging buffer of at least `size` bytes, which is handed back to the writer */
+        /* by passing it to `Write()`. Returns `nullptr` when no such buffer is available.    */
+        u8 *AcquireBuffer(size_t size, std::error_code &ec);
+
+        /* Hands a staging buffer back without writing it, e.g. when producing its contents failed. */
+        void ReleaseBuffer(u8 *data);
+
+        /* Writes `len` bytes at `data` to a file at `location`, truncating existing contents. */
+        /* `data` may be reused as soon as this returns, unless it is a staging buffer. The   */
+        /* name in `location` must stay valid until the next call to `Flush()`.               */
+        void Write(const FileLocation &location, const u8 *data, size_t len, std::error_code &ec);
+
+        /* Same as `Write()`, but `data` is guaranteed to stay valid until `Flush()`. */
+        void WritePinned(const FileLocation &location, const u8 *data, size_t len, std::error_code &ec);
+
+        /* Writes `len` bytes located at `offset` in `source`, which are also accessible at `data`. */
+        /* Where supported, the contents are cloned or copied by the kernel without ever passing  */
+        /* through user space. Small files may be queued like `WritePinned()` instead.            */
+        void WriteFromFile(const FileLocation &location, FILE *source, u64 offset, const u8 *data, size_t len, std::error_code &ec);
+
+        /* Preallocates a file of `len` bytes at `location`, maps it into memory and lets `fill` */
+        /* produce the contents right in the mapping, bypassing all intermediate buffers.       */
+        void WriteMapped(const FileLocation &location, size_t len, const FillCallbackType &fill, std::error_code &ec);
+
+        /* Waits for all queued writes to complete and reports the first failure since the last flush. */
+        void Flush(std::error_code &ec);
+    };
+
+}
@@ -0,0 +1,39 @@
+/*
+ * Copyright (c) 2022 Valentin B.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include "ptor_types.hpp"
+
+namespace ptor::io {
+
+    /* Hints on how a memory-mapped range is going to be accessed. */
+    /* These are best-effort; platforms may ignore any of them.    */
+    enum class Advice {
+        Normal,     /* No particular access pattern.                          */
+        Sequential, /* Read ahead aggressively, free pages soon after use.    */
+        Random,     /* Don't read ahead.                                      */
+        WillNeed,   /* Start reading the range in now.                        */
+        DontNeed,   /* The range was consumed; release its pages if possible. */
+    };
+
+    /* Options for creating a memory mapping. */
+    struct MapOptions {
+        Advice advice   = Advice::Normal; /* Initial advice for the whole mapping.     */
+        bool populate   = false;          /* Prefault all the pages up front.          */
+        bool huge_pages = false;          /* Use transparent huge pages, if available. */
+    };
+
+}
@@ -24,6 +24,7 @@
 #endif
 
 #include "assert.hpp"
+#include "io/io_map_options.hpp"
 
 namespace ptor::io {
 
@@ -52,7 +53,7 @@ namespace ptor::io {
             return impl::GetFileHandle(file);
         }
 
-        P_ALWAYS_INLINE void MapImpl(HandleType handle, size_t offset, size_t len, std::error_code &ec) {
+        P_ALWAYS_INLINE void MapImpl(HandleType handle, size_t offset, size_t len, const MapOptions &options, std::error_code &ec) {
         #ifdef PTOR_OS_WINDOWS
             DWORD access  = FILE_MAP_READ;
             DWORD protect = PAGE_READONLY;
@@ -70,10 +71,10 @@ namespace ptor::io {
             }
         #endif
 
-            m_impl.Map(handle, protect, access, offset, len, ec);
+            m_impl.Map(handle, protect, access, offset, len, options, ec);
         }
 
-        void MapWithOffsetImpl(FILE *file, size_t offset, std::error_code &ec) {
+        void MapWithOffsetImpl(FILE *file, size_t offset, const MapOptions &options, std::error_code &ec) {
             /* Get the raw handle for the given file. */
             const HandleType handle = this->GetFileHandle(file);
 
@@ -96,7 +97,7 @@ namespace ptor::io {
             }
 
             /* Map the file into memory. */
-            this->MapImpl(handle, offset, len, ec);
+            this->MapImpl(handle, offset, len, options, ec);
         }
 
     public:
@@ -105,18 +106,38 @@ namespace ptor::io {
         MemoryMapped &operator=(MemoryMapped &&) = default;
 
         P_ALWAYS_INLINE static MemoryMapped Map(FILE *file, std::error_code &ec) {
-            return MapWithOffset(file, 0, ec);
+            return MapWithOffset(file, 0, {}, ec);
+        }
+
+        P_ALWAYS_INLINE static MemoryMapped Map(FILE *file, const MapOptions &options, std::error_code &ec) {
+            return MapWithOffset(file, 0, options, ec);
         }
 
         P_ALWAYS_INLINE static MemoryMapped MapWithOffset(FILE *file, size_t offset, std::error_code &ec) {
+            return MapWithOffset(file, offset, {}, ec);
+        }
+
+        P_ALWAYS_INLINE static MemoryMapped MapWithOffset(FILE *file, size_t offset, const MapOptions &options, std::error_code &ec) {
             MemoryMapped mapped{};
-            mapped.MapWithOffsetImpl(file, offset, ec);
+            mapped.MapWithOffsetImpl(file, offset, options, ec);
             return mapped;
         }
 
         P_ALWAYS_INLINE static MemoryMapped MapWithOffsetAndLength(FILE *file, size_t offset, size_t len, std::error_code &ec) {
+            return MapWithOffsetAndLength(GetFileHandle(file), offset, len, {}, ec);
+        }
+
+        P_ALWAYS_INLINE static MemoryMapped MapWithOffsetAndLength(FILE *file, size_t offset, size_t len, const MapOptions &options, std::error_code &ec) {
+            return MapWithOffsetAndLength(GetFileHandle(file), offset, len, options, ec);
+        }
+
+        P_ALWAYS_INLINE static MemoryMapped MapWithOffsetAndLength(HandleType handle, size_t offset, size_t len, std::error_code &ec) {
+            return MapWithOffsetAndLength(handle, offset, len, {}, ec);
+        }
+
+        P_ALWAYS_INLINE static MemoryMapped MapWithOffsetAndLength(HandleType handle, size_t offset, size_t len, const MapOptions &options, std::error_code &ec) {
             MemoryMapped mapped{};
-            mapped.MapImpl(mapped.GetFileHandle(file), offset, len, ec);
+            mapped.MapImpl(handle, offset, len, options, ec);
             return mapped;
         }
 
@@ -125,6 +146,13 @@ namespace ptor::io {
 
         P_ALWAYS_INLINE constexpr size_t GetLength() const { return m_impl.GetLength(); }
 
+        /* Hints how the given range of the mapping is going to be accessed from now on.  */
+        /* Streaming consumers may use `Advice::DontNeed` to release what they processed. */
+        P_ALWAYS_INLINE void Advise(size_t offset, size_t len, Advice advice) {
+            P_DEBUG_ASSERT(offset + len <= this->GetLength());
+            m_impl.Advise(offset, len, advice);
+        }
+
         P_ALWAYS_INLINE void Flush(std::error_code &ec) {
             static_assert(Mode == AccessMode::ReadWrite, "can only flush mutable file buffers");
             m_impl.Flush(0, this->GetLength(), ec);
@@ -0,0 +1,233 @@
+/*
+ * Copyright (c) 2022 Valentin B.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "io/io_tar_writer.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <span>
+
+#ifndef PTOR_OS_WINDOWS
+    #include <cerrno>
+
+    #include <sys/uio.h>
+    #include <unistd.h>
+#endif
+
+#include "fmt/format.h"
+
+#include "assert.hpp"
+#include "util/util_alignment.hpp"
+
+namespace ptor::io {
+
+    namespace {
+
+        /* A field of a ustar header. Numbers are stored as zero-padded octal with a terminating NUL. */
+        struct HeaderField {
+            size_t offset;
+            size_t length;
+        };
+
+        constexpr inline HeaderField NameField     = {0, 100};
+        constexpr inline HeaderField ModeField     = {100, 8};
+        constexpr inline HeaderField UidField      = {108, 8};
+        constexpr inline HeaderField GidField      = {116, 8};
+        constexpr inline HeaderField SizeField     = {124, 12};
+        constexpr inline HeaderField MtimeField    = {136, 12};
+        constexpr inline HeaderField ChecksumField = {148, 8};
+        constexpr inline HeaderField TypeField     = {156, 1};
+        constexpr inline HeaderField MagicField    = {257, 6};
+        constexpr inline HeaderField VersionField  = {263, 2};
+        constexpr inline HeaderField PrefixField   = {345, 155};
+
+        constexpr inline char RegularFileType    = '0';
+        constexpr inline char PaxExtendedType    = 'x';
+        constexpr inline u32 RegularFileMode     = 0644;
+        constexpr inline std::string_view PaxHeaderName = "././@PaxHeader";
+
+        /* Padding after data and the end-of-archive marker are made of zeroed blocks. */
+        constexpr inline u8 ZeroBlocks[2 * TarWriter::BlockSize] = {};
+
+        /* A piece of a single write to the stream. */
+        struct WritePart {
+            const u8 *data;
+            size_t len;
+        };
+
+        P_ALWAYS_INLINE void PutString(u8 *header, const HeaderField &field, std::string_view value) {
+            std::memcpy(header + field.offset, value.data(), std::min(value.size(), field.length));
+        }
+
+        P_ALWAYS_INLINE void PutOctal(u8 *header, const HeaderField &field, u64 value) {
+            fmt::format_to_n(reinterpret_cast<char *>(header + field.offset), field.length - 1, "{:0{}o}", value, field.length - 1);
+        }
+
+        void BuildHeader(u8 *header, std::string_view prefix, std::string_view name, u64 size, i64 mtime, char type) {
+            std::memset(header, 0, TarWriter::BlockSize);
+
+            PutString(header, NameField, name);
+            PutOctal(header, ModeField, RegularFileMode);
+            PutOctal(header, UidField, 0);
+            PutOctal(header, GidField, 0);
+            PutOctal(header, SizeField, size);
+            PutOctal(header, MtimeField, static_cast<u64>(std::max<i64>(mtime, 0)));
+            header[TypeField.offset] = static_cast<u8>(type);
+            PutString(header, MagicField, std::string_view{"ustar", 6});
+            PutString(header, VersionField, "00");
+            PutString(header, PrefixField, prefix);
+
+            /* The checksum is computed with its own field filled with spaces; it ends in a NUL and a space. */
+            std::memset(header + ChecksumField.offset, ' ', ChecksumField.length);
+            u32 checksum = 0;
+            for (size_t i = 0; i < TarWriter::BlockSize; ++i) {
+                checksum += header[i];
+            }
+            PutOctal(header, {ChecksumField.offset, ChecksumField.length - 1}, checksum);
+            header[ChecksumField.offset + ChecksumField.length - 2] = 0;
+        }
+
+        /* Splits a path over the prefix and name fields of a ustar header, if it fits. */
+        bool SplitPath(std::string_view path, std::string_view &prefix, std::string_view &name) {
+            if (path.size() <= NameField.length) {
+                prefix = {};
+                name   = path;
+                return true;
+            }
+
+            /* Use the longest prefix that fits; the name must fit the rest, without the separator. */
+            const size_t split = path.rfind('/', PrefixField.length);
+            if (split == std::string_view::npos || split == 0 || split == path.size() - 1 || path.size() - split - 1 > NameField.length) {
+                return false;
+            }
+
+            prefix = path.substr(0, split);
+            name   = path.substr(split + 1);
+            return true;
+        }
+
+        /* A pax record is "<length> <key>=<value>\n", where the length counts its own digits. */
+        size_t GetPaxRecordLength(std::string_view key, std::string_view value) {
+            const size_t base = 1 + key.size() + 1 + value.size() + 1;
+
+            size_t len = base + 1;
+            while (len != base + fmt::formatted_size("{}", len)) {
+                len = base + fmt::formatted_size("{}", len);
+            }
+            return len;
+        }
+
+        void WriteParts(FILE *file, std::span<WritePart> parts, std::error_code &ec) {
+        #ifdef PTOR_OS_WINDOWS
+            for (const auto &part : parts) {
+                if (part.len != 0 && std::fwrite(part.data, 1, part.len, file) != part.len) {
+                    ec = std::make_error_code(std::errc::io_error);
+                    return;
+                }
+            }
+        #else
+            struct iovec iov[4];
+            P_ASSERT(parts.size() <= std::size(iov));
+
+            int count = 0;
+            for (const auto &part : parts) {
+                iov[count++] = {const_cast<u8 *>(part.data), part.len};
+            }
+
+            /* Pipes may accept only part of the data at a time; continue where they left off. */
+            struct iovec *current = iov;
+            while (count > 0) {
+                const ssize_t res = writev(fileno(file), current, count);
+                if (res < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+
+                    ec = {errno, std::system_category()};
+                    return;
+                }
+
+                size_t done = static_cast<size_t>(res);
+                while (count > 0 && done >= current->iov_len) {
+                    done -= current->iov_len;
+                    ++current;
+                    --count;
+                }
+                if (count > 0) {
+                    current->iov_base = static_cast<u8 *>(current->iov_base) + done;
+                    current->iov_len -= done;
+                }
+            }
+        #endif
+        }
+
+    }
+
+    TarWriter::TarWriter(FILE *file, i64 mtime) : m_file{file}, m_mtime{mtime} {
+        /* Writes bypass the stdio buffer where possible, so get rid of anything still in it. */
+        std::fflush(m_file);
+    }
+
+    void TarWriter::Write(std::string_view path, const u8 *data, size_t len, std::error_code &ec) {
+        /* Reset the error code back into a successful state. */
+        ec.clear();
+
+        std::scoped_lock lk{m_mutex};
+        m_headers.clear();
+
+        /* Paths which don't fit the ustar header are stored in a pax extended header before it. */
+        std::string_view prefix, name;
+        if (!SplitPath(path, prefix, name)) {
+            constexpr std::string_view Key = "path";
+            const size_t record_len = GetPaxRecordLength(Key, path);
+
+            m_headers.resize(BlockSize + util::AlignUp(record_len, BlockSize));
+            BuildHeader(m_headers.data(), {}, PaxHeaderName, record_len, m_mtime, PaxExtendedType);
+            fmt::format_to(reinterpret_cast<char *>(m_headers.data() + BlockSize), "{} {}={}\n", record_len, Key, path);
+
+            prefix = {};
+            name   = path.substr(0, NameField.length);
+        }
+
+        const size_t header = m_headers.size();
+        m_headers.resize(header + BlockSize);
+        BuildHeader(m_headers.data() + header, prefix, name, len, m_mtime, RegularFileType);
+
+        /* Write the headers, the contents and the padding of the last block in one go. */
+        WritePart parts[] = {
+            {m_headers.data(), m_headers.size()},
+            {data, len},
+            {ZeroBlocks, util::AlignUp(len, BlockSize) - len},
+        };
+        WriteParts(m_file, parts, ec);
+    }
+
+    void TarWriter::Finish(std::error_code &ec) {
+        /* Reset the error code back into a successful state. */
+        ec.clear();
+
+        std::scoped_lock lk{m_mutex};
+
+        WritePart parts[] = {{ZeroBlocks, sizeof(ZeroBlocks)}};
+        if (WriteParts(m_file, parts, ec); ec) {
+            return;
+        }
+        if (std::fflush(m_file) != 0) {
+            ec = std::make_error_code(std::errc::io_error);
+        }
+    }
+
+}
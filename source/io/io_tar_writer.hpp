@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2022 Valentin B.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstdio>
+#include <mutex>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include "ptor_defines.hpp"
+#include "ptor_types.hpp"
+
+namespace ptor::io {
+
+    /* Writes files into a single POSIX tar stream, such as a file or a pipe to another program.  */
+    /* Entries are plain ustar headers; paths which don't fit into those are carried by a pax     */
+    /* extended header in front. Every entry is written with a single vectored write, which also */
+    /* makes it safe to add files from multiple threads at once.                                 */
+    class TarWriter final {
+        P_DISALLOW_COPY_AND_ASSIGN(TarWriter);
+        P_DISALLOW_MOVE(TarWriter);
+
+    public:
+        /* The size of headers and the granularity of all data in a tar stream. */
+        static constexpr size_t BlockSize = 512;
+
+    private:
+        FILE *m_file;
+        i64 m_mtime;
+        std::mutex m_mutex;
+        std::vector<u8> m_headers;
+
+    public:
+        /* Writes to `file`, which must be open for writing in binary mode. All entries are */
+        /* stamped with a modification time of `mtime`, in seconds since the Unix epoch.     */
+        TarWriter(FILE *file, i64 mtime);
+
+        /* Appends a regular file named `path` with the `len` bytes at `data`. */
+        void Write(std::string_view path, const u8 *data, size_t len, std::error_code &ec);
+
+        /* Ends the stream with the end-of-archive marker and flushes it. */
+        void Finish(std::error_code &ec);
+    };
+
+}
@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) 2022 Valentin B.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+/* The C interface of libprintrospector, for embedding it into other programs and    */
+/* for calling into it through an FFI such as Python's ctypes.                       */
+/*                                                                                   */
+/* Every function reports failures through a `ptor_status` and never aborts on bad  */
+/* input; only broken invariants inside the library do. Memory which the library     */
+/* writes data into is always owned by the caller, and data is written straight     */
+/* into it without any intermediate copies.                                          */
+/*                                                                                   */
+/* Compatibility: functions and constants are only ever added, and the layout of     */
+/* structs only grows at the end. Structs passed to the library start with their    */
+/* size, which callers set to `sizeof` the struct they were compiled against.       */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+    #if defined(PTOR_BUILDING_SHARED_LIBRARY)
+        #define PTOR_API __declspec(dllexport)
+    #elif defined(PTOR_USING_SHARED_LIBRARY)
+        #define PTOR_API __declspec(dllimport)
+    #else
+        #define PTOR_API
+    #endif
+#else
+    #define PTOR_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Increased whenever anything is added to the interface. */
+#define PTOR_API_VERSION 1
+
+typedef int32_t ptor_status;
+
+#define PTOR_OK                     0 /* The operation succeeded.                               */
+#define PTOR_ERROR_INVALID_ARGUMENT 1 /* A null pointer, an out of range index or a bad size.   */
+#define PTOR_ERROR_IO               2 /* Reading from or mapping a file failed.                 */
+#define PTOR_ERROR_NOT_FOUND        3 /* The file or the archive entry doesn't exist.           */
+#define PTOR_ERROR_INVALID_DATA     4 /* The input is malformed, or fails its checksum.         */
+#define PTOR_ERROR_BUFFER_TOO_SMALL 5 /* The output buffer can't hold the result.               */
+#define PTOR_ERROR_OUT_OF_MEMORY    6 /* The library ran out of memory.                         */
+#define PTOR_ERROR_UNSUPPORTED      7 /* The operation isn't implemented by this version.       */
+
+/* Flags for `ptor_archive_read`. */
+#define PTOR_READ_VERIFY_CHECKSUM (1u << 0) /* Check the contents against their CRC32. */
+
+/* The kinds of data a decoder handles. */
+#define PTOR_DATA_ZLIB            0 /* A zlib stream, inflated as is.               */
+#define PTOR_DATA_OBJECT_PROPERTY 1 /* Binary ObjectProperty state of a serializer. */
+
+/* ObjectProperty serializer types, as with [--serializer-type/-s]. */
+#define PTOR_SERIALIZER_BASIC       0
+#define PTOR_SERIALIZER_CORE_OBJECT 1
+#define PTOR_SERIALIZER_MANNEQUIN   2
+
+/* An open archive. All functions taking one are safe to call from several threads at once. */
+typedef struct ptor_archive ptor_archive;
+
+/* A decoder with its working memory. Each one may only be used by one thread at a time. */
+typedef struct ptor_decoder ptor_decoder;
+
+/* The metadata of an archive entry. */
+typedef struct ptor_entry_info {
+    uint32_t size;              /* Set to sizeof(ptor_entry_info) by the caller.            */
+    uint32_t uncompressed_size; /* The size of the contents, and of the buffer to read into. */
+    uint32_t compressed_size;   /* The size of the contents in the archive, if compressed.   */
+    uint32_t checksum;          /* The CRC32 of the uncompressed contents.                   */
+    uint8_t compressed;         /* Whether the contents are compressed.                      */
+    uint8_t reserved[3];
+    uint32_t path_length;       /* The length of the path, without the terminating NUL.      */
+    const char *path;           /* The NUL-terminated path; valid until the archive closes.  */
+} ptor_entry_info;
+
+/* Configures a decoder. */
+typedef struct ptor_decode_options {
+    uint32_t size;              /* Set to sizeof(ptor_decode_options) by the caller. */
+    uint32_t data_kind;         /* One of the PTOR_DATA_* kinds.                     */
+
+    /* ObjectProperty configuration, as with the command line options of the same names. */
+    uint32_t serializer_type;
+    uint32_t serializer_flags;
+    uint32_t property_mask;
+    uint8_t shallow;
+    uint8_t manual_compression;
+    uint8_t reserved[2];
+} ptor_decode_options;
+
+/* Gets the PTOR_API_VERSION the library was built with. */
+PTOR_API uint32_t ptor_get_api_version(void);
+
+/* Gets a static, human-readable description of a status. */
+PTOR_API const char *ptor_status_string(ptor_status status);
+
+/* Opens and maps the archive at `path` and indexes its entries by path. */
+PTOR_API ptor_status ptor_archive_open(const char *path, ptor_archive **out_archive);
+
+/* Closes an archive; passing null does nothing. */
+PTOR_API void ptor_archive_close(ptor_archive *archive);
+
+/* Gets the amount of entries; they're numbered from 0 in the order of the file table. */
+PTOR_API uint32_t ptor_archive_get_entry_count(const ptor_archive *archive);
+
+/* Gets the metadata of the entry at `index`. */
+PTOR_API ptor_status ptor_archive_get_entry(const ptor_archive *archive, uint32_t index, ptor_entry_info *out_info);
+
+/* Looks up the index of the entry with the `path_length` bytes long path at `path`. */
+PTOR_API ptor_status ptor_archive_find(const ptor_archive *archive, const char *path, size_t path_length, uint32_t *out_index);
+
+/* Reads the uncompressed contents of the entry at `index` into the caller's buffer. When it's  */
+/* too small, nothing is read and `out_length` receives the required size, if not null.         */
+/* Otherwise, `out_length` receives the amount of bytes written.                                */
+PTOR_API ptor_status ptor_archive_read(ptor_archive *archive, uint32_t index, void *buffer, size_t buffer_length, uint32_t flags, size_t *out_length);
+
+/* Creates a decoder for the given kind of data. ObjectProperty decoders can be created, */
+/* but decoding with them fails with PTOR_ERROR_UNSUPPORTED until the library does it.   */
+PTOR_API ptor_status ptor_decoder_create(const ptor_decode_options *options, ptor_decoder **out_decoder);
+
+/* Destroys a decoder; passing null does nothing. */
+PTOR_API void ptor_decoder_destroy(ptor_decoder *decoder);
+
+/* Decodes the `length` bytes at `data` into the caller's buffer and stores the amount of bytes */
+/* written in `out_length`. Output which doesn't fit makes the call fail; the required size of  */
+/* zlib streams isn't known up front, so callers retry with a larger buffer.                    */
+PTOR_API ptor_status ptor_decoder_decode(ptor_decoder *decoder, const void *data, size_t length, void *buffer, size_t buffer_length, size_t *out_length);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,245 @@
+/*
+ * Copyright (c) 2022 Valentin B.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "lib/printrospector.h"
+
+#include <new>
+#include <optional>
+#include <string_view>
+#include <system_error>
+
+#include "ptor_defines.hpp"
+#include "ptor_types.hpp"
+#include "util/util_crc32.hpp"
+#include "util/util_zlib_inflater.hpp"
+#include "wad/wad_archive_reader.hpp"
+
+struct ptor_archive {
+    /* Reads go straight into caller memory, so the entry cache stays unused. */
+    ptor::wad::ArchiveReader reader{0};
+};
+
+struct ptor_decoder {
+    ptor_decode_options options;
+    std::optional<ptor::util::Inflater> inflater;
+};
+
+namespace {
+
+    using namespace ptor;
+
+    /* The sizes of the structs in the first version of the interface. */
+    constexpr inline u32 EntryInfoSizeV1     = sizeof(ptor_entry_info);
+    constexpr inline u32 DecodeOptionsSizeV1 = sizeof(ptor_decode_options);
+
+    ptor_status GetStatus(const std::error_code &ec) {
+        if (!ec) {
+            return PTOR_OK;
+        }
+
+        if (ec == std::errc::no_such_file_or_directory) {
+            return PTOR_ERROR_NOT_FOUND;
+        } else if (ec == std::errc::illegal_byte_sequence || ec == std::errc::invalid_argument) {
+            return PTOR_ERROR_INVALID_DATA;
+        } else if (ec == std::errc::no_buffer_space) {
+            return PTOR_ERROR_BUFFER_TOO_SMALL;
+        } else if (ec == std::errc::not_enough_memory) {
+            return PTOR_ERROR_OUT_OF_MEMORY;
+        } else {
+            return PTOR_ERROR_IO;
+        }
+    }
+
+}
+
+extern "C" {
+
+    uint32_t ptor_get_api_version(void) {
+        return PTOR_API_VERSION;
+    }
+
+    const char *ptor_status_string(ptor_status status) {
+        switch (status) {
+            case PTOR_OK:                     return "success";
+            case PTOR_ERROR_INVALID_ARGUMENT: return "invalid argument";
+            case PTOR_ERROR_IO:               return "I/O error";
+            case PTOR_ERROR_NOT_FOUND:        return "not found";
+            case PTOR_ERROR_INVALID_DATA:     return "invalid data";
+            case PTOR_ERROR_BUFFER_TOO_SMALL: return "buffer too small";
+            case PTOR_ERROR_OUT_OF_MEMORY:    return "out of memory";
+            case PTOR_ERROR_UNSUPPORTED:      return "unsupported";
+            default:                          return "unknown status";
+        }
+    }
+
+    ptor_status ptor_archive_open(const char *path, ptor_archive **out_archive) {
+        if (path == nullptr || out_archive == nullptr) {
+            return PTOR_ERROR_INVALID_ARGUMENT;
+        }
+        *out_archive = nullptr;
+
+        auto *archive = new (std::nothrow) ptor_archive;
+        if (archive == nullptr) {
+            return PTOR_ERROR_OUT_OF_MEMORY;
+        }
+
+        std::error_code ec;
+        archive->reader.Open(path, ec);
+        if (ec) {
+            delete archive;
+            return GetStatus(ec);
+        }
+
+        *out_archive = archive;
+        return PTOR_OK;
+    }
+
+    void ptor_archive_close(ptor_archive *archive) {
+        delete archive;
+    }
+
+    uint32_t ptor_archive_get_entry_count(const ptor_archive *archive) {
+        return archive != nullptr ? archive->reader.GetArchive().GetFileCount() : 0;
+    }
+
+    ptor_status ptor_archive_get_entry(const ptor_archive *archive, uint32_t index, ptor_entry_info *out_info) {
+        if (archive == nullptr || out_info == nullptr || out_info->size < EntryInfoSizeV1) {
+            return PTOR_ERROR_INVALID_ARGUMENT;
+        }
+
+        const auto &files = archive->reader.GetArchive().GetFiles();
+        if (index >= files.GetCount()) {
+            return PTOR_ERROR_INVALID_ARGUMENT;
+        }
+
+        const auto path = files.GetPath(index);
+        out_info->uncompressed_size = files.GetUncompressedSize(index);
+        out_info->compressed_size   = files.IsCompressed(index) ? files.GetStoredSize(index) : 0;
+        out_info->checksum          = files.GetChecksum(index);
+        out_info->compressed        = files.IsCompressed(index) ? 1 : 0;
+        out_info->path_length       = static_cast<u32>(path.size());
+        out_info->path              = path.data();
+        return PTOR_OK;
+    }
+
+    ptor_status ptor_archive_find(const ptor_archive *archive, const char *path, size_t path_length, uint32_t *out_index) {
+        if (archive == nullptr || (path == nullptr && path_length != 0) || out_index == nullptr) {
+            return PTOR_ERROR_INVALID_ARGUMENT;
+        }
+
+        const auto index = archive->reader.Find(std::string_view{path, path_length});
+        if (!index.has_value()) {
+            return PTOR_ERROR_NOT_FOUND;
+        }
+
+        *out_index = *index;
+        return PTOR_OK;
+    }
+
+    ptor_status ptor_archive_read(ptor_archive *archive, uint32_t index, void *buffer, size_t buffer_length, uint32_t flags, size_t *out_length) {
+        if (archive == nullptr || (buffer == nullptr && buffer_length != 0)) {
+            return PTOR_ERROR_INVALID_ARGUMENT;
+        }
+
+        const auto &files = archive->reader.GetArchive().GetFiles();
+        if (index >= files.GetCount()) {
+            return PTOR_ERROR_INVALID_ARGUMENT;
+        }
+
+        /* Tell the caller how much room it needs before anything is done. */
+        const u32 size = files.GetUncompressedSize(index);
+        if (out_length != nullptr) {
+            *out_length = size;
+        }
+        if (buffer_length < size) {
+            return PTOR_ERROR_BUFFER_TOO_SMALL;
+        }
+
+        std::error_code ec;
+        archive->reader.ReadInto(index, {static_cast<u8 *>(buffer), buffer_length}, ec);
+        if (ec) {
+            return GetStatus(ec);
+        }
+
+        if ((flags & PTOR_READ_VERIFY_CHECKSUM) != 0 && util::Crc32(buffer, size) != files.GetChecksum(index)) {
+            return PTOR_ERROR_INVALID_DATA;
+        }
+        return PTOR_OK;
+    }
+
+    ptor_status ptor_decoder_create(const ptor_decode_options *options, ptor_decoder **out_decoder) {
+        if (options == nullptr || options->size < DecodeOptionsSizeV1 || out_decoder == nullptr) {
+            return PTOR_ERROR_INVALID_ARGUMENT;
+        }
+        *out_decoder = nullptr;
+
+        switch (options->data_kind) {
+            case PTOR_DATA_ZLIB:
+                break;
+            case PTOR_DATA_OBJECT_PROPERTY:
+                if (options->serializer_type > PTOR_SERIALIZER_MANNEQUIN) {
+                    return PTOR_ERROR_INVALID_ARGUMENT;
+                }
+                break;
+            default:
+                return PTOR_ERROR_INVALID_ARGUMENT;
+        }
+
+        auto *decoder = new (std::nothrow) ptor_decoder;
+        if (decoder == nullptr) {
+            return PTOR_ERROR_OUT_OF_MEMORY;
+        }
+        decoder->options      = *options;
+        decoder->options.size = DecodeOptionsSizeV1;
+
+        /* The inflater is set up once here, so decoding many blobs pays for it only once. */
+        std::error_code ec;
+        auto inflater = util::Inflater::Allocate(0, ec);
+        if (ec) {
+            delete decoder;
+            return GetStatus(ec);
+        }
+        decoder->inflater.emplace(std::move(inflater));
+
+        *out_decoder = decoder;
+        return PTOR_OK;
+    }
+
+    void ptor_decoder_destroy(ptor_decoder *decoder) {
+        delete decoder;
+    }
+
+    ptor_status ptor_decoder_decode(ptor_decoder *decoder, const void *data, size_t length, void *buffer, size_t buffer_length, size_t *out_length) {
+        if (decoder == nullptr || (data == nullptr && length != 0) || (buffer == nullptr && buffer_length != 0) || out_length == nullptr) {
+            return PTOR_ERROR_INVALID_ARGUMENT;
+        }
+        *out_length = 0;
+
+        if (decoder->options.data_kind == PTOR_DATA_OBJECT_PROPERTY) {
+            return PTOR_ERROR_UNSUPPORTED;
+        }
+
+        std::error_code ec;
+        const size_t written = decoder->inflater->DecompressInto(data, length, static_cast<u8 *>(buffer), buffer_length, ec);
+        if (ec) {
+            return GetStatus(ec);
+        }
+
+        *out_length = written;
+        return PTOR_OK;
+    }
+
+}
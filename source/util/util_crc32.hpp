@@ -0,0 +1,31 @@
+/*
+ * Copyright (c) 2022 Valentin B.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include "libdeflate.h"
+
+#include "ptor_defines.hpp"
+#include "ptor_types.hpp"
+
+namespace ptor::util {
+
+    /* Computes the CRC32 checksum of `len` bytes at `data`, continuing from `crc`. */
+    /* libdeflate picks the fastest implementation the CPU supports at runtime.    */
+    P_ALWAYS_INLINE u32 Crc32(const void *data, size_t len, u32 crc = 0) {
+        return libdeflate_crc32(crc, data, len);
+    }
+
+}
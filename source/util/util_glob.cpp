@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2022 Valentin B.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "util/util_glob.hpp"
+
+namespace ptor::util {
+
+    namespace {
+
+        /* Matches `c` against the character class at the start of `pattern`, which is */
+        /* consumed. A class without a closing bracket is treated as a literal '['.    */
+        bool MatchClass(std::string_view &pattern, char c) {
+            size_t i = 1;
+            const bool negate = i < pattern.size() && (pattern[i] == '!' || pattern[i] == '^');
+            if (negate) {
+                ++i;
+            }
+
+            bool matched = false;
+            const size_t first = i;
+            for (; i < pattern.size() && (pattern[i] != ']' || i == first); ++i) {
+                /* Ranges need a character on both sides of the dash. */
+                if (i + 2 < pattern.size() && pattern[i + 1] == '-' && pattern[i + 2] != ']') {
+                    matched |= pattern[i] <= c && c <= pattern[i + 2];
+                    i += 2;
+                } else {
+                    matched |= pattern[i] == c;
+                }
+            }
+
+            if (i == pattern.size()) {
+                pattern.remove_prefix(1);
+                return c == '[';
+            }
+
+            pattern.remove_prefix(i + 1);
+            return matched != negate && c != '/';
+        }
+
+        /* With `star` set, the pattern is matched as if it started with a single star. */
+        bool MatchImpl(std::string_view pattern, std::string_view path, bool star = false) {
+            /* The most recent single star, and where it stopped consuming the path. */
+            std::string_view star_pattern = pattern;
+            std::string_view star_path    = path;
+            bool has_star = star;
+
+            while (true) {
+                bool matched = false;
+                if (pattern.empty()) {
+                    if (path.empty()) {
+                        return true;
+                    }
+                } else {
+                    switch (pattern.front()) {
+                        case '*': {
+                            if (pattern.size() >= 2 && pattern[1] == '*') {
+                                /* "**" followed by '/' also matches zero directories. Otherwise it */
+                                /* behaves like "*" started at the beginning of any path component. */
+                                if (pattern.size() == 2) {
+                                    return true;
+                                }
+                                const bool zero_dirs = pattern[2] == '/';
+                                const std::string_view rest = pattern.substr(zero_dirs ? 3 : 2);
+                                for (size_t i = 0; ; ++i) {
+                                    if (MatchImpl(rest, path.substr(i), !zero_dirs)) {
+                                        return true;
+                                    }
+                                    if (i = path.find('/', i); i == std::string_view::npos) {
+                                        break;
+                                    }
+                                }
+                                break;
+                            }
+
+                            /* Match nothing first and consume more on mismatches. */
+                            pattern.remove_prefix(1);
+                            star_pattern = pattern;
+                            star_path    = path;
+                            has_star     = true;
+                            continue;
+                        }
+
+                        case '?':
+                            matched = !path.empty() && path.front() != '/';
+                            pattern.remove_prefix(1);
+                            break;
+
+                        case '[':
+                            matched = !path.empty() && MatchClass(pattern, path.front());
+                            break;
+
+                        case '\\':
+                            if (pattern.size() >= 2) {
+                                pattern.remove_prefix(1);
+                            }
+                            P_FALLTHROUGH;
+
+                        default:
+                            matched = !path.empty() && path.front() == pattern.front();
+                            pattern.remove_prefix(1);
+
+                            /* Stars can't cross a matched '/', so there's nothing left to retry. */
+                            if (matched && path.front() == '/') {
+                                has_star = false;
+                            }
+                            break;
+                    }
+                }
+
+                if (matched) {
+                    path.remove_prefix(1);
+                    continue;
+                }
+
+                /* A single star never crosses into the next path component. */
+                if (!has_star || star_path.empty() || star_path.front() == '/') {
+                    return false;
+                }
+                star_path.remove_prefix(1);
+                pattern = star_pattern;
+                path    = star_path;
+            }
+        }
+
+    }
+
+    bool MatchGlob(std::string_view pattern, std::string_view path) {
+        return MatchImpl(pattern, path);
+    }
+
+}
@@ -0,0 +1,36 @@
+/*
+ * Copyright (c) 2022 Valentin B.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <string_view>
+
+#include "ptor_defines.hpp"
+#include "ptor_types.hpp"
+
+namespace ptor::util {
+
+    /* Matches a '/'-separated path against a glob pattern. Supported syntax: */
+    /*                                                                          */
+    /*   ?      - any single character except '/'                              */
+    /*   *      - any run of characters within a single path component         */
+    /*   **     - any run of characters, including '/'; "**" followed by '/'   */
+    /*            may also match no directories at all                         */
+    /*   [abc]  - any character of a set; ranges like [a-z] and negation with  */
+    /*            [!abc] are supported                                          */
+    /*   \c     - the literal character c                                      */
+    bool MatchGlob(std::string_view pattern, std::string_view path);
+
+}
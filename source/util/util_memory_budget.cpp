@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) 2022 Valentin B.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "util/util_memory_budget.hpp"
+
+#include <algorithm>
+
+#include "assert.hpp"
+
+namespace ptor::util {
+
+    MemoryBudget::MemoryBudget(size_t limit) : m_limit{limit}, m_reserved{0} {}
+
+    size_t MemoryBudget::Reserve(size_t size) {
+        if (!this->IsLimited()) {
+            return 0;
+        }
+
+        size = std::min(size, m_limit);
+
+        std::unique_lock lk{m_mutex};
+        m_released.wait(lk, [this, size] { return m_reserved + size <= m_limit; });
+        m_reserved += size;
+
+        return size;
+    }
+
+    void MemoryBudget::Release(size_t size) {
+        if (size == 0) {
+            return;
+        }
+
+        {
+            std::scoped_lock lk{m_mutex};
+            P_DEBUG_ASSERT(size <= m_reserved);
+            m_reserved -= size;
+        }
+        m_released.notify_all();
+    }
+
+}
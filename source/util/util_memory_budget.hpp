@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2022 Valentin B.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+
+#include "ptor_defines.hpp"
+#include "ptor_types.hpp"
+
+namespace ptor::util {
+
+    /* A limit on the combined size of memory that workers hold at the same time.      */
+    /* Workers reserve the memory they are about to use and wait while the budget is  */
+    /* exhausted, until other workers release theirs. A limit of 0 means no limit.     */
+    class MemoryBudget final {
+        P_DISALLOW_COPY_AND_ASSIGN(MemoryBudget);
+        P_DISALLOW_MOVE(MemoryBudget);
+
+    private:
+        std::mutex m_mutex;
+        std::condition_variable m_released;
+        size_t m_limit;
+        size_t m_reserved;
+
+    public:
+        explicit MemoryBudget(size_t limit);
+
+        P_ALWAYS_INLINE bool IsLimited() const { return m_limit != 0; }
+
+        P_ALWAYS_INLINE size_t GetLimit() const { return m_limit; }
+
+        /* Reserves `size` bytes, waiting for other reservations to be released if needed.  */
+        /* Requests larger than the whole budget wait until they can take all of it, so they */
+        /* can still proceed on their own. Returns the amount which has to be released.      */
+        size_t Reserve(size_t size);
+
+        /* Releases `size` bytes of an earlier reservation. */
+        void Release(size_t size);
+    };
+
+}
@@ -0,0 +1,190 @@
+/*
+ * Copyright (c) 2022 Valentin B.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "util/util_thread_pool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+#include "assert.hpp"
+
+namespace ptor::util {
+
+    namespace {
+
+        constexpr inline size_t CacheLineSize = 64;
+
+        /* The queue of a single worker, padded to avoid false sharing with its siblings. */
+        /* Worker `w` owns the items `w`, `w + n`, `w + 2n`, ... for `n` workers in total. */
+        struct alignas(CacheLineSize) WorkQueue {
+            std::atomic<u32> cursor{0};
+        };
+
+    }
+
+    struct ThreadPool::RunState {
+        const ThreadPool::CallbackType &fn;
+        const ThreadPool::FinishCallbackType *finish;
+        std::unique_ptr<WorkQueue[]> queues;
+        u32 workers;
+        u32 count;
+        std::atomic<bool> cancelled{false};
+    };
+
+    namespace {
+
+        P_ALWAYS_INLINE bool PopItem(ThreadPool::RunState &state, u32 owner, u32 &out) {
+            /* Owner and thieves advance the same cursor, so every item is handed out exactly once. */
+            const u64 k    = state.queues[owner].cursor.fetch_add(1, std::memory_order_relaxed);
+            const u64 item = static_cast<u64>(owner) + k * state.workers;
+            if (item >= state.count) {
+                return false;
+            }
+
+            out = static_cast<u32>(item);
+            return true;
+        }
+
+        void DrainQueues(ThreadPool::RunState &state, u32 worker) {
+            /* Drain our own queue first, then go through the siblings' queues in order. */
+            for (u32 i = 0; i < state.workers; ++i) {
+                const u32 victim = (worker + i) % state.workers;
+
+                u32 item;
+                while (PopItem(state, victim, item)) {
+                    if (state.cancelled.load(std::memory_order_relaxed)) {
+                        return;
+                    }
+
+                    if (!state.fn(worker, item)) {
+                        state.cancelled.store(true, std::memory_order_relaxed);
+                        return;
+                    }
+                }
+            }
+        }
+
+        void WorkerMain(ThreadPool::RunState &state, u32 worker) {
+            DrainQueues(state, worker);
+
+            if (state.finish != nullptr) {
+                (*state.finish)(worker);
+            }
+        }
+
+    }
+
+    ThreadPool::ThreadPool(u32 workers)
+        : m_workers{std::max<u32>(workers, 1)}, m_state{nullptr}, m_generation{0}, m_run_workers{0}, m_pending{0}, m_stopping{false} {}
+
+    ThreadPool::~ThreadPool() {
+        {
+            std::scoped_lock lk{m_mutex};
+            m_stopping = true;
+        }
+        m_wake_cv.notify_all();
+
+        for (auto &thread : m_threads) {
+            thread.join();
+        }
+    }
+
+    u32 ThreadPool::GetDefaultWorkerCount() {
+        return std::max<u32>(std::thread::hardware_concurrency(), 1);
+    }
+
+    bool ThreadPool::Run(u32 count, const CallbackType &fn) {
+        return this->RunImpl(count, fn, nullptr);
+    }
+
+    bool ThreadPool::Run(u32 count, const CallbackType &fn, const FinishCallbackType &finish) {
+        return this->RunImpl(count, fn, std::addressof(finish));
+    }
+
+    bool ThreadPool::RunImpl(u32 count, const CallbackType &fn, const FinishCallbackType *finish) {
+        /* Don't wake up more workers than there are items to process. */
+        const u32 workers = std::clamp<u32>(count, 1, m_workers);
+
+        RunState state{fn, finish, std::make_unique<WorkQueue[]>(workers), workers, count};
+
+        /* Hand the run to the parked helper threads, starting them on first use. */
+        if (workers > 1) {
+            if (m_threads.empty()) {
+                m_threads.reserve(m_workers - 1);
+                for (u32 i = 1; i < m_workers; ++i) {
+                    m_threads.emplace_back(&ThreadPool::ThreadMain, this, i);
+                }
+            }
+
+            {
+                std::scoped_lock lk{m_mutex};
+                P_ASSERT(m_state == nullptr, "thread pool runs may not overlap");
+
+                m_state       = std::addressof(state);
+                m_run_workers = workers;
+                m_pending     = workers - 1;
+                m_generation += 1;
+            }
+            m_wake_cv.notify_all();
+        }
+
+        /* Participate in the work ourselves. */
+        WorkerMain(state, 0);
+
+        /* Wait for the helpers to finish before the state goes away. */
+        if (workers > 1) {
+            std::unique_lock lk{m_mutex};
+            m_done_cv.wait(lk, [this] { return m_pending == 0; });
+            m_state = nullptr;
+        }
+
+        return !state.cancelled.load(std::memory_order_relaxed);
+    }
+
+    void ThreadPool::ThreadMain(u32 worker) {
+        u64 seen = 0;
+        while (true) {
+            /* Park until there's a run this worker takes part in, or the pool goes away. */
+            RunState *state;
+            {
+                std::unique_lock lk{m_mutex};
+                m_wake_cv.wait(lk, [this, seen] { return m_stopping || m_generation != seen; });
+                if (m_stopping) {
+                    return;
+                }
+
+                seen = m_generation;
+                if (worker >= m_run_workers) {
+                    continue;
+                }
+                state = m_state;
+            }
+
+            WorkerMain(*state, worker);
+
+            bool last;
+            {
+                std::scoped_lock lk{m_mutex};
+                last = --m_pending == 0;
+            }
+            if (last) {
+                m_done_cv.notify_one();
+            }
+        }
+    }
+
+}
@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2022 Valentin B.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "ptor_defines.hpp"
+#include "ptor_types.hpp"
+#include "util/util_i_function.hpp"
+
+namespace ptor::util {
+
+    /* Executes a fixed range of work items on a set of worker threads.            */
+    /* Items are striped across per-worker queues in the order they are given, so  */
+    /* callers should pass the most expensive items first. Idle workers steal from */
+    /* the queues of their siblings until all the work is drained.                 */
+    /* The threads are started on first use and parked between runs, so a pool is */
+    /* meant to be kept around for all the work of a process.                      */
+    class ThreadPool final {
+        P_DISALLOW_COPY_AND_ASSIGN(ThreadPool);
+        P_DISALLOW_MOVE(ThreadPool);
+
+    public:
+        /* Invoked as `fn(worker, item)`; returning `false` cancels all remaining work. */
+        using CallbackType = IFunction<bool(u32, u32)>;
+
+        /* Invoked as `fn(worker)` on the worker's own thread once it ran out of work. */
+        using FinishCallbackType = IFunction<void(u32)>;
+
+        struct RunState;
+
+    private:
+        u32 m_workers;
+
+        /* Worker `i` runs on `m_threads[i - 1]`; worker 0 is whoever calls `Run`. */
+        std::vector<std::thread> m_threads;
+
+        std::mutex m_mutex;
+        std::condition_variable m_wake_cv;
+        std::condition_variable m_done_cv;
+        RunState *m_state;
+        u64 m_generation;
+        u32 m_run_workers;
+        u32 m_pending;
+        bool m_stopping;
+
+    public:
+        explicit ThreadPool(u32 workers);
+
+        ~ThreadPool();
+
+        P_ALWAYS_INLINE u32 GetWorkerCount() const { return m_workers; }
+
+        /* Gets the amount of workers to use when the user asked for "as many as possible". */
+        static u32 GetDefaultWorkerCount();
+
+        /* Runs `fn` for every item in `[0, count)`. The calling thread acts as worker 0. */
+        /* Returns `false` if any invocation of the callback requested cancellation.      */
+        /* Runs may not overlap or nest.                                                  */
+        bool Run(u32 count, const CallbackType &fn);
+
+        /* Same as above, but also runs `finish` on every participating worker thread */
+        /* once the work is drained. Workers always run on the same thread, so this   */
+        /* is useful for per-worker state that is bound to the thread using it.       */
+        bool Run(u32 count, const CallbackType &fn, const FinishCallbackType &finish);
+
+    private:
+        bool RunImpl(u32 count, const CallbackType &fn, const FinishCallbackType *finish);
+
+        void ThreadMain(u32 worker);
+    };
+
+}
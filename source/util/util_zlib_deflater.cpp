@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2022 Valentin B.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "util/util_zlib_deflater.hpp"
+
+#include "assert.hpp"
+
+namespace ptor::util {
+
+    Deflater::Deflater(libdeflate_compressor *c) : m_compressor{c} {
+        P_ASSERT(m_compressor != nullptr);
+    }
+
+    Deflater::Deflater(Deflater &&rhs) : m_compressor{rhs.m_compressor} {
+        rhs.m_compressor = nullptr;
+    }
+
+    Deflater &Deflater::operator=(Deflater &&rhs) {
+        /* Move the compressor state over. */
+        libdeflate_free_compressor(m_compressor);
+        m_compressor = rhs.m_compressor;
+
+        /* Invalidate the other compressor's state. */
+        rhs.m_compressor = nullptr;
+
+        return *this;
+    }
+
+    Deflater::~Deflater() {
+        libdeflate_free_compressor(m_compressor);
+    }
+
+    Deflater Deflater::Allocate(u32 level, std::error_code &ec) {
+        /* Reset the error code back into a successful state. */
+        ec.clear();
+
+        if (level > MaxLevel) {
+            ec = std::make_error_code(std::errc::invalid_argument);
+            return {};
+        }
+
+        auto *c = libdeflate_alloc_compressor(static_cast<int>(level));
+        if (c == nullptr) {
+            ec = std::make_error_code(std::errc::not_enough_memory);
+            return {};
+        }
+
+        return Deflater{c};
+    }
+
+    size_t Deflater::GetBound(size_t len) const {
+        return libdeflate_zlib_compress_bound(m_compressor, len);
+    }
+
+    size_t Deflater::CompressInto(const void *data, size_t len, u8 *out, size_t out_len) {
+        return libdeflate_zlib_compress(m_compressor, data, len, out, out_len);
+    }
+
+}
@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2022 Valentin B.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <system_error>
+
+#include "libdeflate.h"
+
+#include "ptor_defines.hpp"
+#include "ptor_types.hpp"
+
+namespace ptor::util {
+
+    /* A class that handles zlib compression of data at a fixed compression level. */
+    class Deflater {
+        P_DISALLOW_COPY_AND_ASSIGN(Deflater);
+
+    public:
+        /* The range of supported compression levels; higher levels trade speed for size. */
+        static constexpr u32 MinLevel     = 0;
+        static constexpr u32 MaxLevel     = 12;
+        static constexpr u32 DefaultLevel = 6;
+
+    private:
+        libdeflate_compressor *m_compressor;
+
+    private:
+        P_ALWAYS_INLINE Deflater() : m_compressor{nullptr} {}
+
+        explicit Deflater(libdeflate_compressor *c);
+
+    public:
+        Deflater(Deflater &&rhs);
+
+        Deflater &operator=(Deflater &&rhs);
+
+        ~Deflater();
+
+        /* Allocates a deflater which compresses at the given `level`. */
+        static Deflater Allocate(u32 level, std::error_code &ec);
+
+        /* Gets the largest amount of bytes that compressing `len` bytes may produce. */
+        size_t GetBound(size_t len) const;
+
+        /* Compresses `len` bytes at `data` into the `out_len` bytes at `out`. Returns the size */
+        /* of the compressed data, or 0 if it doesn't fit; that makes it easy to only keep the  */
+        /* results of compression that pays off.                                               */
+        size_t CompressInto(const void *data, size_t len, u8 *out, size_t out_len);
+    };
+
+}
@@ -16,6 +16,7 @@
 
 #include "util/util_zlib_inflater.hpp"
 
+#include <algorithm>
 #include <new>
 
 #include "assert.hpp"
@@ -23,17 +24,20 @@
 namespace ptor::util {
 
     Inflater::Inflater(libdeflate_decompressor *d, u8 *buf, size_t size)
-        : m_decompressor{d}, m_buffer{buf}, m_size{size}
+        : m_decompressor{d}, m_buffer{buf}, m_size{size}, m_budget{nullptr}, m_retained{size}, m_reserved{0}
     {
         P_ASSERT(m_decompressor != nullptr && m_buffer != nullptr);
     }
 
     Inflater::Inflater(Inflater &&rhs)
-        : m_decompressor{rhs.m_decompressor}, m_buffer{rhs.m_buffer}, m_size{rhs.m_size}
+        : m_decompressor{rhs.m_decompressor}, m_buffer{rhs.m_buffer}, m_size{rhs.m_size},
+          m_budget{rhs.m_budget}, m_retained{rhs.m_retained}, m_reserved{rhs.m_reserved}
     {
         rhs.m_decompressor = nullptr;
         rhs.m_buffer       = nullptr;
         rhs.m_size         = 0;
+        rhs.m_budget       = nullptr;
+        rhs.m_reserved     = 0;
     }
 
     Inflater &Inflater::operator=(Inflater &&rhs) {
@@ -41,30 +45,44 @@ namespace ptor::util {
         m_decompressor = rhs.m_decompressor;
         m_buffer       = rhs.m_buffer;
         m_size         = rhs.m_size;
+        m_budget       = rhs.m_budget;
+        m_retained     = rhs.m_retained;
+        m_reserved     = rhs.m_reserved;
 
         /* Invalidate the other decompressor's state. */
         rhs.m_decompressor = nullptr;
         rhs.m_buffer       = nullptr;
         rhs.m_size         = 0;
+        rhs.m_budget       = nullptr;
+        rhs.m_reserved     = 0;
 
         return *this;
     }
 
     Inflater::~Inflater() {
+        if (m_budget != nullptr) {
+            m_budget->Release(m_reserved);
+        }
         libdeflate_free_decompressor(m_decompressor);
         free(m_buffer);
     }
 
     Inflater Inflater::Allocate(std::error_code &ec) {
+        return Allocate(DefaultCapacity, ec);
+    }
+
+    Inflater Inflater::Allocate(size_t capacity, std::error_code &ec) {
         auto *d   = libdeflate_alloc_decompressor();
-        auto *buf = std::malloc(DefaultCapacity);
+        auto *buf = std::malloc(std::max<size_t>(capacity, 1));
 
         if (d == nullptr || buf == nullptr) {
+            libdeflate_free_decompressor(d);
+            free(buf);
             ec = std::make_error_code(std::errc::not_enough_memory);
             return {};
         }
 
-        return Inflater{d, static_cast<u8 *>(buf), DefaultCapacity};
+        return Inflater{d, static_cast<u8 *>(buf), capacity};
     }
 
     void Inflater::Grow(size_t new_size, std::error_code &ec) {
@@ -86,12 +104,54 @@ namespace ptor::util {
         }
     }
 
-    size_t Inflater::DecompressImpl(const void *data, size_t len, std::error_code &ec) {
+    void Inflater::AttachBudget(MemoryBudget &budget) {
+        P_ASSERT(m_reserved == 0, "inflater already holds a reservation");
+
+        m_budget   = std::addressof(budget);
+        m_retained = m_size;
+    }
+
+    void Inflater::Reserve(size_t size, std::error_code &ec) {
+        /* Reset the error code back into a successful state. */
+        ec.clear();
+
+        if (size <= m_size) {
+            return;
+        }
+
+        /* The retained part of the buffer is paid for up front, so only the growth beyond it is reserved. */
+        if (m_budget != nullptr) {
+            const size_t growth = std::min(size - m_retained, m_budget->GetLimit());
+            if (growth > m_reserved) {
+                m_reserved += m_budget->Reserve(growth - m_reserved);
+            }
+        }
+        this->Grow(size, ec);
+    }
+
+    void Inflater::Trim() {
+        if (m_reserved == 0) {
+            return;
+        }
+
+        /* If shrinking fails, the memory stays reserved until the next attempt. */
+        auto *new_buf = std::realloc(m_buffer, std::max<size_t>(m_retained, 1));
+        if (new_buf == nullptr) {
+            return;
+        }
+        m_buffer = static_cast<u8 *>(new_buf);
+        m_size   = m_retained;
+
+        m_budget->Release(m_reserved);
+        m_reserved = 0;
+    }
+
+    size_t Inflater::DecompressImpl(const void *data, size_t len, u8 *out, size_t out_len, std::error_code &ec) {
         /* Reset the error code back into a successful state. */
         ec.clear();
 
         size_t written;
-        switch (libdeflate_zlib_decompress(m_decompressor, data, len, m_buffer, m_size, std::addressof(written))) {
+        switch (libdeflate_zlib_decompress(m_decompressor, data, len, out, out_len, std::addressof(written))) {
             case LIBDEFLATE_SUCCESS:
                 /* We succeeded. Return the actual written bytes. */
                 return written;
@@ -100,8 +160,8 @@ namespace ptor::util {
                 ec = std::make_error_code(std::errc::illegal_byte_sequence);
                 break;
             case LIBDEFLATE_INSUFFICIENT_SPACE:
-                /* We don't have anough memory to complete the operation right now. */
-                ec = std::make_error_code(std::errc::not_enough_memory);
+                /* The output buffer is too small for the decompressed data. */
+                ec = std::make_error_code(std::errc::no_buffer_space);
                 break;
             case LIBDEFLATE_SHORT_OUTPUT:
                 P_UNREACHABLE();
@@ -118,9 +178,13 @@ namespace ptor::util {
 
         /* Attempt to decompress the supplied data. */
         /* TODO: Should we compensate for wrong size hints? */
-        size_t written = this->DecompressImpl(data, len, ec);
+        size_t written = this->DecompressImpl(data, len, m_buffer, m_size, ec);
 
         return written;
     }
 
+    size_t Inflater::DecompressInto(const void *data, size_t len, u8 *out, size_t out_len, std::error_code &ec) {
+        return this->DecompressImpl(data, len, out, out_len, ec);
+    }
+
 }
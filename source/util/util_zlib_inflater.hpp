@@ -22,12 +22,15 @@
 #include "ptor_defines.hpp"
 #include "ptor_types.hpp"
 #include "util/util_literals.hpp"
+#include "util/util_memory_budget.hpp"
 
 namespace ptor::util {
 
     /* A class that handles zlib decompression of data. */
     /* After calling `Decompress()` successfully, one may assume `GetPtr()` returns a   */
     /* valid pointer to the decompressed data until another `Decompress()` takes place. */
+    /* With a `MemoryBudget` attached, the buffer only grows past its initial size      */
+    /* under a reservation from the budget, until it is trimmed back again.             */
     class Inflater {
         P_DISALLOW_COPY_AND_ASSIGN(Inflater);
 
@@ -39,8 +42,12 @@ namespace ptor::util {
         u8 *m_buffer;
         size_t m_size;
 
+        MemoryBudget *m_budget;
+        size_t m_retained;
+        size_t m_reserved;
+
     private:
-        P_ALWAYS_INLINE Inflater() : m_decompressor{nullptr}, m_buffer{nullptr}, m_size{0} {}
+        P_ALWAYS_INLINE Inflater() : m_decompressor{nullptr}, m_buffer{nullptr}, m_size{0}, m_budget{nullptr}, m_retained{0}, m_reserved{0} {}
 
         Inflater(libdeflate_decompressor *d, u8 *buf, size_t size);
 
@@ -53,16 +60,34 @@ namespace ptor::util {
 
         static Inflater Allocate(std::error_code &ec);
 
+        /* Allocates an inflater whose buffer holds exactly `capacity` bytes up front. */
+        static Inflater Allocate(size_t capacity, std::error_code &ec);
+
         P_ALWAYS_INLINE u8 *GetCurrentBufferPtr() { return m_buffer; }
         P_ALWAYS_INLINE const u8 *GetCurrentBufferPtr() const { return m_buffer; }
 
+        P_ALWAYS_INLINE size_t GetCapacity() const { return m_size; }
+
+        /* Accounts all growth of the buffer beyond its current size against `budget`. */
+        void AttachBudget(MemoryBudget &budget);
+
+        /* Makes the buffer hold at least `size` bytes, waiting for the budget if necessary. */
+        void Reserve(size_t size, std::error_code &ec);
+
+        /* Shrinks the buffer back to its initial size and releases the reserved memory. */
+        void Trim();
+
     private:
         void Grow(size_t new_size, std::error_code &ec);
 
-        size_t DecompressImpl(const void *data, size_t len, std::error_code &ec);
+        size_t DecompressImpl(const void *data, size_t len, u8 *out, size_t out_len, std::error_code &ec);
 
     public:
         size_t Decompress(const void *data, size_t len, size_t size_hint, std::error_code &ec);
+
+        /* Decompresses into a caller-supplied buffer instead of the internal one. */
+        /* Fails with `no_buffer_space` when the data doesn't fit into `out`.      */
+        size_t DecompressInto(const void *data, size_t len, u8 *out, size_t out_len, std::error_code &ec);
     };
 
 }
@@ -16,118 +16,1458 @@
 
 #include "bin/ptor_content_processor.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <ctime>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#ifdef PTOR_OS_WINDOWS
+    #include <fcntl.h>
+    #include <io.h>
+#else
+    #include <sys/stat.h>
+#endif
+
+#include "fmt/color.h"
+
+#include "assert.hpp"
+#include "bin/cli_progress_reporter.hpp"
 #include "io/io_binary_buffer.hpp"
+#include "io/io_directory_tree.hpp"
+#include "io/io_file_writer.hpp"
 #include "io/io_memory_mapped.hpp"
+#include "io/io_tar_writer.hpp"
+#include "util/util_alignment.hpp"
+#include "util/util_crc32.hpp"
+#include "util/util_glob.hpp"
+#include "util/util_literals.hpp"
+#include "util/util_memory_budget.hpp"
 #include "util/util_scope_guard.hpp"
+#include "util/util_thread_pool.hpp"
 #include "util/util_zlib_inflater.hpp"
-#include "wad/wad_api.hpp"
+#include "wad/wad_archive.hpp"
+#include "wad/wad_archive_diff.hpp"
+#include "wad/wad_extraction_plan.hpp"
+#include "wad/wad_file_table.hpp"
+#include "wad/wad_manifest.hpp"
+#include "wad/wad_packer.hpp"
+#include "wad/wad_stream_reader.hpp"
+#include "wad/wad_toc_cache.hpp"
 
 namespace ptor {
 
     namespace {
 
-        inline void WriteFile(const fs::path &outdir, const wad::File &file, const u8 *data, std::error_code &ec) {
-            const fs::path &outfile = outdir / file.path;
+        /* Under a memory limit, workers keep inflater buffers of this size. Larger files grow */
+        /* them under a reservation from the budget, for as long as they are being processed.  */
+        constexpr inline size_t RetainedInflateSize = 4_MB;
 
-            /* Attempt to create the directory for the output file. */
-            if (fs::create_directories(outfile.parent_path(), ec); ec) {
-                return;
+        /* Under a memory limit, streamed archives hold this share of it as their window. */
+        constexpr inline u64 StreamWindowDivisor = 4;
+
+        struct ArchiveSource {
+            FILE *file; /* Optional; the file `data` can be copied from by the kernel. */
+            const u8 *data;
+            io::ReadOnlyMapped *mapped; /* Optional; the mapping `data` belongs to. */
+        };
+
+        /* Releases the pages of an archive mapping once all the units of work before them are done. */
+        /* Units may complete out of order, so pages are only released up to the lowest offset which */
+        /* is still being worked on.                                                                 */
+        class PageReleaser final {
+            P_DISALLOW_COPY_AND_ASSIGN(PageReleaser);
+            P_DISALLOW_MOVE(PageReleaser);
+
+        private:
+            /* The page cache may hold large folios which are only released when fully covered. */
+            static constexpr size_t MaxFolioSize = 2_MB;
+
+        private:
+            io::ReadOnlyMapped &m_mapped;
+            std::vector<u32> m_ranks;
+            std::vector<size_t> m_starts;
+            std::vector<bool> m_done;
+            std::mutex m_mutex;
+            u32 m_next_rank;
+            size_t m_released;
+
+        public:
+            PageReleaser(io::ReadOnlyMapped &mapped, const ArchiveSource &source, const wad::FileTable &files, const wad::ExtractionPlan &plan)
+                : m_mapped{mapped}, m_ranks(plan.GetUnitCount()), m_starts(plan.GetUnitCount()), m_done(plan.GetUnitCount()), m_next_rank{0}, m_released{0}
+            {
+                /* Rank the units by their position in the archive; they span contiguous ranges of the plan's order. */
+                std::vector<u32> units(plan.GetUnitCount());
+                std::iota(units.begin(), units.end(), 0);
+                std::sort(units.begin(), units.end(), [&plan](u32 lhs, u32 rhs) {
+                    return plan.GetUnitFiles(lhs).data() < plan.GetUnitFiles(rhs).data();
+                });
+
+                for (u32 rank = 0; rank < units.size(); ++rank) {
+                    m_ranks[units[rank]] = rank;
+                    m_starts[rank]       = files.GetContentPtr(plan.GetUnitFiles(units[rank]).front()) - source.data;
+                }
             }
 
-            /* Write the file contents to the designated output files. */
-            FILE *fp = std::fopen(outfile.string().c_str(), "wb");
-            if (fp != nullptr) {
-                if (std::fwrite(data, sizeof(u8), file.uncompressed_size, fp) != file.uncompressed_size) {
-                    ec = std::make_error_code(std::errc::io_error);
+            void Complete(u32 unit) {
+                std::scoped_lock lk{m_mutex};
+
+                /* Advance past all the units which are completed in archive order. */
+                m_done[m_ranks[unit]] = true;
+                while (m_next_rank < m_done.size() && m_done[m_next_rank]) {
+                    ++m_next_rank;
                 }
-                std::fclose(fp);
-            } else {
-                ec = std::make_error_code(std::errc::invalid_argument);
+
+                /* Release everything before the first unit still in progress. */
+                const size_t end = m_next_rank < m_starts.size() ? m_starts[m_next_rank] : m_mapped.GetLength();
+                if (end > m_released) {
+                    const size_t start = util::AlignDown(m_released, MaxFolioSize);
+                    m_mapped.Advise(start, end - start, io::Advice::DontNeed);
+                    m_released = end;
+                }
+            }
+        };
+
+        /* Gets where a worker records its statistics; none when they aren't gathered. */
+        P_ALWAYS_INLINE cli::RunStats::Recorder *GetRecorder(cli::RunStats *stats, u32 worker) {
+            return stats != nullptr ? stats->GetRecorder(worker) : nullptr;
+        }
+
+        inline void InflateFile(util::Inflater &inflater, cli::RunStats::Recorder *recorder, const wad::File &file, u8 *out, size_t out_len, std::error_code &ec) {
+            cli::RunStats::ScopedTimer timer{recorder, cli::Phase::Inflate, 1, file.compressed_size, out_len};
+
+            /* The output buffer is sized exactly, so anything short of or beyond it is a corrupt entry. */
+            if (inflater.DecompressInto(file.content_ptr, file.compressed_size, out, out_len, ec) != out_len && !ec) {
+                ec = std::make_error_code(std::errc::illegal_byte_sequence);
+            } else if (ec == std::errc::no_buffer_space) {
+                ec = std::make_error_code(std::errc::illegal_byte_sequence);
             }
         }
 
-        void ExtractArchive(const fs::path &outdir, const wad::File *files, u32 file_count, std::error_code &ec) {
-            /* Try to allocate the zlib inflater for handling decompression. */
-            auto inflater = util::Inflater::Allocate(ec);
+        /* Inflates a file into the inflater's own buffer, which may have to grow for it first. */
+        /* The caller trims the inflater once it's done with the contents.                      */
+        inline const u8 *InflateToBuffer(util::Inflater &inflater, cli::RunStats::Recorder *recorder, const wad::File &file, std::error_code &ec) {
+            if (inflater.Reserve(file.uncompressed_size, ec); ec) {
+                return nullptr;
+            }
+            if (InflateFile(inflater, recorder, file, inflater.GetCurrentBufferPtr(), file.uncompressed_size, ec); ec) {
+                return nullptr;
+            }
+            return inflater.GetCurrentBufferPtr();
+        }
+
+        inline void WriteFile(io::FileWriter &writer, util::Inflater &inflater, cli::RunStats::Recorder *recorder, const io::FileLocation &outfile, const ArchiveSource &source, const wad::File &file, bool map_output, u32 *checksum, std::error_code &ec) {
+            /* Checksums are computed over the contents right after they were produced, while they're still   */
+            /* in cache. Empty files may never be produced at all, but those are covered by a checksum of 0. */
+            auto update_checksum = [checksum, recorder, &file](const u8 *contents) P_ALWAYS_INLINE_LAMBDA {
+                if (checksum != nullptr) {
+                    cli::RunStats::ScopedTimer timer{recorder, cli::Phase::Checksum, 1, file.uncompressed_size};
+                    *checksum = util::Crc32(contents, file.uncompressed_size);
+                }
+            };
+
+            /* Inflating into mapped outputs happens as part of writing them, but is attributed on its own. */
+            cli::RunStats::ScopedTimer timer{recorder, cli::Phase::Write, 1, 0, file.uncompressed_size};
+
+            /* Stored files are copied from the archive by the kernel, where possible. */
+            if (!file.compressed) {
+                update_checksum(file.content_ptr);
+                if (source.file == nullptr) {
+                    return writer.Write(outfile, file.content_ptr, file.uncompressed_size, ec);
+                }
+
+                const u64 offset = static_cast<u64>(file.content_ptr - source.data);
+                return writer.WriteFromFile(outfile, source.file, offset, file.content_ptr, file.uncompressed_size, ec);
+            }
+
+            /* When requested, inflate straight into the mapped output file. */
+            if (map_output) {
+                const auto fill = io::FileWriter::FillCallbackType::Make([&](u8 *out, size_t out_len, std::error_code &fill_ec) {
+                    if (InflateFile(inflater, recorder, file, out, out_len, fill_ec); !fill_ec) {
+                        update_checksum(out);
+                    }
+                });
+                return writer.WriteMapped(outfile, file.uncompressed_size, fill, ec);
+            }
+
+            /* Prefer inflating into a staging buffer that the writer can queue without copying. */
+            u8 *staging = writer.AcquireBuffer(file.uncompressed_size, ec);
             if (ec) {
                 return;
             }
 
-            /* Extract the archive file by file. */
-            ContentProcessor::ProgressBar<30> progress{"Extracting KIWAD archive...", file_count};
-            for (u32 i = 0; i < file_count; ++i) {
-                const auto &file     = files[i];
-                const auto *contents = file.content_ptr;
+            /* Staging buffers are part of the fixed cost of the writer, so they need no reservation. */
+            if (staging != nullptr) {
+                if (InflateFile(inflater, recorder, file, staging, file.uncompressed_size, ec); ec) {
+                    writer.ReleaseBuffer(staging);
+                    return;
+                }
+                update_checksum(staging);
+                writer.Write(outfile, staging, file.uncompressed_size, ec);
+            } else {
+                P_ON_SCOPE_EXIT { inflater.Trim(); };
+
+                const u8 *contents = InflateToBuffer(inflater, recorder, file, ec);
+                if (ec) {
+                    return;
+                }
+                update_checksum(contents);
+                writer.Write(outfile, contents, file.uncompressed_size, ec);
+            }
+        }
+
+        u32 ComputeChecksum(util::Inflater &inflater, cli::RunStats::Recorder *recorder, const wad::File &file, std::error_code &ec) {
+            /* Reset the error code back into a successful state. */
+            ec.clear();
+
+            P_ON_SCOPE_EXIT { inflater.Trim(); };
+
+            const u8 *contents = file.content_ptr;
+            if (file.compressed) {
+                if (contents = InflateToBuffer(inflater, recorder, file, ec); ec) {
+                    return 0;
+                }
+            }
+
+            cli::RunStats::ScopedTimer timer{recorder, cli::Phase::Checksum, 1, file.uncompressed_size};
+            return util::Crc32(contents, file.uncompressed_size);
+        }
+
+        /* Everything needed to process a single archive, from opening it to reporting the results. */
+        struct ArchiveJob {
+            P_DISALLOW_COPY_AND_ASSIGN(ArchiveJob);
+            P_DISALLOW_MOVE(ArchiveJob);
+
+            /* The path of the archive and the directory to extract it into. */
+            fs::path input;
+            fs::path output;
+
+            /* The directory of the archive's files in a tar stream; empty outside of batches. */
+            std::string prefix;
+
+            /* The opened archive and its file table. Archives are either mapped or streamed. */
+            FILE *file = nullptr;
+            std::optional<io::ReadOnlyMapped> mapped;
+            std::optional<wad::StreamReader> stream;
+            wad::TocCache cache;
+            wad::Archive archive;
+            wad::Manifest manifest;
+
+            /* The files to process; either all of the archive's or those in `selected`. */
+            const wad::FileTable *files = nullptr;
+            wad::FileTable selected;
+            u32 skipped = 0;
+
+            /* In diff mode, the earlier revision of the archive and how the files changed since. */
+            std::unique_ptr<ArchiveJob> base;
+            wad::ArchiveDiff diff;
+
+            /* State for processing the files. */
+            io::DirectoryTree tree;
+            wad::ExtractionPlan plan;
+            std::optional<PageReleaser> releaser;
+            std::vector<u32> corrupt;
 
-                /* Decompress the file contents, if necessary. */
+            /* The first error that occurred while processing this archive. */
+            std::error_code error;
+
+            ArchiveJob(fs::path in, fs::path out) : input{std::move(in)}, output{std::move(out)} {}
+
+            ~ArchiveJob() {
+                stream.reset();
+                if (file != nullptr && file != stdin) {
+                    std::fclose(file);
+                }
+            }
+
+            P_ALWAYS_INLINE ArchiveSource GetSource() {
+                return {file, mapped->GetPtr(), std::addressof(*mapped)};
+            }
+        };
+
+        /* A unit of work from the plan of one of the archives in a run. */
+        struct WorkItem {
+            u32 job;
+            u32 unit;
+        };
+
+        /* Where extracted files end up. Workers write through the sink concurrently, each with their own index. */
+        class OutputSink {
+        public:
+            virtual ~OutputSink() = default;
+
+            /* Sets up the state for `workers` workers. */
+            virtual void Prepare(u32 workers) = 0;
+
+            /* Writes the contents of `file`, the file at `index` in `job`. If `checksum` is given, */
+            /* it receives the checksum of the contents that were written.                         */
+            virtual void Write(u32 worker, util::Inflater &inflater, const ArchiveJob &job, u32 index, const ArchiveSource &source, const wad::File &file, u32 *checksum, std::error_code &ec) = 0;
+
+            /* Waits for the queued writes of a worker to complete; must be called on the worker's own thread. */
+            virtual void Flush(u32 worker, std::error_code &ec) = 0;
+
+            /* Gets the memory that all the prepared workers hold on to, outside of any memory budget. */
+            virtual size_t GetMemoryOverhead() const = 0;
+        };
+
+        /* Writes every file to its own path below the output directory of its archive. */
+        class DirectorySink final : public OutputSink {
+        private:
+            std::vector<io::FileWriter> m_writers;
+            cli::RunStats *m_stats;
+            bool m_map_output;
+
+        public:
+            DirectorySink(bool map_output, cli::RunStats *stats) : m_stats{stats}, m_map_output{map_output} {}
+
+            void Prepare(u32 workers) override {
+                while (m_writers.size() < workers) {
+                    m_writers.emplace_back();
+                }
+            }
+
+            void Write(u32 worker, util::Inflater &inflater, const ArchiveJob &job, u32 index, const ArchiveSource &source, const wad::File &file, u32 *checksum, std::error_code &ec) override {
+                WriteFile(m_writers[worker], inflater, GetRecorder(m_stats, worker), job.tree.Resolve(index), source, file, m_map_output, checksum, ec);
+            }
+
+            void Flush(u32 worker, std::error_code &ec) override {
+                cli::RunStats::ScopedTimer timer{GetRecorder(m_stats, worker), cli::Phase::Write};
+                m_writers[worker].Flush(ec);
+
+                /* Even after failures, the next archive has to start out with all the staging buffers. */
+                P_DEBUG_ASSERT(m_writers[worker].IsIdle(), "writer still holds staging buffers after a flush");
+            }
+
+            size_t GetMemoryOverhead() const override {
+                size_t overhead = 0;
+                for (const auto &writer : m_writers) {
+                    overhead += writer.GetStagingMemorySize();
+                }
+                return overhead;
+            }
+        };
+
+        /* Writes all files into a single tar stream; files of batched archives are put below their prefix. */
+        class TarSink final : public OutputSink {
+        private:
+            io::TarWriter &m_tar;
+            std::vector<std::string> m_paths;
+            cli::RunStats *m_stats;
+
+        public:
+            TarSink(io::TarWriter &tar, cli::RunStats *stats) : m_tar{tar}, m_stats{stats} {}
+
+            void Prepare(u32 workers) override {
+                m_paths.resize(std::max<size_t>(m_paths.size(), workers));
+            }
+
+            void Write(u32 worker, util::Inflater &inflater, const ArchiveJob &job, u32 index, const ArchiveSource &source, const wad::File &file, u32 *checksum, std::error_code &ec) override {
+                P_UNUSED(index, source);
+
+                /* Stored files are written straight from the archive; the rest is inflated first. */
+                P_ON_SCOPE_EXIT { inflater.Trim(); };
+
+                auto *recorder     = GetRecorder(m_stats, worker);
+                const u8 *contents = file.content_ptr;
                 if (file.compressed) {
-                    if (inflater.Decompress(contents, file.compressed_size, file.uncompressed_size, ec); ec) {
+                    if (contents = InflateToBuffer(inflater, recorder, file, ec); ec) {
                         return;
                     }
-                    contents = inflater.GetCurrentBufferPtr();
                 }
 
-                /* Write the decompressed file to disk. */
-                WriteFile(outdir, file, contents, ec);
-                if (ec) {
+                if (checksum != nullptr) {
+                    cli::RunStats::ScopedTimer timer{recorder, cli::Phase::Checksum, 1, file.uncompressed_size};
+                    *checksum = util::Crc32(contents, file.uncompressed_size);
+                }
+
+                cli::RunStats::ScopedTimer timer{recorder, cli::Phase::Write, 1, 0, file.uncompressed_size};
+
+                std::string_view path = file.path;
+                if (!job.prefix.empty()) {
+                    auto &scratch = m_paths[worker];
+                    scratch.assign(job.prefix).append(1, '/').append(file.path);
+                    path = scratch;
+                }
+                m_tar.Write(path, contents, file.uncompressed_size, ec);
+            }
+
+            void Flush(u32 worker, std::error_code &ec) override {
+                P_UNUSED(worker);
+
+                /* Every write to the stream completes right away. */
+                ec.clear();
+            }
+
+            size_t GetMemoryOverhead() const override {
+                return 0;
+            }
+        };
+
+        /* Diagnostics go to stderr when stdout carries a tar stream. */
+        P_ALWAYS_INLINE FILE *GetLogFile(const cli::Options &options) {
+            return options.tar_output == "-" ? stderr : stdout;
+        }
+
+        /* Progress is only drawn for people watching a terminal. */
+        P_ALWAYS_INLINE bool IsProgressShown(const cli::Options &options) {
+            return !options.quiet && cli::ProgressReporter::IsTerminal(GetLogFile(options));
+        }
+
+        void AddProgressTotals(cli::ProgressReporter::Totals &totals, const wad::FileTable &files) {
+            totals.files += files.GetCount();
+            for (u32 i = 0; i < files.GetCount(); ++i) {
+                totals.bytes_in  += files.GetStoredSize(i);
+                totals.bytes_out += files.GetUncompressedSize(i);
+            }
+        }
+
+        /* Extraction into a tar stream has no output directory to keep track of. */
+        P_ALWAYS_INLINE bool IsIncremental(const cli::Options &options) {
+            return options.incremental && !options.verify_only && options.tar_output.empty();
+        }
+
+        /* Gets the memory left for inflating large files once the fixed costs of `workers` and */
+        /* `overhead` bytes of other buffers are covered. Returns 0 when there is no limit.     */
+        size_t GetInflateBudget(const cli::Options &options, u32 workers, size_t overhead) {
+            if (options.max_memory == 0) {
+                return 0;
+            }
+
+            /* A budget too small for that serializes all the large files; we can't do better. */
+            const u64 fixed = static_cast<u64>(workers) * RetainedInflateSize + overhead;
+            return options.max_memory > fixed ? static_cast<size_t>(options.max_memory - fixed) : 1;
+        }
+
+        void AllocateInflaters(util::MemoryBudget &budget, u32 workers, u32 max_inflated_size, std::vector<util::Inflater> &inflaters, std::error_code &ec) {
+            /* Without a limit, every buffer holds the largest file up front. */
+            const size_t capacity = budget.IsLimited() ? std::min<size_t>(max_inflated_size, RetainedInflateSize) : max_inflated_size;
+
+            inflaters.reserve(workers);
+            for (u32 i = 0; i < workers; ++i) {
+                if (inflaters.push_back(util::Inflater::Allocate(capacity, ec)); ec) {
                     return;
                 }
+                if (budget.IsLimited()) {
+                    inflaters.back().AttachBudget(budget);
+                }
+            }
+        }
 
-                /* Report progress for the user. */
-                progress.Update(i + 1);
+        void LoadArchive(const cli::Options &options, ArchiveJob &job, std::error_code &ec) {
+            u8 *data         = job.mapped->GetPtr();
+            const size_t len = job.mapped->GetLength();
+
+            if (options.toc_cache.empty()) {
+                return job.archive.Load(data, len, ec);
+            }
+
+            /* The cache is only an accelerator, so any problems with it just fall back to parsing. */
+            std::error_code cache_ec;
+            const auto key        = wad::TocCache::MakeKey(job.input, data, len, cache_ec);
+            const auto cache_path = cache_ec ? fs::path{} : wad::TocCache::GetCachePath(options.toc_cache, job.input, cache_ec);
+            if (cache_ec) {
+                return job.archive.Load(data, len, ec);
+            }
+
+            if (job.cache.Open(cache_path, key) && job.archive.Load(data, len, job.cache)) {
+                return;
+            }
+
+            /* Parse the archive and leave a cache behind for the next run. */
+            if (job.archive.Load(data, len, ec); ec) {
+                return;
+            }
+            if (fs::create_directories(options.toc_cache, cache_ec); !cache_ec) {
+                wad::TocCache::Store(cache_path, key, job.archive, cache_ec);
             }
         }
 
-    }
+        void SelectFiles(const cli::Options &options, wad::Archive &archive, bool require_entries, wad::FileTable &selected, std::error_code &ec) {
+            std::vector<u32> indices;
 
-    void ContentProcessor::ProcessWad(std::error_code &ec) {
-        /* Create the context for processing. */
-        ProcessWadContext ctx{};
+            /* Named entries are looked up through the path index, so none of the other files are touched. */
+            if (!options.entries.empty()) {
+                archive.BuildIndex();
+                for (const char *entry : options.entries) {
+                    const auto index = archive.Find(entry);
+                    if (index.has_value()) {
+                        indices.push_back(*index);
+                    } else if (require_entries) {
+                        fmt::print(GetLogFile(options), fg(fmt::color::red), "No such entry in archive: {}\n", entry);
+                        ec = std::make_error_code(std::errc::no_such_file_or_directory);
+                        return;
+                    }
+                }
+            }
+
+            /* Patterns have to be matched against every path in the archive. */
+            if (options.filter != nullptr) {
+                const auto &files = archive.GetFiles();
+                for (u32 i = 0; i < files.GetCount(); ++i) {
+                    if (util::MatchGlob(options.filter, files.GetPath(i))) {
+                        indices.push_back(i);
+                    }
+                }
+            }
+
+            /* Keep the order of the file table and never write the same file twice. */
+            std::sort(indices.begin(), indices.end());
+            indices.erase(std::unique(indices.begin(), indices.end()), indices.end());
+
+            selected.Select(archive.GetFiles(), indices);
+        }
+
+        bool GetOutputState(const fs::path &path, u64 &size, i64 &mtime) {
+        #ifdef PTOR_OS_WINDOWS
+            std::error_code ec;
+            if (size = fs::file_size(path, ec); ec) {
+                return false;
+            }
+            mtime = fs::last_write_time(path, ec).time_since_epoch().count();
+            return !ec;
+        #else
+            /* Incremental runs do this for every file, so get both values from a single lookup. */
+            struct stat st;
+            if (stat(path.c_str(), std::addressof(st)) != 0) {
+                return false;
+            }
+
+            size = static_cast<u64>(st.st_size);
+        #ifdef PTOR_OS_APPLE
+            mtime = static_cast<i64>(st.st_mtimespec.tv_sec) * 1'000'000'000 + st.st_mtimespec.tv_nsec;
+        #else
+            mtime = static_cast<i64>(st.st_mtim.tv_sec) * 1'000'000'000 + st.st_mtim.tv_nsec;
+        #endif
+            return true;
+        #endif
+        }
+
+        void FindChangedFiles(util::ThreadPool &pool, const ArchiveJob &job, std::vector<u32> &changed) {
+            /* Checking the outputs is dominated by file system lookups, so spread them over the workers. */
+            constexpr u32 ChunkSize = 1024;
+
+            const wad::FileTable &files = *job.files;
+            std::vector<u8> is_changed(files.GetCount());
+            const auto check = util::ThreadPool::CallbackType::Make([&](u32, u32 chunk) {
+                const u32 end = std::min(files.GetCount(), (chunk + 1) * ChunkSize);
+                for (u32 i = chunk * ChunkSize; i < end; ++i) {
+                    const std::string_view path = files.GetPath(i);
+
+                    /* A file is unchanged when the archive has the same contents as last time and */
+                    /* its output still looks exactly like we left it.                              */
+                    const auto *record = job.manifest.Find(path);
+                    if (record != nullptr && record->checksum == files.GetChecksum(i) && record->size == files.GetUncompressedSize(i)) {
+                        u64 size;
+                        i64 mtime;
+                        if (GetOutputState(job.output / path, size, mtime) && size == record->size && mtime == record->mtime) {
+                            continue;
+                        }
+                    }
+
+                    is_changed[i] = true;
+                }
+
+                return true;
+            });
+
+            pool.Run(util::AlignUp(files.GetCount(), ChunkSize) / ChunkSize, check);
+
+            for (u32 i = 0; i < files.GetCount(); ++i) {
+                if (is_changed[i]) {
+                    changed.push_back(i);
+                }
+            }
+        }
+
+        void UpdateManifest(const ArchiveJob &job, std::error_code &ec) {
+            const wad::FileTable &all       = job.archive.GetFiles();
+            const wad::FileTable &extracted = *job.files;
+
+            std::vector<bool> is_corrupt(extracted.GetCount());
+            for (const u32 index : job.corrupt) {
+                is_corrupt[index] = true;
+            }
+
+            /* Record the state of everything we just wrote. Corrupt files are left out, so they are retried. */
+            std::unordered_map<std::string_view, wad::Manifest::Record> updated;
+            updated.reserve(extracted.GetCount());
+            for (u32 i = 0; i < extracted.GetCount(); ++i) {
+                const std::string_view path = extracted.GetPath(i);
+
+                u64 size;
+                i64 mtime;
+                if (!is_corrupt[i] && GetOutputState(job.output / path, size, mtime)) {
+                    updated.insert_or_assign(path, wad::Manifest::Record{extracted.GetChecksum(i), size, mtime});
+                }
+            }
+
+            /* Carry over the records of files we skipped; files no longer in the archive are forgotten. */
+            std::vector<wad::Manifest::Entry> entries;
+            entries.reserve(all.GetCount());
+            for (u32 i = 0; i < all.GetCount(); ++i) {
+                const std::string_view path = all.GetPath(i);
+                if (const auto it = updated.find(path); it != updated.end()) {
+                    entries.push_back({path, it->second});
+                } else if (const auto *record = job.manifest.Find(path); record != nullptr) {
+                    entries.push_back({path, *record});
+                }
+            }
 
-        auto extract_archive_impl = [&](u8 *data, size_t len) P_ALWAYS_INLINE_LAMBDA {
-            io::BinaryBuffer buffer{data, len};
+            wad::Manifest::Store(job.output / wad::Manifest::FileName, entries, ec);
+        }
+
+        P_ALWAYS_INLINE bool IsStandardInput(const fs::path &path) {
+            return path == "-";
+        }
+
+        P_ALWAYS_INLINE bool IsStreamedInput(const fs::path &path) {
+            /* Pipes, sockets and devices can't be mapped, so they are read front to back instead. */
+            std::error_code ec;
+            return IsStandardInput(path) || (fs::exists(path, ec) && !fs::is_regular_file(path, ec));
+        }
 
-            /* Initialize the context. */
-            ctx.raw_data = data;
-            ctx.header   = wad::ReadHeader(buffer);
-            ctx.files    = std::make_unique<wad::File[]>(static_cast<size_t>(ctx.header.file_count));
+        void OpenStream(ArchiveJob &job, std::error_code &ec) {
+            job.stream.emplace(job.file);
 
-            /* Deserialize all the file structures. */
-            for (u32 i = 0; i < ctx.header.file_count; ++i) {
-                ctx.files[i] = wad::ReadFile(ctx.raw_data, buffer);
+            /* Read the header and the file table, which are all we have to start with. */
+            if (job.stream->ReadTable(ec); ec) {
+                return;
             }
+            job.archive.Load(job.stream->GetTableData(), job.stream->GetTableSize(), std::numeric_limits<u64>::max(), ec);
+        }
 
-            /* Create the output directory for the extracted files, if not exists. */
-            if (fs::create_directories(m_options.output, ec); ec) {
+        void CompareToBase(const cli::Options &options, ArchiveJob &job, std::error_code &ec) {
+            auto base = std::make_unique<ArchiveJob>(options.diff_base, fs::path{});
+            if (base->file = std::fopen(base->input.string().c_str(), "rb"); base->file == nullptr) {
+                ec = std::make_error_code(std::errc::no_such_file_or_directory);
                 return;
             }
 
-            /* Extract all the files in the archive. */
-            ExtractArchive(m_options.output, ctx.files.get(), ctx.header.file_count, ec);
-        };
+            /* Only the file table of the base archive is ever looked at. */
+            auto mapped = io::ReadOnlyMapped::Map(base->file, {.advice = io::Advice::Random}, ec);
+            if (ec) {
+                return;
+            }
+            base->mapped.emplace(std::move(mapped));
+
+            if (LoadArchive(options, *base, ec); ec) {
+                return;
+            }
+            base->files = std::addressof(base->archive.GetFiles());
+
+            /* Both archives are narrowed down the same way, so the comparison stays meaningful. */
+            if (!options.entries.empty() || options.filter != nullptr) {
+                if (SelectFiles(options, base->archive, false, base->selected, ec); ec) {
+                    return;
+                }
+                base->files = std::addressof(base->selected);
+            }
+
+            /* Keep the added and modified files; the paths in the diff live on in the archives. */
+            job.diff.Compare(*base->files, *job.files);
+            job.base = std::move(base);
+
+            wad::FileTable changed;
+            changed.Select(*job.files, job.diff.GetChangedFiles());
+            job.selected = std::move(changed);
+            job.files    = std::addressof(job.selected);
+        }
+
+        void PrintDiff(FILE *log, const wad::ArchiveDiff &diff) {
+            for (const auto path : diff.GetAdded()) {
+                fmt::print(log, fg(fmt::color::green), "A {}\n", path);
+            }
+            for (const auto path : diff.GetModified()) {
+                fmt::print(log, fg(fmt::color::yellow), "M {}\n", path);
+            }
+            for (const auto path : diff.GetRemoved()) {
+                fmt::print(log, fg(fmt::color::red), "D {}\n", path);
+            }
+
+            fmt::print(log, "{} added, {} modified, {} removed.\n", diff.GetAdded().size(), diff.GetModified().size(), diff.GetRemoved().size());
+        }
+
+        void OpenArchive(const cli::Options &options, util::ThreadPool &pool, ArchiveJob &job, bool batch, cli::RunStats::Recorder *recorder, std::error_code &ec) {
+            cli::RunStats::ScopedTimer open_timer{recorder, cli::Phase::Open, 1};
 
-        if (m_options.input_type == cli::InputType::File) {
             /* Attempt to open the supplied input source. */
-            FILE *input = std::fopen(m_options.input_file.string().c_str(), "rb");
-            if (input == nullptr) {
+            if (IsStandardInput(job.input)) {
+            #ifdef PTOR_OS_WINDOWS
+                _setmode(_fileno(stdin), _O_BINARY);
+            #endif
+                job.file = stdin;
+            } else if (job.file = std::fopen(job.input.string().c_str(), "rb"); job.file == nullptr) {
                 ec = std::make_error_code(std::errc::no_such_file_or_directory);
                 return;
             }
-            P_ON_SCOPE_EXIT { std::fclose(input); };
 
-            /* Memory-map the file contents. */
-            auto mapped = io::ReadOnlyMapped::Map(input, ec);
+            /* Deserialize the archive header and all the file structures. Only a single */
+            /* archive can be streamed; batches are expected to consist of files on disk. */
+            if (!batch && IsStreamedInput(job.input)) {
+                cli::RunStats::ScopedTimer timer{recorder, cli::Phase::ParseToc};
+                if (OpenStream(job, ec); ec) {
+                    return;
+                }
+                timer.SetWork(job.archive.GetFiles().GetCount(), 0, 0);
+            } else {
+                /* Memory-map the file contents; extraction mostly reads them front to back. */
+                auto mapped = io::ReadOnlyMapped::Map(job.file, {.advice = io::Advice::Sequential}, ec);
+                if (ec) {
+                    return;
+                }
+                job.mapped.emplace(std::move(mapped));
+                open_timer.SetWork(1, job.mapped->GetLength(), 0);
+
+                cli::RunStats::ScopedTimer timer{recorder, cli::Phase::ParseToc};
+                if (LoadArchive(options, job, ec); ec) {
+                    return;
+                }
+                timer.SetWork(job.archive.GetFiles().GetCount(), 0, 0);
+            }
+            job.files = std::addressof(job.archive.GetFiles());
+
+            /* Narrow the archive down to the requested files, if the user asked for any.  */
+            /* In batch mode, named entries are only expected to exist in some archives.  */
+            if (!options.entries.empty() || options.filter != nullptr) {
+                if (SelectFiles(options, job.archive, !batch, job.selected, ec); ec) {
+                    return;
+                }
+                job.files = std::addressof(job.selected);
+            }
+
+            /* In diff mode, leave out all the files which are the same in the base archive. */
+            if (!batch && !options.diff_base.empty()) {
+                if (CompareToBase(options, job, ec); ec) {
+                    return;
+                }
+            }
+
+            /* In incremental mode, leave out all the files whose outputs are still up to date. */
+            if (IsIncremental(options)) {
+                if (job.manifest.Load(job.output / wad::Manifest::FileName, ec); ec) {
+                    return;
+                }
+
+                std::vector<u32> changed_indices;
+                FindChangedFiles(pool, job, changed_indices);
+                job.skipped = job.files->GetCount() - static_cast<u32>(changed_indices.size());
+
+                wad::FileTable changed;
+                changed.Select(*job.files, changed_indices);
+                job.selected = std::move(changed);
+                job.files    = std::addressof(job.selected);
+            }
+        }
+
+        std::vector<WorkItem> ScheduleUnits(std::span<ArchiveJob *const> jobs, u32 workers) {
+            /* Plan every archive on its own, then run the units of all of them on the same workers. */
+            std::vector<WorkItem> items;
+            u64 total_cost = 0;
+            for (u32 job = 0; job < jobs.size(); ++job) {
+                auto &plan = jobs[job]->plan;
+                plan.Build(*jobs[job]->files, workers);
+
+                for (u32 unit = 0; unit < plan.GetUnitCount(); ++unit) {
+                    items.push_back({job, unit});
+                    total_cost += plan.GetUnitCost(unit);
+                }
+            }
+
+            if (workers <= 1) {
+                return items;
+            }
+
+            /* Hoist the heavy units of all archives to the front, like a plan does for its own. */
+            auto get_cost = [jobs](const WorkItem &item) {
+                return jobs[item.job]->plan.GetUnitCost(item.unit);
+            };
+            const u64 threshold = total_cost / (static_cast<u64>(workers) * 8);
+            const auto heavy_end = std::stable_partition(items.begin(), items.end(), [&](const WorkItem &item) {
+                return get_cost(item) > threshold;
+            });
+            std::stable_sort(items.begin(), heavy_end, [&](const WorkItem &lhs, const WorkItem &rhs) {
+                return get_cost(lhs) > get_cost(rhs);
+            });
+
+            return items;
+        }
+
+        u32 GetMaxInflatedSize(std::span<ArchiveJob *const> jobs) {
+            u32 size = 0;
+            for (const auto *job : jobs) {
+                size = std::max(size, job->plan.GetMaxInflatedSize());
+            }
+            return size;
+        }
+
+        cli::ProgressReporter::Totals GetProgressTotals(std::span<ArchiveJob *const> jobs) {
+            cli::ProgressReporter::Totals totals{0, 0, 0};
+            for (const auto *job : jobs) {
+                AddProgressTotals(totals, *job->files);
+            }
+            return totals;
+        }
+
+        void ReportCorruptFiles(FILE *log, ArchiveJob &job, bool batch) {
+            if (job.corrupt.empty()) {
+                return;
+            }
+
+            /* List the corrupt files in the order of the archive's file table. */
+            std::sort(job.corrupt.begin(), job.corrupt.end());
+            for (const u32 index : job.corrupt) {
+                if (batch) {
+                    fmt::print(log, fg(fmt::color::red), "Checksum mismatch: {}: {}\n", job.input.string(), job.files->GetPath(index));
+                } else {
+                    fmt::print(log, fg(fmt::color::red), "Checksum mismatch: {}\n", job.files->GetPath(index));
+                }
+            }
+
+            job.error = std::make_error_code(std::errc::illegal_byte_sequence);
+        }
+
+        void VerifyArchives(const cli::Options &options, util::ThreadPool &pool, std::span<ArchiveJob *const> jobs, cli::RunStats *stats, std::error_code &ec) {
+            if (stats != nullptr) {
+                stats->Prepare(pool.GetWorkerCount());
+            }
+
+            /* Plan the order of verification, which follows the same rules as extraction. */
+            const auto items = ScheduleUnits(jobs, pool.GetWorkerCount());
+
+            /* Try to allocate one zlib inflater for every worker. */
+            util::MemoryBudget budget{GetInflateBudget(options, pool.GetWorkerCount(), 0)};
+            std::vector<util::Inflater> inflaters;
+            if (AllocateInflaters(budget, pool.GetWorkerCount(), GetMaxInflatedSize(jobs), inflaters, ec); ec) {
+                return;
+            }
+
+            /* Every worker collects the corrupt files it found on its own. */
+            std::vector<std::vector<WorkItem>> worker_corrupt(pool.GetWorkerCount());
+
+            /* Verify the archives file by file. */
+            cli::ProgressReporter progress{jobs.size() == 1 ? "Verifying KIWAD archive..." : "Verifying KIWAD archives...", pool.GetWorkerCount(), GetProgressTotals(jobs), GetLogFile(options), IsProgressShown(options)};
+
+            const auto verify = util::ThreadPool::CallbackType::Make([&](u32 worker, u32 item) {
+                const auto &job  = *jobs[items[item].job];
+                const auto unit  = job.plan.GetUnitFiles(items[item].unit);
+                auto *recorder   = GetRecorder(stats, worker);
+
+                u64 bytes_in = 0, bytes_out = 0;
+                for (const u32 index : unit) {
+                    cli::RunStats::EntryTimer entry{recorder};
+
+                    /* Files which fail to decompress are just as corrupt as mismatching ones. */
+                    std::error_code worker_ec;
+                    if (ComputeChecksum(inflaters[worker], recorder, job.files->GetFile(index), worker_ec) != job.files->GetChecksum(index) || worker_ec) {
+                        worker_corrupt[worker].push_back({items[item].job, index});
+                    }
+
+                    bytes_in  += job.files->GetStoredSize(index);
+                    bytes_out += job.files->GetUncompressedSize(index);
+                }
+                progress.Add(worker, static_cast<u32>(unit.size()), bytes_in, bytes_out);
+
+                return true;
+            });
+
+            pool.Run(static_cast<u32>(items.size()), verify);
+
+            /* Gather the results. */
+            for (const auto &list : worker_corrupt) {
+                for (const auto &entry : list) {
+                    jobs[entry.job]->corrupt.push_back(entry.unit);
+                }
+            }
+        }
+
+        void ExtractArchives(const cli::Options &options, util::ThreadPool &pool, std::span<ArchiveJob *const> jobs, OutputSink &sink, cli::RunStats *stats, std::error_code &ec) {
+            if (stats != nullptr) {
+                stats->Prepare(pool.GetWorkerCount());
+            }
+
+            /* Plan the order of extraction and warn when the results may not fit on disk. */
+            const auto items = ScheduleUnits(jobs, pool.GetWorkerCount());
+
+            u64 total_size = 0;
+            for (const auto *job : jobs) {
+                total_size += job->plan.GetTotalSize();
+            }
+            /*
+             * A tar stream on stdout may end up anywhere, so there's nothing to check for it.
+             * Overwritten outputs give their space back, so a tight volume is only worth a warning.
+             */
+            if (options.tar_output != "-" && !options.quiet) {
+                std::error_code space_ec;
+                const fs::path target = options.tar_output.empty() ? options.output : fs::absolute(options.tar_output, space_ec).parent_path();
+                if (const auto space = fs::space(target, space_ec); !space_ec && space.available < total_size) {
+                    fmt::print(GetLogFile(options), fg(fmt::color::yellow), "Warning: {} bytes to extract, but only {} bytes are available!\n", total_size, space.available);
+                }
+            }
+
+            /* Prepare the output and try to allocate one zlib inflater for every worker. */
+            sink.Prepare(pool.GetWorkerCount());
+            util::MemoryBudget budget{GetInflateBudget(options, pool.GetWorkerCount(), sink.GetMemoryOverhead())};
+            std::vector<util::Inflater> inflaters;
+            if (AllocateInflaters(budget, pool.GetWorkerCount(), GetMaxInflatedSize(jobs), inflaters, ec); ec) {
+                return;
+            }
+
+            /* Optionally release archive contents from the page cache as extraction progresses. */
+            if (options.drop_cache) {
+                for (auto *job : jobs) {
+                    job->releaser.emplace(*job->mapped, job->GetSource(), *job->files, job->plan);
+                }
+            }
+
+            /* The first error that occurred in any of the workers. */
+            std::mutex error_mutex;
+            std::error_code first_error;
+
+            /* Every worker collects the corrupt files it found on its own. */
+            std::vector<std::vector<WorkItem>> worker_corrupt(pool.GetWorkerCount());
+
+            /* Extract the archives file by file. */
+            cli::ProgressReporter progress{jobs.size() == 1 ? "Extracting KIWAD archive..." : "Extracting KIWAD archives...", pool.GetWorkerCount(), GetProgressTotals(jobs), GetLogFile(options), IsProgressShown(options)};
+
+            auto record_error = [&](const std::error_code &worker_ec) {
+                std::scoped_lock lk{error_mutex};
+                if (!first_error) {
+                    first_error = worker_ec;
+                }
+            };
+
+            /* Errors with single files only fail their own archive; its remaining files are skipped. */
+            const auto failed = std::make_unique<std::atomic<bool>[]>(jobs.size());
+            auto record_job_error = [&](u32 job, const std::error_code &worker_ec) {
+                std::scoped_lock lk{error_mutex};
+                if (!jobs[job]->error) {
+                    jobs[job]->error = worker_ec;
+                }
+                failed[job].store(true, std::memory_order_relaxed);
+            };
+
+            /* Queued writes only report failures when they're flushed, so workers flush before */
+            /* moving on to another archive to attribute them to the archive they belong to.    */
+            constexpr u32 NoJob = std::numeric_limits<u32>::max();
+            std::vector<u32> worker_job(pool.GetWorkerCount(), NoJob);
+
+            const auto extract = util::ThreadPool::CallbackType::Make([&](u32 worker, u32 item) {
+                std::error_code worker_ec;
+                if (u32 &last = worker_job[worker]; last != items[item].job) {
+                    if (last != NoJob) {
+                        if (sink.Flush(worker, worker_ec); worker_ec) {
+                            record_job_error(last, worker_ec);
+                        }
+                    }
+                    last = items[item].job;
+                }
+
+                if (failed[items[item].job].load(std::memory_order_relaxed)) {
+                    return true;
+                }
+
+                auto &job         = *jobs[items[item].job];
+                const auto unit   = job.plan.GetUnitFiles(items[item].unit);
+                const auto source = job.GetSource();
+
+                /* Decompress the file contents, if necessary, and write them to disk. */
+                u64 bytes_in = 0, bytes_out = 0;
+                for (const u32 index : unit) {
+                    cli::RunStats::EntryTimer entry{GetRecorder(stats, worker)};
+
+                    /* When verifying, files which fail to decompress are reported like mismatching ones. */
+                    u32 checksum = 0;
+                    if (sink.Write(worker, inflaters[worker], job, index, source, job.files->GetFile(index), options.verify ? std::addressof(checksum) : nullptr, worker_ec); worker_ec) {
+                        if (!options.verify || worker_ec != std::errc::illegal_byte_sequence) {
+                            record_job_error(items[item].job, worker_ec);
+                            return true;
+                        }
+                        worker_corrupt[worker].push_back({items[item].job, index});
+                    } else if (options.verify && checksum != job.files->GetChecksum(index)) {
+                        worker_corrupt[worker].push_back({items[item].job, index});
+                    }
+
+                    bytes_in  += job.files->GetStoredSize(index);
+                    bytes_out += job.files->GetUncompressedSize(index);
+                }
+
+                /* Release the archive pages we're done with, so they don't crowd out the page cache. */
+                /* Queued writes may still read from them, so wait for those to finish beforehand. */
+                if (job.releaser.has_value()) {
+                    if (sink.Flush(worker, worker_ec); worker_ec) {
+                        record_job_error(items[item].job, worker_ec);
+                        return true;
+                    }
+                    job.releaser->Complete(items[item].unit);
+                }
+                progress.Add(worker, static_cast<u32>(unit.size()), bytes_in, bytes_out);
+
+                return true;
+            });
+
+            /* Queued writes must complete on the thread that submitted them. */
+            const auto finish = util::ThreadPool::FinishCallbackType::Make([&](u32 worker) {
+                std::error_code worker_ec;
+                if (sink.Flush(worker, worker_ec); worker_ec) {
+                    if (worker_job[worker] != NoJob) {
+                        record_job_error(worker_job[worker], worker_ec);
+                    } else {
+                        record_error(worker_ec);
+                    }
+                }
+            });
+
+            pool.Run(static_cast<u32>(items.size()), extract, finish);
+
+            if (first_error) {
+                ec = first_error;
+            }
+
+            for (const auto &list : worker_corrupt) {
+                for (const auto &entry : list) {
+                    jobs[entry.job]->corrupt.push_back(entry.unit);
+                }
+            }
+        }
+
+        void ProcessStream(const cli::Options &options, util::ThreadPool &pool, ArchiveJob &job, OutputSink &sink, cli::RunStats *stats, std::error_code &ec) {
+            const wad::FileTable &files = *job.files;
+            if (stats != nullptr) {
+                stats->Prepare(pool.GetWorkerCount());
+            }
+
+            /* Plan the order in which the contents are consumed. Large files are spilled to disk, */
+            /* next to the extracted files or, when there are none, to the temporary directory.    */
+            const fs::path spill_path = options.verify_only || !options.tar_output.empty() ? fs::temp_directory_path(ec) / fmt::format("printrospector-{:x}.spill", std::chrono::steady_clock::now().time_since_epoch().count())
+                                                            : job.output / ".printrospector-spill";
             if (ec) {
                 return;
             }
+            /* Under a memory limit, the window only takes a share of it; more files get spilled. */
+            const size_t window_size = options.max_memory != 0 ? static_cast<size_t>(std::clamp<u64>(options.max_memory / StreamWindowDivisor, 1_MB, wad::StreamReader::DefaultWindowSize))
+                                                               : wad::StreamReader::DefaultWindowSize;
+            if (job.stream->Plan(files, window_size, spill_path, ec); ec) {
+                return;
+            }
 
-            /* Do the extraction work. */
-            extract_archive_impl(mapped.GetPtr(), mapped.GetLength());
-        } else {
-            P_DEBUG_ASSERT(m_options.input_type == cli::InputType::Hex);
+            /* Prepare the output and try to allocate one zlib inflater for every worker. */
+            u32 max_inflated_size = 0;
+            for (u32 i = 0; i < files.GetCount(); ++i) {
+                if (files.IsCompressed(i)) {
+                    max_inflated_size = std::max(max_inflated_size, files.GetUncompressedSize(i));
+                }
+            }
+
+            sink.Prepare(pool.GetWorkerCount());
+            util::MemoryBudget budget{GetInflateBudget(options, pool.GetWorkerCount(), window_size + sink.GetMemoryOverhead())};
+            std::vector<util::Inflater> inflaters;
+            if (AllocateInflaters(budget, pool.GetWorkerCount(), max_inflated_size, inflaters, ec); ec) {
+                return;
+            }
+
+            /* The first error that occurred in any of the workers. */
+            std::mutex error_mutex;
+            std::error_code first_error;
+
+            /* Every worker collects the corrupt files it found on its own. */
+            std::vector<std::vector<u32>> worker_corrupt(pool.GetWorkerCount());
+
+            /* Process the archive as it comes in, one window at a time. */
+            cli::ProgressReporter::Totals totals{0, 0, 0};
+            AddProgressTotals(totals, files);
+            cli::ProgressReporter progress{options.verify_only ? "Verifying KIWAD stream..." : "Extracting KIWAD stream...", pool.GetWorkerCount(), totals, GetLogFile(options), IsProgressShown(options)};
+
+            auto record_error = [&](const std::error_code &worker_ec) {
+                std::scoped_lock lk{error_mutex};
+                if (!first_error) {
+                    first_error = worker_ec;
+                }
+            };
+
+            /* The files currently being worked on and where their contents are. */
+            wad::StreamReader::Window window{};
+            std::span<const u32> current;
+            bool spilled = false;
+            ArchiveSource source{};
+
+            const auto process = util::ThreadPool::CallbackType::Make([&](u32 worker, u32 item) {
+                const u32 index = current[item];
+                const u32 offset = files.GetOffset(index);
+                const auto file  = files.GetFile(index, spilled ? job.stream->GetSpilledContentPtr(offset) : window.GetContentPtr(offset));
+                auto *recorder   = GetRecorder(stats, worker);
+                cli::RunStats::EntryTimer entry{recorder};
+
+                /* Verify or extract the file; files which fail to decompress are just as corrupt. */
+                std::error_code worker_ec;
+                if (options.verify_only) {
+                    if (ComputeChecksum(inflaters[worker], recorder, file, worker_ec) != file.checksum || worker_ec) {
+                        worker_corrupt[worker].push_back(index);
+                    }
+                } else {
+                    u32 checksum = 0;
+                    if (sink.Write(worker, inflaters[worker], job, index, source, file, options.verify ? std::addressof(checksum) : nullptr, worker_ec); worker_ec) {
+                        if (!options.verify || worker_ec != std::errc::illegal_byte_sequence) {
+                            record_error(worker_ec);
+                            return false;
+                        }
+                        worker_corrupt[worker].push_back(index);
+                    } else if (options.verify && checksum != file.checksum) {
+                        worker_corrupt[worker].push_back(index);
+                    }
+                }
+
+                progress.Add(worker, 1, files.GetStoredSize(index), files.GetUncompressedSize(index));
+
+                return true;
+            });
+
+            /* Queued writes must complete on the thread that submitted them, and before the window is reused. */
+            const auto finish = util::ThreadPool::FinishCallbackType::Make([&](u32 worker) {
+                std::error_code worker_ec;
+                if (sink.Flush(worker, worker_ec); worker_ec) {
+                    record_error(worker_ec);
+                }
+            });
+
+            auto next_window = [&] {
+                cli::RunStats::ScopedTimer timer{GetRecorder(stats, 0), cli::Phase::Read};
+                if (!job.stream->NextWindow(window, ec)) {
+                    return false;
+                }
+                timer.SetWork(window.files.size(), 0, 0);
+                return true;
+            };
+
+            while (!first_error && next_window()) {
+                current = window.files;
+                source  = {nullptr, window.data, nullptr};
+                pool.Run(static_cast<u32>(current.size()), process, finish);
+            }
+
+            /* The spilled files are complete once the whole stream was consumed. */
+            if (!first_error && !ec && !job.stream->GetSpilledFiles().empty()) {
+                current = job.stream->GetSpilledFiles();
+                spilled = true;
+                source  = {job.stream->GetSpillFile(), job.stream->GetSpillMapping().GetPtr(), std::addressof(job.stream->GetSpillMapping())};
+                pool.Run(static_cast<u32>(current.size()), process, finish);
+            }
 
+            if (first_error) {
+                ec = first_error;
+            }
+
+            for (const auto &list : worker_corrupt) {
+                job.corrupt.insert(job.corrupt.end(), list.begin(), list.end());
+            }
+        }
+
+        P_ALWAYS_INLINE bool IsArchivePath(const fs::path &path) {
+            std::string extension = path.extension().string();
+            std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) {
+                return static_cast<char>(std::tolower(c));
+            });
+            return extension == ".wad";
+        }
+
+        void CollectBatch(const cli::Options &options, std::vector<std::unique_ptr<ArchiveJob>> &jobs, std::error_code &ec) {
+            const fs::path &source = options.input_file;
+
+            /* Archives are named by a relative path, which locates their files in the output. */
+            auto add_job = [&](fs::path input, const fs::path &relative) {
+                auto &job  = jobs.emplace_back(std::make_unique<ArchiveJob>(std::move(input), options.output / relative));
+                job->prefix = relative.generic_string();
+            };
+
+            /* Every archive in a directory is extracted into the same relative location below the output. */
+            if (fs::is_directory(source, ec)) {
+                std::vector<fs::path> archives;
+                for (fs::recursive_directory_iterator it{source, ec}, end; !ec && it != end; it.increment(ec)) {
+                    if (std::error_code type_ec; it->is_regular_file(type_ec) && IsArchivePath(it->path())) {
+                        archives.push_back(it->path());
+                    }
+                }
+                if (ec) {
+                    return;
+                }
+
+                std::sort(archives.begin(), archives.end());
+                for (auto &archive : archives) {
+                    const fs::path relative = archive.lexically_relative(source).replace_extension();
+                    add_job(std::move(archive), relative);
+                }
+                return;
+            }
+            if (ec) {
+                return;
+            }
+
+            /* Otherwise, we were given a list of archives with one path per line. */
+            FILE *list = std::fopen(source.string().c_str(), "rb");
+            if (list == nullptr) {
+                ec = std::make_error_code(std::errc::no_such_file_or_directory);
+                return;
+            }
+            P_ON_SCOPE_EXIT { std::fclose(list); };
+
+            std::string contents;
+            char buffer[4096];
+            size_t read;
+            while ((read = std::fread(buffer, 1, sizeof(buffer), list)) != 0) {
+                contents.append(buffer, read);
+            }
+
+            std::string_view remaining{contents};
+            while (!remaining.empty()) {
+                const size_t line_end = std::min(remaining.find('\n'), remaining.size());
+                std::string_view line = remaining.substr(0, line_end);
+                remaining.remove_prefix(std::min(line_end + 1, remaining.size()));
+
+                if (!line.empty() && line.back() == '\r') {
+                    line.remove_suffix(1);
+                }
+                if (line.empty() || line.front() == '#') {
+                    continue;
+                }
+
+                /* Relative paths keep their layout in the output, absolute ones are only known by their name. */
+                const fs::path path{line};
+                if (path.is_relative()) {
+                    add_job(source.parent_path() / path, fs::path{path}.replace_extension());
+                } else {
+                    add_job(path, path.stem());
+                }
+            }
+        }
+
+        void PrintBatchSummary(FILE *log, std::span<const std::unique_ptr<ArchiveJob>> jobs, std::chrono::steady_clock::duration elapsed) {
+            u32 failed = 0;
+            u64 files  = 0;
+            u64 bytes  = 0;
+            u64 skipped = 0;
+            for (const auto &job : jobs) {
+                if (job->error) {
+                    ++failed;
+                }
+                if (job->files != nullptr) {
+                    files   += job->files->GetCount();
+                    bytes   += job->plan.GetTotalSize();
+                    skipped += job->skipped;
+                }
+            }
+
+            const auto seconds = std::chrono::duration<f64>(elapsed).count();
+            fmt::print(log, "Processed {} archives: {} files, {:.1f} MiB in {:.2f}s", jobs.size(), files, static_cast<f64>(bytes) / 1_MB, seconds);
+            if (skipped != 0) {
+                fmt::print(log, ", {} unchanged files skipped", skipped);
+            }
+            fmt::print(log, ".\n");
+
+            if (failed != 0) {
+                fmt::print(log, fg(fmt::color::red), "{} of {} archives failed:\n", failed, jobs.size());
+                for (const auto &job : jobs) {
+                    if (job->error) {
+                        fmt::print(log, fg(fmt::color::red), "    {}: {}\n", job->input.string(), job->error.message());
+                    }
+                }
+            }
+        }
+
+    }
+
+    void ContentProcessor::ProcessWad(std::error_code &ec) {
+        if (m_options.input_type == cli::InputType::Hex) {
             P_TODO();
         }
+
+        const bool batch = m_options.input_type == cli::InputType::Batch;
+        const bool tar   = !m_options.tar_output.empty() && !m_options.verify_only;
+        const bool diff  = !batch && !m_options.diff_base.empty();
+        const auto start = std::chrono::steady_clock::now();
+        FILE *log        = GetLogFile(m_options);
+
+        /* Without anywhere to extract to, a diff is only reported. */
+        const bool report_only = diff && m_options.output.empty() && !tar && !m_options.verify_only;
+
+        /* Gather the archives to process, each with its own output directory. */
+        std::vector<std::unique_ptr<ArchiveJob>> jobs;
+        if (batch) {
+            if (CollectBatch(m_options, jobs, ec); ec) {
+                return;
+            }
+        } else {
+            jobs.push_back(std::make_unique<ArchiveJob>(m_options.input_file, m_options.output));
+        }
+
+        /* Open all the archives and prepare their output directories up front. In batch */
+        /* mode, archives that fail are reported at the end instead of stopping the run. */
+        /* Trees share the descriptor limit, so they have to split the budget for it.    */
+        const size_t directory_budget = io::DirectoryTree::GetDirectoryBudget() / std::max<size_t>(jobs.size(), 1);
+        std::vector<ArchiveJob *> ready;
+        for (auto &job : jobs) {
+            if (OpenArchive(m_options, m_pool, *job, batch, GetRecorder(this->GetStats(), 0), job->error); !job->error && !m_options.verify_only && !tar && !report_only) {
+                /* Create all the output directories; workers then only have to create files. */
+                const auto get_path = io::DirectoryTree::PathCallbackType::Make([&files = *job->files](u32 index) {
+                    return files.GetPath(index);
+                });
+                cli::RunStats::ScopedTimer timer{GetRecorder(this->GetStats(), 0), cli::Phase::CreateDirectories, job->files->GetCount()};
+                job->tree.Create(job->output, job->files->GetCount(), get_path, directory_budget, job->error);
+            }
+
+            if (job->error) {
+                if (!batch) {
+                    ec = job->error;
+                    return;
+                }
+                continue;
+            }
+
+            if (diff && (report_only || !m_options.quiet)) {
+                PrintDiff(log, job->diff);
+            }
+            if (!batch && IsIncremental(m_options) && !m_options.quiet) {
+                fmt::print(log, "Skipping {} unchanged files.\n", job->skipped);
+            }
+            ready.push_back(job.get());
+        }
+
+        if (report_only) {
+            return;
+        }
+
+        /* Extracted files either go to a tar stream or into the output directories. */
+        FILE *tar_file = nullptr;
+        std::optional<io::TarWriter> tar_writer;
+        std::unique_ptr<OutputSink> sink;
+        if (tar) {
+            if (m_options.tar_output == "-") {
+            #ifdef PTOR_OS_WINDOWS
+                _setmode(_fileno(stdout), _O_BINARY);
+            #endif
+                tar_file = stdout;
+            } else if (tar_file = std::fopen(m_options.tar_output.string().c_str(), "wb"); tar_file == nullptr) {
+                ec = std::make_error_code(std::errc::io_error);
+                return;
+            }
+
+            tar_writer.emplace(tar_file, static_cast<i64>(std::time(nullptr)));
+            sink = std::make_unique<TarSink>(*tar_writer, this->GetStats());
+        } else {
+            sink = std::make_unique<DirectorySink>(m_options.map_output, this->GetStats());
+        }
+
+        /* A tar file that wasn't finished is removed, so it can't be mistaken for a complete one. */
+        bool tar_finished = false;
+        P_ON_SCOPE_EXIT {
+            if (tar_file != nullptr && tar_file != stdout) {
+                std::fclose(tar_file);
+                if (!tar_finished) {
+                    std::error_code remove_ec;
+                    fs::remove(m_options.tar_output, remove_ec);
+                }
+            }
+        };
+
+        /* Verify or extract all the selected files of all archives. */
+        if (!batch && jobs.front()->stream.has_value()) {
+            ProcessStream(m_options, m_pool, *jobs.front(), *sink, this->GetStats(), ec);
+        } else if (m_options.verify_only) {
+            VerifyArchives(m_options, m_pool, ready, this->GetStats(), ec);
+        } else {
+            ExtractArchives(m_options, m_pool, ready, *sink, this->GetStats(), ec);
+        }
+        if (ec) {
+            return;
+        }
+        if (!batch && jobs.front()->error) {
+            ec = jobs.front()->error;
+            return;
+        }
+
+        /* Complete the tar stream; it stays valid even if some archives of a batch failed. */
+        if (tar_writer.has_value()) {
+            if (tar_writer->Finish(ec); ec) {
+                return;
+            }
+            tar_finished = true;
+        }
+
+        /* Record what was extracted and report the results of every archive. Archives which */
+        /* failed midway keep their old manifest, so their files are all checked next time. */
+        for (auto *job : ready) {
+            if (job->error) {
+                continue;
+            }
+            if (IsIncremental(m_options) && job->files->GetCount() != 0) {
+                UpdateManifest(*job, job->error);
+            }
+            if (!job->error) {
+                ReportCorruptFiles(log, *job, batch);
+            }
+        }
+
+        if (batch && !m_options.quiet) {
+            PrintBatchSummary(log, jobs, std::chrono::steady_clock::now() - start);
+        }
+
+        /* Fail with the first error of any of the archives. */
+        for (const auto &job : jobs) {
+            if (job->error) {
+                ec = job->error;
+                return;
+            }
+        }
+    }
+
+    void ContentProcessor::SaveWad(std::error_code &ec) {
+        if (m_options.input_type != cli::InputType::File || m_options.output.empty()) {
+            ec = std::make_error_code(std::errc::invalid_argument);
+            return;
+        }
+
+        /* Gather the files to pack from the input directory. */
+        wad::Packer packer;
+        {
+            cli::RunStats::ScopedTimer timer{GetRecorder(this->GetStats(), 0), cli::Phase::Scan};
+            if (packer.AddDirectory(m_options.input_file, ec); ec) {
+                return;
+            }
+            timer.SetWork(packer.GetFileCount(), packer.GetTotalSize(), 0);
+        }
+
+        /* Compress the files on all workers and write them out in a fixed order. */
+        {
+            /* Packing runs on all workers, so its CPU time is taken from the whole process. */
+            cli::RunStats::ScopedTimer timer{GetRecorder(this->GetStats(), 0), cli::Phase::Pack, packer.GetFileCount(), packer.GetTotalSize(), 0, true};
+
+            const bool shown = !m_options.quiet && cli::ProgressReporter::IsTerminal(stdout);
+            cli::ProgressReporter progress{"Packing KIWAD archive...", 1, {packer.GetFileCount(), packer.GetTotalSize(), 0}, stdout, shown};
+            const auto report = wad::Packer::ProgressCallbackType::Make([&progress](u32 files, u64 bytes_read, u64 bytes_written) {
+                /* The packer reports from the calling thread only. */
+                progress.Add(0, files, bytes_read, bytes_written);
+            });
+
+            if (packer.Write(m_options.output, m_pool, m_options.compression_level, report, ec); ec) {
+                return;
+            }
+
+            std::error_code size_ec;
+            if (const auto size = fs::file_size(m_options.output, size_ec); !size_ec) {
+                timer.SetWork(packer.GetFileCount(), packer.GetTotalSize(), size);
+            }
+        }
+
+        if (!m_options.quiet && packer.GetDuplicateCount() != 0) {
+            fmt::print("Shared the contents of {} duplicate files, saving {} bytes.\n", packer.GetDuplicateCount(), packer.GetDeduplicatedSize());
+        }
     }
 
 }
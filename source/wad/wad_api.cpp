@@ -16,53 +16,38 @@
 
 #include "wad/wad_api.hpp"
 
-#include "assert.hpp"
+#include <cstring>
 
 namespace ptor::wad {
 
     namespace {
 
-        P_ALWAYS_INLINE std::string_view ReadPath(io::BinaryBuffer &buffer) {
-            size_t len = buffer.ReadValue<u32>();
-            char *data = reinterpret_cast<char *>(buffer.GetCursorPtr());
-            buffer.RewindCursor(buffer.GetCursorOffset() + static_cast<ptrdiff_t>(len));
-
-            P_ASSERT(data[len - 1] == 0, "corrupt file path string");
-            return {data, len};
-        }
+        /* The magic, the version and the file count; version 2 adds a byte of flags. */
+        constexpr inline size_t BaseHeaderSize = 5 + 2 * sizeof(u32);
 
     }
 
-    Header ReadHeader(io::BinaryBuffer &buffer) {
+    Header ReadHeader(io::BinaryBuffer &buffer, std::error_code &ec) {
+        /* Reset the error code back into a successful state. */
+        ec.clear();
+
         /* Validate the KIWAD archive magic and discard it. */
-        P_ASSERT(std::memcmp(buffer.GetCursorPtr(), ArchiveMagic, 5) == 0, "archive does not start with KIWAD magic");
+        if (!buffer.HasSpaceForBytes(BaseHeaderSize) || std::memcmp(buffer.GetCursorPtr(), ArchiveMagic, 5) != 0) {
+            ec = std::make_error_code(std::errc::illegal_byte_sequence);
+            return {};
+        }
         buffer.RewindCursor(5);
 
         /* Read the header fields. */
         const u32 version    = buffer.ReadValue<u32>();
         const u32 file_count = buffer.ReadValue<u32>();
-        const auto flags     = (version >= 2) ? static_cast<ArchiveFlags>(buffer.ReadValue<u8>()) : ArchiveFlag_None;
-
-        return {version, file_count, flags};
-    }
-
-    File ReadFile(u8 *archive, io::BinaryBuffer &buffer) {
-        /* Read the file metadata fields. */
-        const u32 start_offset      = buffer.ReadValue<u32>();
-        const u32 uncompressed_size = buffer.ReadValue<u32>();
-        const u32 compressed_size   = buffer.ReadValue<u32>();
-        const bool compressed       = buffer.ReadValue<u8>() != 0;
-        const u32 checksum          = buffer.ReadValue<u32>();
-        const fs::path path         = ReadPath(buffer);
-
-        /* Assert that we can safely reference data at `start_offset`. */
-        {
-            const auto file_start = start_offset - buffer.GetCursorOffset();
-            const auto file_size  = compressed ? compressed_size : uncompressed_size;
-            P_ASSERT(buffer.HasSpaceForBytes(file_start + file_size), "KIWAD archive corrupt: prematurely found EOF");
+        if (version >= 2 && !buffer.HasSpaceForBytes(sizeof(u8))) {
+            ec = std::make_error_code(std::errc::illegal_byte_sequence);
+            return {};
         }
+        const auto flags = (version >= 2) ? static_cast<ArchiveFlags>(buffer.ReadValue<u8>()) : ArchiveFlag_None;
 
-        return {archive + start_offset, uncompressed_size, compressed_size, compressed, checksum, path};
+        return {version, file_count, flags};
     }
 
 }
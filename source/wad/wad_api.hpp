@@ -16,14 +16,15 @@
 #pragma once
 
 #include <span>
+#include <system_error>
 
 #include "io/io_binary_buffer.hpp"
 #include "wad/wad_types.hpp"
 
 namespace ptor::wad {
 
-    Header ReadHeader(io::BinaryBuffer &buffer);
-
-    File ReadFile(u8 *archive, io::BinaryBuffer &buffer);
+    /* Reads the archive header at the cursor of `buffer`, failing with */
+    /* `illegal_byte_sequence` if it is truncated or not a KIWAD one.   */
+    Header ReadHeader(io::BinaryBuffer &buffer, std::error_code &ec);
 
 }
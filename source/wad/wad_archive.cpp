@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2022 Valentin B.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "wad/wad_archive.hpp"
+
+#include "io/io_binary_buffer.hpp"
+#include "wad/wad_api.hpp"
+#include "wad/wad_toc_cache.hpp"
+
+namespace ptor::wad {
+
+    Archive::Archive() : m_header{}, m_cache{nullptr} {}
+
+    void Archive::Load(u8 *data, size_t len, std::error_code &ec) {
+        return this->Load(data, len, len, ec);
+    }
+
+    void Archive::Load(u8 *data, size_t len, u64 archive_len, std::error_code &ec) {
+        io::BinaryBuffer buffer{data, len};
+
+        m_header = ReadHeader(buffer, ec);
+        m_index.clear();
+        m_cache  = nullptr;
+        if (ec) {
+            m_files = FileTable{};
+            return;
+        }
+
+        /* The file table directly follows the header. */
+        m_files.Parse(data, len, static_cast<size_t>(buffer.GetCursorOffset()), m_header.file_count, archive_len, ec);
+    }
+
+    bool Archive::Load(u8 *data, size_t len, const TocCache &cache) {
+        m_header = cache.GetHeader();
+        m_index.clear();
+        m_cache  = nullptr;
+
+        /* The cache was written from a parsed table; only check it wasn't damaged since. */
+        m_files.Borrow(data, m_header.file_count, cache.GetColumns());
+        if (!m_files.Validate(len)) {
+            return false;
+        }
+
+        m_cache = std::addressof(cache);
+        return true;
+    }
+
+    void Archive::BuildIndex() {
+        if (m_cache != nullptr) {
+            return;
+        }
+
+        m_index.clear();
+        m_index.reserve(m_header.file_count);
+
+        for (u32 i = 0; i < m_header.file_count; ++i) {
+            m_index.try_emplace(m_files.GetPath(i), i);
+        }
+    }
+
+    std::optional<u32> Archive::Find(std::string_view path) const {
+        if (m_cache != nullptr) {
+            return m_cache->Find(m_files, path);
+        }
+
+        if (const auto it = m_index.find(path); it != m_index.end()) {
+            return it->second;
+        }
+        return std::nullopt;
+    }
+
+}
@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2022 Valentin B.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <optional>
+#include <string_view>
+#include <system_error>
+#include <unordered_map>
+
+#include "ptor_defines.hpp"
+#include "ptor_types.hpp"
+#include "wad/wad_file_table.hpp"
+#include "wad/wad_types.hpp"
+
+namespace ptor::wad {
+
+    class TocCache;
+
+    /* A parsed KIWAD archive in memory, with optional lookup of files by path. */
+    /* The archive data must outlive the object; files point straight into it.  */
+    class Archive final {
+        P_DISALLOW_COPY_AND_ASSIGN(Archive);
+        P_DISALLOW_MOVE(Archive);
+
+    private:
+        Header m_header;
+        FileTable m_files;
+        std::unordered_map<std::string_view, u32> m_index;
+        const TocCache *m_cache;
+
+    public:
+        Archive();
+
+        /* Reads the header and the file table of the archive at `data`. */
+        void Load(u8 *data, size_t len, std::error_code &ec);
+
+        /* Reads the header and the file table from the first `len` bytes of an archive of */
+        /* `archive_len` bytes, for when the rest of the archive isn't held in memory.     */
+        void Load(u8 *data, size_t len, u64 archive_len, std::error_code &ec);
+
+        /* Takes the file table and the path index of the archive at `data` from an open  */
+        /* cache, which must outlive this object. Returns false if the cache is damaged.  */
+        bool Load(u8 *data, size_t len, const TocCache &cache);
+
+        /* Builds the hash index from archive-relative paths to files.   */
+        /* If a path occurs more than once, the first file takes it.     */
+        /* Archives loaded from a cache already have their index.        */
+        void BuildIndex();
+
+        /* Looks up the index of a file by its archive-relative path. */
+        std::optional<u32> Find(std::string_view path) const;
+
+        P_ALWAYS_INLINE const Header &GetHeader() const { return m_header; }
+
+        P_ALWAYS_INLINE u32 GetFileCount() const { return m_header.file_count; }
+
+        P_ALWAYS_INLINE const FileTable &GetFiles() const { return m_files; }
+    };
+
+}
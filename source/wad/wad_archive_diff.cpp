@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2022 Valentin B.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "wad/wad_archive_diff.hpp"
+
+#include <unordered_map>
+
+namespace ptor::wad {
+
+    ArchiveDiff::ArchiveDiff() = default;
+
+    void ArchiveDiff::Compare(const FileTable &base, const FileTable &target) {
+        m_added.clear();
+        m_modified.clear();
+        m_removed.clear();
+        m_changed.clear();
+
+        /* Index the base archive by path, keeping the first file for every path. */
+        std::unordered_map<std::string_view, u32> lookup;
+        lookup.reserve(base.GetCount());
+        for (u32 i = 0; i < base.GetCount(); ++i) {
+            lookup.try_emplace(base.GetPath(i), i);
+        }
+
+        /* Match every file of the target against its counterpart in the base. */
+        std::vector<bool> matched(base.GetCount());
+        for (u32 i = 0; i < target.GetCount(); ++i) {
+            const std::string_view path = target.GetPath(i);
+
+            const auto it = lookup.find(path);
+            if (it == lookup.end()) {
+                m_added.push_back(path);
+                m_changed.push_back(i);
+                continue;
+            }
+
+            const u32 other = it->second;
+            matched[other]  = true;
+            if (base.GetUncompressedSize(other) != target.GetUncompressedSize(i) || base.GetChecksum(other) != target.GetChecksum(i)) {
+                m_modified.push_back(path);
+                m_changed.push_back(i);
+            }
+        }
+
+        /* Whatever wasn't matched is gone; later files with an indexed path were never candidates. */
+        for (u32 i = 0; i < base.GetCount(); ++i) {
+            const std::string_view path = base.GetPath(i);
+            if (!matched[i] && lookup.find(path)->second == i) {
+                m_removed.push_back(path);
+            }
+        }
+    }
+
+}
@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2022 Valentin B.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "ptor_defines.hpp"
+#include "ptor_types.hpp"
+#include "wad/wad_file_table.hpp"
+
+namespace ptor::wad {
+
+    /* The differences between two revisions of an archive, found by comparing their   */
+    /* file tables alone. Files are matched by path and count as modified when their    */
+    /* uncompressed size or checksum differ; how they are compressed doesn't matter.   */
+    /* Paths are views into the archives, which must outlive this object.              */
+    class ArchiveDiff final {
+        P_DISALLOW_COPY_AND_ASSIGN(ArchiveDiff);
+        P_DISALLOW_MOVE(ArchiveDiff);
+
+    private:
+        std::vector<std::string_view> m_added;
+        std::vector<std::string_view> m_modified;
+        std::vector<std::string_view> m_removed;
+        std::vector<u32> m_changed;
+
+    public:
+        ArchiveDiff();
+
+        /* Compares the files of `target` against those of an earlier revision in `base`. */
+        /* If a path occurs more than once in an archive, the first file takes it.         */
+        void Compare(const FileTable &base, const FileTable &target);
+
+        /* Paths of the files only in the target, in the order of its file table. */
+        P_ALWAYS_INLINE std::span<const std::string_view> GetAdded() const { return m_added; }
+
+        /* Paths of the files in both archives whose contents differ, in the order of the target. */
+        P_ALWAYS_INLINE std::span<const std::string_view> GetModified() const { return m_modified; }
+
+        /* Paths of the files only in the base, in the order of its file table. */
+        P_ALWAYS_INLINE std::span<const std::string_view> GetRemoved() const { return m_removed; }
+
+        /* Indices of the added and modified files in the target's file table, in order. */
+        P_ALWAYS_INLINE std::span<const u32> GetChangedFiles() const { return m_changed; }
+
+        P_ALWAYS_INLINE bool IsEmpty() const { return m_added.empty() && m_modified.empty() && m_removed.empty(); }
+    };
+
+}
@@ -0,0 +1,157 @@
+/*
+ * Copyright (c) 2022 Valentin B.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "wad/wad_archive_reader.hpp"
+
+#include <bit>
+#include <cstring>
+
+#include "assert.hpp"
+#include "util/util_encoding.hpp"
+#include "util/util_scope_guard.hpp"
+#include "wad/wad_types.hpp"
+
+namespace ptor::wad {
+
+    namespace {
+
+        /* The smallest possible archive: the magic, the version and the file count. */
+        constexpr inline size_t MinArchiveSize = 5 + 2 * sizeof(u32);
+
+        /* Version 2 adds a byte of flags to the header. */
+        P_ALWAYS_INLINE size_t GetHeaderSize(const u8 *data) {
+            return MinArchiveSize + (util::Decode<u32, std::endian::little>(data + 5) >= 2 ? sizeof(u8) : 0);
+        }
+
+    }
+
+    ArchiveReader::ArchiveReader(size_t cache_capacity) : m_cache{cache_capacity} {}
+
+    void ArchiveReader::Open(const fs::path &path, std::error_code &ec) {
+        /* Reset the error code back into a successful state. */
+        ec.clear();
+
+        P_ASSERT(!this->IsOpen(), "archive was already opened");
+
+        FILE *file = std::fopen(path.string().c_str(), "rb");
+        if (file == nullptr) {
+            ec = std::make_error_code(std::errc::no_such_file_or_directory);
+            return;
+        }
+        P_ON_SCOPE_EXIT { std::fclose(file); };
+
+        /* Entries are read in no particular order; the mapping outlives the file handle. */
+        auto mapped = io::ReadOnlyMapped::Map(file, {.advice = io::Advice::Random}, ec);
+        if (ec) {
+            return;
+        }
+
+        /* Reject anything that isn't an archive before handing it to the parser. */
+        if (mapped.GetLength() < MinArchiveSize || std::memcmp(mapped.GetPtr(), ArchiveMagic, 5) != 0 || mapped.GetLength() < GetHeaderSize(mapped.GetPtr())) {
+            ec = std::make_error_code(std::errc::illegal_byte_sequence);
+            return;
+        }
+
+        if (m_archive.Load(mapped.GetPtr(), mapped.GetLength(), ec); ec) {
+            return;
+        }
+        m_archive.BuildIndex();
+        m_mapped.emplace(std::move(mapped));
+    }
+
+    EntryView ArchiveReader::Read(u32 index, std::error_code &ec) {
+        /* Reset the error code back into a successful state. */
+        ec.clear();
+
+        P_ASSERT(index < m_archive.GetFileCount(), "file index {} out of range", index);
+
+        const File file = m_archive.GetFiles().GetFile(index);
+        if (!file.compressed) {
+            return {nullptr, {file.content_ptr, file.uncompressed_size}};
+        }
+
+        const auto fill = EntryCache::FillCallbackType::Make([this, &file](u8 *out, std::error_code &fill_ec) {
+            this->Inflate(file, out, fill_ec);
+        });
+
+        auto buffer = m_cache.Get(index, file.uncompressed_size, fill, ec);
+        if (ec) {
+            return {};
+        }
+
+        const std::span<const u8> contents{buffer.get(), file.uncompressed_size};
+        return {std::move(buffer), contents};
+    }
+
+    EntryView ArchiveReader::Read(std::string_view path, std::error_code &ec) {
+        const auto index = m_archive.Find(path);
+        if (!index.has_value()) {
+            ec = std::make_error_code(std::errc::no_such_file_or_directory);
+            return {};
+        }
+
+        return this->Read(*index, ec);
+    }
+
+    void ArchiveReader::ReadInto(u32 index, std::span<u8> out, std::error_code &ec) {
+        /* Reset the error code back into a successful state. */
+        ec.clear();
+
+        P_ASSERT(index < m_archive.GetFileCount(), "file index {} out of range", index);
+
+        const File file = m_archive.GetFiles().GetFile(index);
+        if (out.size() < file.uncompressed_size) {
+            ec = std::make_error_code(std::errc::no_buffer_space);
+            return;
+        }
+
+        if (file.compressed) {
+            this->Inflate(file, out.data(), ec);
+        } else if (file.uncompressed_size != 0) {
+            std::memcpy(out.data(), file.content_ptr, file.uncompressed_size);
+        }
+    }
+
+    void ArchiveReader::Inflate(const File &file, u8 *out, std::error_code &ec) {
+        /* Take an idle inflater or make a new one; they only carry a small amount of state. */
+        std::optional<util::Inflater> inflater;
+        {
+            std::scoped_lock lk{m_inflater_mutex};
+            if (!m_inflaters.empty()) {
+                inflater.emplace(std::move(m_inflaters.back()));
+                m_inflaters.pop_back();
+            }
+        }
+        if (!inflater.has_value()) {
+            auto allocated = util::Inflater::Allocate(0, ec);
+            if (ec) {
+                return;
+            }
+            inflater.emplace(std::move(allocated));
+        }
+
+        /* The output is sized exactly, so anything short of or beyond it is a corrupt entry. */
+        if (inflater->DecompressInto(file.content_ptr, file.compressed_size, out, file.uncompressed_size, ec) != file.uncompressed_size && !ec) {
+            ec = std::make_error_code(std::errc::illegal_byte_sequence);
+        } else if (ec == std::errc::no_buffer_space) {
+            ec = std::make_error_code(std::errc::illegal_byte_sequence);
+        }
+
+        std::scoped_lock lk{m_inflater_mutex};
+        m_inflaters.push_back(std::move(*inflater));
+    }
+
+}
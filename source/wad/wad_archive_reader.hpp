@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2022 Valentin B.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include "ptor_defines.hpp"
+#include "ptor_types.hpp"
+#include "io/io_memory_mapped.hpp"
+#include "util/util_literals.hpp"
+#include "util/util_zlib_inflater.hpp"
+#include "wad/wad_archive.hpp"
+#include "wad/wad_entry_cache.hpp"
+
+namespace ptor::wad {
+
+    /* A view of the uncompressed contents of an archive entry. Views of compressed */
+    /* entries keep their inflated contents alive, even once they left the cache.   */
+    class EntryView {
+    private:
+        EntryCache::BufferType m_owner;
+        std::span<const u8> m_contents;
+
+    public:
+        EntryView() = default;
+
+        EntryView(EntryCache::BufferType owner, std::span<const u8> contents) : m_owner{std::move(owner)}, m_contents{contents} {}
+
+        P_ALWAYS_INLINE const u8 *GetData() const { return m_contents.data(); }
+
+        P_ALWAYS_INLINE size_t GetSize() const { return m_contents.size(); }
+
+        P_ALWAYS_INLINE std::span<const u8> GetSpan() const { return m_contents; }
+
+        /* Whether the view points straight into the archive, without any copy. */
+        P_ALWAYS_INLINE bool IsZeroCopy() const { return m_owner == nullptr; }
+    };
+
+    /* Random access to the entries of an archive on disk, for serving them repeatedly.   */
+    /* The archive is opened and mapped once. Stored entries are handed out as views of  */
+    /* the mapping; compressed ones are inflated on first use and kept in an `EntryCache`. */
+    /* All reads may happen concurrently from any number of threads.                      */
+    class ArchiveReader final {
+        P_DISALLOW_COPY_AND_ASSIGN(ArchiveReader);
+        P_DISALLOW_MOVE(ArchiveReader);
+
+    public:
+        static constexpr size_t DefaultCacheCapacity = 256_MB;
+
+    private:
+        std::optional<io::ReadOnlyMapped> m_mapped;
+        Archive m_archive;
+        EntryCache m_cache;
+
+        /* Inflaters are only used for one entry at a time, so idle ones are shared. */
+        std::mutex m_inflater_mutex;
+        std::vector<util::Inflater> m_inflaters;
+
+    public:
+        explicit ArchiveReader(size_t cache_capacity = DefaultCacheCapacity);
+
+        /* Opens and maps the archive at `path` and indexes its files by path. */
+        void Open(const fs::path &path, std::error_code &ec);
+
+        P_ALWAYS_INLINE bool IsOpen() const { return m_mapped.has_value(); }
+
+        P_ALWAYS_INLINE const Archive &GetArchive() const { return m_archive; }
+
+        P_ALWAYS_INLINE const EntryCache &GetCache() const { return m_cache; }
+
+        /* Looks up the index of a file by its archive-relative path. */
+        P_ALWAYS_INLINE std::optional<u32> Find(std::string_view path) const { return m_archive.Find(path); }
+
+        /* Gets the uncompressed contents of the file at `index`. */
+        EntryView Read(u32 index, std::error_code &ec);
+
+        /* Gets the uncompressed contents of the file at `path`. */
+        EntryView Read(std::string_view path, std::error_code &ec);
+
+        /* Copies the uncompressed contents of the file at `index` into `out`, which must */
+        /* hold at least as many bytes. Compressed files are inflated straight into `out` */
+        /* without going through the cache, for callers which keep the contents anyway.   */
+        void ReadInto(u32 index, std::span<u8> out, std::error_code &ec);
+
+    private:
+        void Inflate(const File &file, u8 *out, std::error_code &ec);
+    };
+
+}
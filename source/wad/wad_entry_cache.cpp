@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2022 Valentin B.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "wad/wad_entry_cache.hpp"
+
+#include <algorithm>
+
+namespace ptor::wad {
+
+    EntryCache::EntryCache(size_t capacity) : m_capacity{capacity}, m_size{0}, m_hits{0}, m_misses{0} {}
+
+    EntryCache::BufferType EntryCache::Get(u32 key, u32 size, const FillCallbackType &fill, std::error_code &ec) {
+        /* Reset the error code back into a successful state. */
+        ec.clear();
+
+        std::unique_lock lk{m_mutex};
+
+        /* Entries which would evict everything else are never worth caching. */
+        if (size > m_capacity) {
+            m_misses += 1;
+            lk.unlock();
+
+            auto buffer = std::make_shared_for_overwrite<u8[]>(std::max<u32>(size, 1));
+            if (fill(buffer.get(), ec); ec) {
+                return {};
+            }
+            return buffer;
+        }
+
+        /* Wait for the entry if another thread is producing it. If that fails, we try ourselves. */
+        for (auto it = m_slots.find(key); it != m_slots.end(); it = m_slots.find(key)) {
+            auto &slot = it->second;
+            if (slot.ready) {
+                m_hits += 1;
+                m_lru.splice(m_lru.begin(), m_lru, slot.lru);
+                return slot.data;
+            }
+
+            m_ready.wait(lk);
+        }
+
+        /* Claim the entry, so nobody else produces it in the meantime. */
+        m_misses += 1;
+        auto &slot = m_slots.emplace(key, Slot{nullptr, size, false, m_lru.end()}).first->second;
+        lk.unlock();
+
+        auto buffer = std::make_shared_for_overwrite<u8[]>(std::max<u32>(size, 1));
+        fill(buffer.get(), ec);
+
+        lk.lock();
+        if (ec) {
+            m_slots.erase(key);
+        } else {
+            slot.data  = buffer;
+            slot.ready = true;
+            m_lru.push_front(key);
+            slot.lru   = m_lru.begin();
+            m_size    += size;
+
+            /* Make room by evicting the least recently used entries. */
+            while (m_size > m_capacity) {
+                const auto victim = m_slots.find(m_lru.back());
+                m_size -= victim->second.size;
+                m_slots.erase(victim);
+                m_lru.pop_back();
+            }
+        }
+        m_ready.notify_all();
+
+        if (ec) {
+            return {};
+        }
+        return buffer;
+    }
+
+    void EntryCache::Clear() {
+        std::scoped_lock lk{m_mutex};
+
+        /* Entries which are being produced right now are left to their threads. */
+        for (const u32 key : m_lru) {
+            m_slots.erase(key);
+        }
+        m_lru.clear();
+        m_size = 0;
+    }
+
+    size_t EntryCache::GetSize() const {
+        std::scoped_lock lk{m_mutex};
+        return m_size;
+    }
+
+    u64 EntryCache::GetHitCount() const {
+        std::scoped_lock lk{m_mutex};
+        return m_hits;
+    }
+
+    u64 EntryCache::GetMissCount() const {
+        std::scoped_lock lk{m_mutex};
+        return m_misses;
+    }
+
+}
@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2022 Valentin B.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <condition_variable>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <unordered_map>
+
+#include "ptor_defines.hpp"
+#include "ptor_types.hpp"
+#include "util/util_i_function.hpp"
+
+namespace ptor::wad {
+
+    /* A thread-safe cache of inflated archive entries, bounded by their combined size.      */
+    /* The least recently used entries are evicted first. An entry missing from the cache is */
+    /* only ever produced by one thread; all others asking for it wait for that result.      */
+    class EntryCache final {
+        P_DISALLOW_COPY_AND_ASSIGN(EntryCache);
+        P_DISALLOW_MOVE(EntryCache);
+
+    public:
+        /* Buffers stay alive while they're in use, even after they were evicted. */
+        using BufferType = std::shared_ptr<const u8[]>;
+
+        /* Invoked as `fill(out, ec)` to produce the contents of a missing entry. */
+        using FillCallbackType = util::IFunction<void(u8 *, std::error_code &)>;
+
+    private:
+        struct Slot {
+            BufferType data;
+            u32 size;
+            bool ready;
+            std::list<u32>::iterator lru;
+        };
+
+    private:
+        mutable std::mutex m_mutex;
+        std::condition_variable m_ready;
+        std::unordered_map<u32, Slot> m_slots;
+        std::list<u32> m_lru;
+        size_t m_capacity;
+        size_t m_size;
+        u64 m_hits;
+        u64 m_misses;
+
+    public:
+        explicit EntryCache(size_t capacity);
+
+        /* Gets the `size` bytes of the entry `key`, calling `fill` to produce them when they */
+        /* aren't cached. Entries larger than the whole cache are produced on every call.     */
+        BufferType Get(u32 key, u32 size, const FillCallbackType &fill, std::error_code &ec);
+
+        /* Drops all cached entries; buffers which are still in use stay valid. */
+        void Clear();
+
+        P_ALWAYS_INLINE size_t GetCapacity() const { return m_capacity; }
+
+        /* Gets the combined size of all the cached entries. */
+        size_t GetSize() const;
+
+        /* Gets the amount of lookups which were served from the cache or had to fill it. */
+        u64 GetHitCount() const;
+        u64 GetMissCount() const;
+    };
+
+}
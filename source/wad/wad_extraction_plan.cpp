@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2022 Valentin B.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "wad/wad_extraction_plan.hpp"
+
+#include <algorithm>
+#include <numeric>
+
+namespace ptor::wad {
+
+    namespace {
+
+        /* Units above this fraction of a worker's fair share are scheduled first. */
+        constexpr inline u64 HeavyUnitDivisor = 8;
+
+        P_ALWAYS_INLINE u64 GetFileCost(u32 uncompressed_size) {
+            return ExtractionPlan::FileOverhead + uncompressed_size;
+        }
+
+    }
+
+    ExtractionPlan::ExtractionPlan() : m_max_inflated_size{0}, m_total_size{0} {}
+
+    void ExtractionPlan::Build(const FileTable &files, u32 workers) {
+        const u32 count   = files.GetCount();
+        const auto &table = files.GetColumns();
+
+        m_order.resize(count);
+        m_units.clear();
+        m_max_inflated_size = 0;
+        m_total_size        = 0;
+
+        /* Visit the files in the order their contents appear in the archive. */
+        std::iota(m_order.begin(), m_order.end(), 0);
+        std::stable_sort(m_order.begin(), m_order.end(), [&table](u32 lhs, u32 rhs) {
+            return table.offsets[lhs] < table.offsets[rhs];
+        });
+
+        /* Gather statistics and group the files into units of work. */
+        u64 total_cost = 0;
+        for (u32 i = 0; i < count; ++i) {
+            const u32 size = table.uncompressed_sizes[m_order[i]];
+
+            if (table.compressed[m_order[i]] != 0) {
+                m_max_inflated_size = std::max(m_max_inflated_size, size);
+            }
+            m_total_size += size;
+            total_cost   += GetFileCost(size);
+
+            /* Small files join the preceding batch while it has room for them. */
+            if (size < SmallFileSize && !m_units.empty()) {
+                auto &last = m_units.back();
+                const u32 prev_size = table.uncompressed_sizes[m_order[last.first + last.count - 1]];
+
+                const u64 batch_size = last.cost - last.count * FileOverhead;
+                if (prev_size < SmallFileSize && last.count < MaxBatchFiles && batch_size + size <= MaxBatchSize) {
+                    last.count += 1;
+                    last.cost  += GetFileCost(size);
+                    continue;
+                }
+            }
+
+            m_units.push_back({i, 1, GetFileCost(size)});
+        }
+
+        /* A single worker has nothing to balance; keep the reads fully sequential. */
+        if (workers <= 1) {
+            return;
+        }
+
+        /* One heavy unit near the end would leave all the other workers idle, so hoist those. */
+        const u64 threshold = total_cost / (static_cast<u64>(workers) * HeavyUnitDivisor);
+        const auto heavy_end = std::stable_partition(m_units.begin(), m_units.end(), [threshold](const ExtractionUnit &unit) {
+            return unit.cost > threshold;
+        });
+        std::stable_sort(m_units.begin(), heavy_end, [](const ExtractionUnit &lhs, const ExtractionUnit &rhs) {
+            return lhs.cost > rhs.cost;
+        });
+    }
+
+}
@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2022 Valentin B.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <span>
+#include <vector>
+
+#include "ptor_defines.hpp"
+#include "ptor_types.hpp"
+#include "util/util_literals.hpp"
+#include "wad/wad_file_table.hpp"
+
+namespace ptor::wad {
+
+    /* A run of files which are adjacent in the archive and extracted together. */
+    struct ExtractionUnit {
+        u32 first; /* Index of the first file in the plan's order. */
+        u32 count; /* The amount of files in this unit.            */
+        u64 cost;  /* An estimate of the work to extract the unit. */
+    };
+
+    /* Decides in which order and grouping the files of an archive are extracted.  */
+    /* Files are visited in the order of their contents in the archive, so reads    */
+    /* stay sequential and benefit from readahead. Runs of tiny files are batched   */
+    /* into a single unit of work to amortize the scheduling overhead per file.    */
+    class ExtractionPlan final {
+        P_DISALLOW_COPY_AND_ASSIGN(ExtractionPlan);
+        P_DISALLOW_MOVE(ExtractionPlan);
+
+    public:
+        /* Files smaller than this are batched with their neighbors. */
+        static constexpr u32 SmallFileSize = 16_KB;
+
+        /* Limits for the combined size and the number of files in a batch. */
+        static constexpr u64 MaxBatchSize  = 256_KB;
+        static constexpr u32 MaxBatchFiles = 64;
+
+        /* The fixed cost of creating a file, in terms of bytes written. */
+        static constexpr u64 FileOverhead = 4_KB;
+
+    private:
+        std::vector<u32> m_order;
+        std::vector<ExtractionUnit> m_units;
+        u32 m_max_inflated_size;
+        u64 m_total_size;
+
+    public:
+        ExtractionPlan();
+
+        /* Plans the extraction of all `files` for the given amount of workers.   */
+        /* With more than one worker, units heavy enough to stall the end of the  */
+        /* extraction are hoisted to the front; everything else keeps its order.  */
+        void Build(const FileTable &files, u32 workers);
+
+        P_ALWAYS_INLINE u32 GetUnitCount() const { return static_cast<u32>(m_units.size()); }
+
+        /* Gets the indices of the files in the given unit, in extraction order. */
+        P_ALWAYS_INLINE std::span<const u32> GetUnitFiles(u32 unit) const {
+            const auto &u = m_units[unit];
+            return {m_order.data() + u.first, u.count};
+        }
+
+        /* Gets the estimated cost of extracting the given unit. */
+        P_ALWAYS_INLINE u64 GetUnitCost(u32 unit) const { return m_units[unit].cost; }
+
+        /* Gets the largest uncompressed size of any compressed file. */
+        P_ALWAYS_INLINE u32 GetMaxInflatedSize() const { return m_max_inflated_size; }
+
+        /* Gets the combined uncompressed size of all files. */
+        P_ALWAYS_INLINE u64 GetTotalSize() const { return m_total_size; }
+    };
+
+}
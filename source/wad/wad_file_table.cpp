@@ -0,0 +1,169 @@
+/*
+ * Copyright (c) 2022 Valentin B.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "wad/wad_file_table.hpp"
+
+#include <bit>
+#include <cstring>
+#include <limits>
+
+#include "util/util_encoding.hpp"
+
+namespace ptor::wad {
+
+    namespace {
+
+        P_ALWAYS_INLINE u32 ReadU32(const u8 *ptr) {
+            return util::Decode<u32, std::endian::little>(ptr);
+        }
+
+        P_ALWAYS_INLINE u64 ComputeStoredSize(u32 uncompressed_size, u32 compressed_size, u8 compressed) {
+            return compressed != 0 ? compressed_size : uncompressed_size;
+        }
+
+    }
+
+    FileTable::FileTable() : m_archive{nullptr}, m_count{0}, m_columns{} {}
+
+    FileTable::MutableColumns FileTable::Allocate(u8 *archive, u32 count) {
+        /* All columns share a single allocation; the byte-sized one goes last to keep the others aligned. */
+        m_archive = archive;
+        m_count   = count;
+        m_storage = std::make_unique_for_overwrite<u8[]>(GetStorageSize(count));
+
+        u32 *base = reinterpret_cast<u32 *>(m_storage.get());
+        const MutableColumns columns = {
+            base + 0 * static_cast<size_t>(count),
+            base + 1 * static_cast<size_t>(count),
+            base + 2 * static_cast<size_t>(count),
+            base + 3 * static_cast<size_t>(count),
+            base + 4 * static_cast<size_t>(count),
+            base + 5 * static_cast<size_t>(count),
+            reinterpret_cast<u8 *>(base + 6 * static_cast<size_t>(count)),
+        };
+
+        m_columns = {
+            columns.offsets, columns.uncompressed_sizes, columns.compressed_sizes, columns.checksums,
+            columns.path_offsets, columns.path_lengths, columns.compressed,
+        };
+        return columns;
+    }
+
+    void FileTable::Parse(u8 *archive, size_t len, size_t offset, u32 count, std::error_code &ec) {
+        return this->Parse(archive, len, offset, count, len, ec);
+    }
+
+    void FileTable::Parse(u8 *archive, size_t len, size_t offset, u32 count, u64 archive_len, std::error_code &ec) {
+        /* Reset the error code back into a successful state. */
+        ec.clear();
+
+        /* Offsets of paths are stored in 32 bits, so everything past that can't be a valid table. */
+        const size_t table_end = std::min<size_t>(len, std::numeric_limits<u32>::max());
+
+        /* Every entry takes up at least its header and a NUL terminator, so a count that can't */
+        /* possibly fit is rejected before its storage is allocated.                             */
+        const size_t available = table_end > offset ? table_end - offset : 0;
+        if (count > available / (EntryHeaderSize + 1)) {
+            *this = FileTable{};
+            ec = std::make_error_code(std::errc::illegal_byte_sequence);
+            return;
+        }
+
+        const MutableColumns columns = this->Allocate(archive, count);
+
+        const u8 *cursor = archive + offset;
+        const u8 *end    = archive + table_end;
+
+        u32 i = 0;
+        for (; i < count; ++i) {
+            if (static_cast<size_t>(end - cursor) < EntryHeaderSize) {
+                break;
+            }
+
+            /* Read the fixed-size part of the entry. */
+            columns.offsets[i]            = ReadU32(cursor + 0);
+            columns.uncompressed_sizes[i] = ReadU32(cursor + 4);
+            columns.compressed_sizes[i]   = ReadU32(cursor + 8);
+            columns.compressed[i]         = cursor[12] != 0;
+            columns.checksums[i]          = ReadU32(cursor + 13);
+            const u32 name_len            = ReadU32(cursor + 17);
+            cursor += EntryHeaderSize;
+
+            /* The stored length of the path includes the terminating NUL. */
+            if (name_len == 0 || static_cast<size_t>(end - cursor) < name_len || cursor[name_len - 1] != 0) {
+                break;
+            }
+            columns.path_offsets[i] = static_cast<u32>(cursor - archive);
+            columns.path_lengths[i] = name_len - 1;
+            cursor += name_len;
+
+            /* The contents of the file must be within the archive. */
+            if (columns.offsets[i] + ComputeStoredSize(columns.uncompressed_sizes[i], columns.compressed_sizes[i], columns.compressed[i]) > archive_len) {
+                break;
+            }
+        }
+
+        /* Stopping early means that an entry was malformed. */
+        if (i != count) {
+            *this = FileTable{};
+            ec = std::make_error_code(std::errc::illegal_byte_sequence);
+        }
+    }
+
+    void FileTable::Borrow(u8 *archive, u32 count, const Columns &columns) {
+        m_archive = archive;
+        m_count   = count;
+        m_storage.reset();
+        m_columns = columns;
+    }
+
+    void FileTable::Select(const FileTable &other, std::span<const u32> indices) {
+        const MutableColumns columns = this->Allocate(other.m_archive, static_cast<u32>(indices.size()));
+
+        for (size_t i = 0; i < indices.size(); ++i) {
+            const u32 index = indices[i];
+
+            columns.offsets[i]            = other.m_columns.offsets[index];
+            columns.uncompressed_sizes[i] = other.m_columns.uncompressed_sizes[index];
+            columns.compressed_sizes[i]   = other.m_columns.compressed_sizes[index];
+            columns.checksums[i]          = other.m_columns.checksums[index];
+            columns.path_offsets[i]       = other.m_columns.path_offsets[index];
+            columns.path_lengths[i]       = other.m_columns.path_lengths[index];
+            columns.compressed[i]         = other.m_columns.compressed[index];
+        }
+    }
+
+    bool FileTable::Validate(size_t len) const {
+        /* Accumulate the result instead of branching, so the loop stays tight. */
+        bool valid = true;
+        for (u32 i = 0; i < m_count; ++i) {
+            const u64 content_end = m_columns.offsets[i] + ComputeStoredSize(m_columns.uncompressed_sizes[i], m_columns.compressed_sizes[i], m_columns.compressed[i]);
+            const u64 path_end    = static_cast<u64>(m_columns.path_offsets[i]) + m_columns.path_lengths[i];
+
+            valid &= content_end <= len && path_end < len;
+        }
+        if (!valid) {
+            return false;
+        }
+
+        /* Only look at the path terminators once we know they're in bounds. */
+        for (u32 i = 0; i < m_count; ++i) {
+            valid &= m_archive[m_columns.path_offsets[i] + m_columns.path_lengths[i]] == 0;
+        }
+        return valid;
+    }
+
+}
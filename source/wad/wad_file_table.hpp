@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2022 Valentin B.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <memory>
+#include <span>
+#include <string_view>
+#include <system_error>
+
+#include "ptor_defines.hpp"
+#include "ptor_types.hpp"
+#include "wad/wad_types.hpp"
+
+namespace ptor::wad {
+
+    /* The file table of an archive, stored as one contiguous array per field.    */
+    /* Paths are not copied; they are kept as offsets of the NUL-terminated names */
+    /* in the archive's own file table, which must outlive this object.           */
+    class FileTable final {
+        P_DISALLOW_COPY_AND_ASSIGN(FileTable);
+
+    public:
+        /* The size of an entry in the archive, not counting its path. */
+        static constexpr size_t EntryHeaderSize = 21;
+
+        /* Views of all the columns in the table, `count` elements each. */
+        template <typename U32, typename U8>
+        struct ColumnsImpl {
+            U32 *offsets;            /* Offsets of the file contents in the archive.  */
+            U32 *uncompressed_sizes; /* The uncompressed sizes of the file contents.  */
+            U32 *compressed_sizes;   /* The compressed sizes of the files.            */
+            U32 *checksums;          /* The CRC32 checksums of the file contents.     */
+            U32 *path_offsets;       /* Offsets of the file paths in the archive.     */
+            U32 *path_lengths;       /* Lengths of the file paths, without their NUL. */
+            U8 *compressed;          /* Whether the file contents are compressed.     */
+        };
+
+        using Columns = ColumnsImpl<const u32, const u8>;
+
+        /* Gets the amount of bytes needed to store all columns for `count` files. */
+        static constexpr size_t GetStorageSize(u32 count) {
+            return static_cast<size_t>(count) * (6 * sizeof(u32) + sizeof(u8));
+        }
+
+    private:
+        using MutableColumns = ColumnsImpl<u32, u8>;
+
+    private:
+        u8 *m_archive;
+        u32 m_count;
+        std::unique_ptr<u8[]> m_storage;
+        Columns m_columns;
+
+    public:
+        FileTable();
+
+        FileTable(FileTable &&) = default;
+
+        FileTable &operator=(FileTable &&) = default;
+
+        /* Parses `count` entries of the file table at `offset` in the archive at `archive`. */
+        /* Entries which reach outside of the archive's `len` bytes are reported as errors.  */
+        void Parse(u8 *archive, size_t len, size_t offset, u32 count, std::error_code &ec);
+
+        /* Same as above, but only the file table is held in the `len` bytes at `archive`.  */
+        /* File contents are checked against the full `archive_len` bytes of the archive. */
+        void Parse(u8 *archive, size_t len, size_t offset, u32 count, u64 archive_len, std::error_code &ec);
+
+        /* Uses columns laid out in external memory, such as a mapped cache, without */
+        /* copying them. The memory must outlive this object.                         */
+        void Borrow(u8 *archive, u32 count, const Columns &columns);
+
+        /* Builds a table from the files at `indices` in `other`, in the given order. */
+        void Select(const FileTable &other, std::span<const u32> indices);
+
+        /* Checks that all entries stay within an archive of `len` bytes and that their */
+        /* paths are NUL-terminated. Parsed tables always pass this check.              */
+        bool Validate(size_t len) const;
+
+        P_ALWAYS_INLINE u32 GetCount() const { return m_count; }
+
+        P_ALWAYS_INLINE const Columns &GetColumns() const { return m_columns; }
+
+        P_ALWAYS_INLINE u32 GetOffset(u32 index) const { return m_columns.offsets[index]; }
+
+        P_ALWAYS_INLINE u8 *GetContentPtr(u32 index) const { return m_archive + m_columns.offsets[index]; }
+
+        P_ALWAYS_INLINE u32 GetUncompressedSize(u32 index) const { return m_columns.uncompressed_sizes[index]; }
+
+        P_ALWAYS_INLINE u32 GetChecksum(u32 index) const { return m_columns.checksums[index]; }
+
+        /* Gets the amount of bytes the file contents occupy in the archive. */
+        P_ALWAYS_INLINE u32 GetStoredSize(u32 index) const {
+            return m_columns.compressed[index] != 0 ? m_columns.compressed_sizes[index] : m_columns.uncompressed_sizes[index];
+        }
+
+        P_ALWAYS_INLINE bool IsCompressed(u32 index) const { return m_columns.compressed[index] != 0; }
+
+        /* The path is a view into the archive and is always followed by a NUL. */
+        P_ALWAYS_INLINE std::string_view GetPath(u32 index) const {
+            return {reinterpret_cast<const char *>(m_archive + m_columns.path_offsets[index]), m_columns.path_lengths[index]};
+        }
+
+        /* Gathers the metadata of a single file. */
+        P_ALWAYS_INLINE File GetFile(u32 index) const {
+            return this->GetFile(index, this->GetContentPtr(index));
+        }
+
+        /* Gathers the metadata of a single file whose contents were loaded to `content_ptr`. */
+        P_ALWAYS_INLINE File GetFile(u32 index, u8 *content_ptr) const {
+            return {
+                content_ptr,
+                m_columns.uncompressed_sizes[index],
+                m_columns.compressed_sizes[index],
+                this->IsCompressed(index),
+                m_columns.checksums[index],
+                this->GetPath(index),
+            };
+        }
+
+    private:
+        MutableColumns Allocate(u8 *archive, u32 count);
+    };
+
+}
@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2022 Valentin B.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "wad/wad_manifest.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+
+#include "fmt/format.h"
+
+#include "util/util_scope_guard.hpp"
+
+namespace ptor::wad {
+
+    namespace {
+
+        /* Every line holds one record: "<checksum>\t<size>\t<mtime>\t<path>\n". */
+        constexpr inline char FieldSeparator  = '\t';
+        constexpr inline char RecordSeparator = '\n';
+
+        template <typename T>
+        bool ParseField(std::string_view &line, T &out, int base) {
+            const char *end = line.data() + line.size();
+            const auto result = std::from_chars(line.data(), end, out, base);
+            if (result.ec != std::errc{} || result.ptr == end || *result.ptr != FieldSeparator) {
+                return false;
+            }
+
+            line.remove_prefix(static_cast<size_t>(result.ptr - line.data()) + 1);
+            return true;
+        }
+
+    }
+
+    Manifest::Manifest() = default;
+
+    void Manifest::Load(const fs::path &path, std::error_code &ec) {
+        /* Reset the error code back into a successful state. */
+        ec.clear();
+
+        m_contents.clear();
+        m_records.clear();
+
+        FILE *file = std::fopen(path.string().c_str(), "rb");
+        if (file == nullptr) {
+            return;
+        }
+        P_ON_SCOPE_EXIT { std::fclose(file); };
+
+        /* Read the whole manifest; the records view into it. */
+        char buffer[64 * 1024];
+        size_t read;
+        while ((read = std::fread(buffer, 1, sizeof(buffer), file)) != 0) {
+            m_contents.append(buffer, read);
+        }
+        if (std::ferror(file)) {
+            m_contents.clear();
+            ec = std::make_error_code(std::errc::io_error);
+            return;
+        }
+
+        /* Malformed records are dropped, which just means their files are extracted again. */
+        std::string_view contents{m_contents};
+        while (!contents.empty()) {
+            const size_t line_end = std::min(contents.find(RecordSeparator), contents.size());
+            std::string_view line = contents.substr(0, line_end);
+            contents.remove_prefix(std::min(line_end + 1, contents.size()));
+
+            Record record{};
+            if (ParseField(line, record.checksum, 16) && ParseField(line, record.size, 10) && ParseField(line, record.mtime, 10) && !line.empty()) {
+                m_records.try_emplace(line, record);
+            }
+        }
+    }
+
+    const Manifest::Record *Manifest::Find(std::string_view path) const {
+        if (const auto it = m_records.find(path); it != m_records.end()) {
+            return std::addressof(it->second);
+        }
+        return nullptr;
+    }
+
+    void Manifest::Store(const fs::path &path, std::span<const Entry> entries, std::error_code &ec) {
+        /* Reset the error code back into a successful state. */
+        ec.clear();
+
+        fmt::memory_buffer contents;
+        for (const auto &entry : entries) {
+            fmt::format_to(std::back_inserter(contents), "{:08x}{}{}{}{}{}{}{}", entry.record.checksum, FieldSeparator,
+                           entry.record.size, FieldSeparator, entry.record.mtime, FieldSeparator, entry.path, RecordSeparator);
+        }
+
+        /* Write the new manifest next to the old one and replace it once complete. */
+        fs::path temp_path = path;
+        temp_path += ".tmp";
+
+        FILE *file = std::fopen(temp_path.string().c_str(), "wb");
+        if (file == nullptr) {
+            ec = std::make_error_code(std::errc::io_error);
+            return;
+        }
+
+        bool success = contents.size() == 0 || std::fwrite(contents.data(), 1, contents.size(), file) == contents.size();
+        success &= std::fclose(file) == 0;
+
+        if (success) {
+            fs::rename(temp_path, path, ec);
+        } else {
+            ec = std::make_error_code(std::errc::io_error);
+        }
+
+        if (ec) {
+            std::error_code remove_ec;
+            fs::remove(temp_path, remove_ec);
+        }
+    }
+
+}
@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2022 Valentin B.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <unordered_map>
+
+#include "ptor_defines.hpp"
+#include "ptor_types.hpp"
+
+namespace ptor::wad {
+
+    /* Records which files were extracted into an output directory, together with the state */
+    /* of their contents in the archive and on disk. Later runs compare against it to skip  */
+    /* the files which have neither changed in the archive nor been touched on disk.        */
+    class Manifest final {
+        P_DISALLOW_COPY_AND_ASSIGN(Manifest);
+        P_DISALLOW_MOVE(Manifest);
+
+    public:
+        /* The name of the manifest file within an output directory. */
+        static constexpr const char *FileName = ".printrospector-manifest";
+
+        struct Record {
+            u32 checksum; /* The CRC32 of the file contents in the archive. */
+            u64 size;     /* The size of the extracted file.                */
+            i64 mtime;    /* The modification time of the extracted file.   */
+        };
+
+        struct Entry {
+            std::string_view path;
+            Record record;
+        };
+
+    private:
+        std::string m_contents;
+        std::unordered_map<std::string_view, Record> m_records;
+
+    public:
+        Manifest();
+
+        /* Reads the manifest at `path`. A missing manifest is not an error; it's just empty. */
+        void Load(const fs::path &path, std::error_code &ec);
+
+        /* Looks up the record of a file by its archive-relative path. */
+        const Record *Find(std::string_view path) const;
+
+        /* Replaces the manifest at `path` with the given entries. */
+        static void Store(const fs::path &path, std::span<const Entry> entries, std::error_code &ec);
+    };
+
+}
@@ -0,0 +1,379 @@
+/*
+ * Copyright (c) 2022 Valentin B.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "wad/wad_packer.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <unordered_map>
+
+#include "assert.hpp"
+#include "util/util_crc32.hpp"
+#include "util/util_encoding.hpp"
+#include "util/util_literals.hpp"
+#include "util/util_zlib_deflater.hpp"
+#include "wad/wad_file_table.hpp"
+#include "wad/wad_manifest.hpp"
+#include "wad/wad_types.hpp"
+
+namespace ptor::wad {
+
+    namespace {
+
+        /* The size of the archive header, including the flags of version 2. */
+        constexpr inline size_t HeaderSize = 5 + 2 * sizeof(u32) + sizeof(u8);
+
+        /* Stored files have no compressed size; the game's own archives mark them like this. */
+        constexpr inline u32 StoredSize = std::numeric_limits<u32>::max();
+
+        /* Marks files whose contents are not known to occur earlier in the archive. */
+        constexpr inline u32 NoDuplicate = std::numeric_limits<u32>::max();
+
+        /* Chunk size for comparing contents against files on disk. */
+        constexpr inline size_t CompareChunkSize = 64_KB;
+
+        /* The contents of a file in a batch, and the way they are stored in the archive. */
+        struct PackedFile {
+            std::unique_ptr<u8[]> contents;   /* The uncompressed file contents.                   */
+            std::unique_ptr<u8[]> compressed; /* The compressed contents, if that paid off.         */
+            u32 compressed_size;
+            u32 checksum;
+            u32 candidate; /* An earlier file with the same size and checksum. */
+            u32 duplicate; /* The earlier file these contents are shared with.  */
+        };
+
+        /* Where the contents of a file ended up in the archive. */
+        struct Placement {
+            u32 offset;
+            u32 stored_size;
+            bool compressed;
+        };
+
+        void ReadFile(const fs::path &path, u8 *out, u32 size, std::error_code &ec) {
+            /* Reset the error code back into a successful state. */
+            ec.clear();
+
+            FILE *file = std::fopen(path.string().c_str(), "rb");
+            if (file == nullptr) {
+                ec = std::make_error_code(std::errc::io_error);
+                return;
+            }
+
+            /* The file must still have the size it was listed with. */
+            const bool complete = std::fread(out, 1, size, file) == size && std::fgetc(file) == EOF;
+            std::fclose(file);
+
+            if (!complete) {
+                ec = std::make_error_code(std::errc::io_error);
+            }
+        }
+
+        /* Checks whether the file at `path` holds exactly the `size` bytes at `data`. */
+        bool FileEquals(const fs::path &path, const u8 *data, u32 size) {
+            FILE *file = std::fopen(path.string().c_str(), "rb");
+            if (file == nullptr) {
+                return false;
+            }
+
+            u8 chunk[CompareChunkSize];
+            bool equal = true;
+            for (u32 offset = 0; equal && offset < size;) {
+                const size_t len = std::min<size_t>(size - offset, sizeof(chunk));
+                equal   = std::fread(chunk, 1, len, file) == len && std::memcmp(chunk, data + offset, len) == 0;
+                offset += static_cast<u32>(len);
+            }
+            equal &= std::fgetc(file) == EOF;
+
+            std::fclose(file);
+            return equal;
+        }
+
+        P_ALWAYS_INLINE u64 MakeContentKey(u32 size, u32 checksum) {
+            return (static_cast<u64>(size) << 32) | checksum;
+        }
+
+        P_ALWAYS_INLINE u8 *EncodeU32(u8 *out, u32 value) {
+            util::Encode<u32, std::endian::little>(out, value);
+            return out + sizeof(u32);
+        }
+
+    }
+
+    Packer::Packer() : m_duplicate_count{0}, m_deduplicated_size{0} {}
+
+    void Packer::AddDirectory(const fs::path &root, std::error_code &ec) {
+        /* Reset the error code back into a successful state. */
+        ec.clear();
+
+        fs::recursive_directory_iterator it{root, ec};
+        for (const fs::recursive_directory_iterator end; !ec && it != end; it.increment(ec)) {
+            const auto &entry = *it;
+            if (!entry.is_regular_file(ec)) {
+                if (ec) {
+                    return;
+                }
+                continue;
+            }
+
+            /* Don't archive the bookkeeping of previous extractions into the directory. */
+            std::string path = entry.path().lexically_relative(root).generic_string();
+            if (path == Manifest::FileName) {
+                continue;
+            }
+
+            const u64 size = entry.file_size(ec);
+            if (ec) {
+                return;
+            }
+            if (size > std::numeric_limits<u32>::max()) {
+                ec = std::make_error_code(std::errc::file_too_large);
+                return;
+            }
+
+            m_entries.push_back({std::move(path), entry.path(), static_cast<u32>(size)});
+        }
+        if (ec) {
+            return;
+        }
+
+        /* Directory iteration order is unspecified, but the archive layout shouldn't be. */
+        std::sort(m_entries.begin(), m_entries.end(), [](const Entry &lhs, const Entry &rhs) {
+            return lhs.path < rhs.path;
+        });
+    }
+
+    u64 Packer::GetTotalSize() const {
+        u64 total = 0;
+        for (const auto &entry : m_entries) {
+            total += entry.size;
+        }
+        return total;
+    }
+
+    void Packer::Write(const fs::path &path, util::ThreadPool &pool, u32 level, const ProgressCallbackType &progress, std::error_code &ec) {
+        /* Reset the error code back into a successful state. */
+        ec.clear();
+
+        const u32 count   = this->GetFileCount();
+        const u32 workers = pool.GetWorkerCount();
+
+        /* Try to allocate one zlib deflater for every worker. */
+        std::vector<util::Deflater> deflaters;
+        deflaters.reserve(workers);
+        for (u32 i = 0; i < workers; ++i) {
+            if (deflaters.push_back(util::Deflater::Allocate(level, ec)); ec) {
+                return;
+            }
+        }
+
+        /* The header and the file table come first; their size is known up front. */
+        size_t table_size = HeaderSize;
+        for (const auto &entry : m_entries) {
+            table_size += FileTable::EntryHeaderSize + entry.path.size() + 1;
+        }
+        if (table_size > std::numeric_limits<u32>::max()) {
+            ec = std::make_error_code(std::errc::file_too_large);
+            return;
+        }
+
+        std::vector<u8> table(table_size);
+        std::memcpy(table.data(), ArchiveMagic, 5);
+        u8 *cursor = EncodeU32(table.data() + 5, ArchiveVersion);
+        cursor     = EncodeU32(cursor, count);
+        *cursor++  = ArchiveFlag_MemoryMapped;
+
+        /* Build the archive next to its destination and replace that once complete. */
+        fs::path temp_path = path;
+        temp_path += ".tmp";
+
+        FILE *file = std::fopen(temp_path.string().c_str(), "wb");
+        if (file == nullptr) {
+            ec = std::make_error_code(std::errc::io_error);
+            return;
+        }
+
+        /* Leave room for the file table, which is filled in as the contents are written. */
+        bool success = std::fseek(file, static_cast<long>(table_size), SEEK_SET) == 0;
+
+        /* The first error that occurred in any of the workers. */
+        std::mutex error_mutex;
+        std::error_code first_error;
+
+        /* Files with the same contents share them in the archive; the first one is stored. */
+        std::unordered_map<u64, u32> contents;
+        std::vector<Placement> placements(count);
+        m_duplicate_count   = 0;
+        m_deduplicated_size = 0;
+
+        std::vector<PackedFile> packed;
+        std::vector<u32> order;
+        u64 offset = table_size;
+        for (u32 first = 0; success && !ec && first < count;) {
+            /* Gather the next batch of files; every batch holds at least one. */
+            u32 last       = first;
+            u64 batch_size = 0;
+            do {
+                batch_size += m_entries[last++].size;
+            } while (last < count && batch_size + m_entries[last].size <= MaxBatchSize);
+
+            /* Hand out the largest files first, so they don't hold up the end of the batch. */
+            order.resize(last - first);
+            std::iota(order.begin(), order.end(), first);
+            std::stable_sort(order.begin(), order.end(), [this](u32 lhs, u32 rhs) {
+                return m_entries[lhs].size > m_entries[rhs].size;
+            });
+            packed.clear();
+            packed.resize(last - first);
+
+            auto record_error = [&](const std::error_code &worker_ec) {
+                std::scoped_lock lk{error_mutex};
+                if (!first_error) {
+                    first_error = worker_ec;
+                }
+            };
+
+            /* Read all the files in the batch and compute their checksums. */
+            const auto load = util::ThreadPool::CallbackType::Make([&](u32, u32 item) {
+                const u32 index   = order[item];
+                const auto &entry = m_entries[index];
+                auto &result      = packed[index - first];
+
+                std::error_code worker_ec;
+                result.contents = std::make_unique_for_overwrite<u8[]>(std::max<u32>(entry.size, 1));
+                if (ReadFile(entry.source, result.contents.get(), entry.size, worker_ec); worker_ec) {
+                    record_error(worker_ec);
+                    return false;
+                }
+                result.checksum = util::Crc32(result.contents.get(), entry.size);
+
+                return true;
+            });
+
+            if (!pool.Run(last - first, load)) {
+                ec = first_error;
+                break;
+            }
+
+            /* Look for earlier files with the same size and checksum, in archive order. */
+            for (u32 index = first; index < last; ++index) {
+                auto &result = packed[index - first];
+                const auto [it, inserted] = contents.try_emplace(MakeContentKey(m_entries[index].size, result.checksum), index);
+
+                result.candidate = inserted ? NoDuplicate : it->second;
+                result.duplicate = NoDuplicate;
+            }
+
+            /* Confirm the duplicates byte by byte and compress everything else. The contents */
+            /* of candidates are never replaced, so they can be compared against concurrently. */
+            const auto compress = util::ThreadPool::CallbackType::Make([&](u32 worker, u32 item) {
+                const u32 index = order[item];
+                const u32 size  = m_entries[index].size;
+                auto &result    = packed[index - first];
+
+                if (result.candidate != NoDuplicate) {
+                    const bool equal = result.candidate >= first ? std::memcmp(packed[result.candidate - first].contents.get(), result.contents.get(), size) == 0
+                                                                 : FileEquals(m_entries[result.candidate].source, result.contents.get(), size);
+                    if (equal) {
+                        result.duplicate = result.candidate;
+                        return true;
+                    }
+                }
+
+                /* Compression only pays off when it saves at least a byte over storing the file. */
+                if (size > 1) {
+                    result.compressed      = std::make_unique_for_overwrite<u8[]>(size - 1);
+                    result.compressed_size = static_cast<u32>(deflaters[worker].CompressInto(result.contents.get(), size, result.compressed.get(), size - 1));
+                    if (result.compressed_size == 0) {
+                        result.compressed.reset();
+                    }
+                }
+
+                return true;
+            });
+
+            pool.Run(last - first, compress);
+
+            /* Write the batch in order and record where every file ended up. */
+            const u64 batch_start = offset;
+            for (u32 index = first; index < last; ++index) {
+                const auto &entry = m_entries[index];
+                auto &result      = packed[index - first];
+                auto &placement   = placements[index];
+
+                if (result.duplicate != NoDuplicate) {
+                    placement = placements[result.duplicate];
+
+                    m_duplicate_count   += 1;
+                    m_deduplicated_size += placement.stored_size;
+                } else {
+                    placement.offset      = static_cast<u32>(offset);
+                    placement.compressed  = result.compressed != nullptr;
+                    placement.stored_size = placement.compressed ? result.compressed_size : entry.size;
+
+                    if (offset + placement.stored_size > std::numeric_limits<u32>::max()) {
+                        ec = std::make_error_code(std::errc::file_too_large);
+                        break;
+                    }
+
+                    const u8 *data = placement.compressed ? result.compressed.get() : result.contents.get();
+                    if (placement.stored_size != 0 && std::fwrite(data, 1, placement.stored_size, file) != placement.stored_size) {
+                        success = false;
+                        break;
+                    }
+                    offset += placement.stored_size;
+                }
+
+                cursor    = EncodeU32(cursor, placement.offset);
+                cursor    = EncodeU32(cursor, entry.size);
+                cursor    = EncodeU32(cursor, placement.compressed ? placement.stored_size : StoredSize);
+                *cursor++ = placement.compressed ? 1 : 0;
+                cursor    = EncodeU32(cursor, result.checksum);
+                cursor    = EncodeU32(cursor, static_cast<u32>(entry.path.size() + 1));
+                std::memcpy(cursor, entry.path.data(), entry.path.size() + 1);
+                cursor   += entry.path.size() + 1;
+            }
+
+            if (success && !ec) {
+                progress(last - first, batch_size, offset - batch_start);
+            }
+            first = last;
+        }
+
+        /* Complete the archive with its file table. */
+        if (success && !ec) {
+            P_ASSERT(cursor == table.data() + table.size());
+            success = std::fseek(file, 0, SEEK_SET) == 0 && std::fwrite(table.data(), 1, table.size(), file) == table.size();
+        }
+        success &= std::fclose(file) == 0;
+
+        if (!success && !ec) {
+            ec = std::make_error_code(std::errc::io_error);
+        }
+        if (!ec) {
+            fs::rename(temp_path, path, ec);
+        }
+
+        if (ec) {
+            std::error_code remove_ec;
+            fs::remove(temp_path, remove_ec);
+        }
+    }
+
+}
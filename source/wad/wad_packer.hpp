@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2022 Valentin B.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "ptor_defines.hpp"
+#include "ptor_types.hpp"
+#include "util/util_i_function.hpp"
+#include "util/util_literals.hpp"
+#include "util/util_thread_pool.hpp"
+
+namespace ptor::wad {
+
+    /* Builds a KIWAD archive from the files of a directory tree.                    */
+    /* Files are compressed in parallel, but always laid out in the order of their   */
+    /* paths, so the resulting archive is identical no matter how many workers run.  */
+    /* Files with identical contents share a single copy of them in the archive.     */
+    class Packer final {
+        P_DISALLOW_COPY_AND_ASSIGN(Packer);
+        P_DISALLOW_MOVE(Packer);
+
+    public:
+        /* The version of the archive format we produce. */
+        static constexpr u32 ArchiveVersion = 2;
+
+        /* Files are compressed in batches of about this many input bytes at once, */
+        /* which bounds the memory needed for holding results until they're written. */
+        static constexpr u64 MaxBatchSize = 64_MB;
+
+        /* Invoked as `fn(files, bytes_read, bytes_written)` with the work done since the last call. */
+        using ProgressCallbackType = util::IFunction<void(u32, u64, u64)>;
+
+    private:
+        struct Entry {
+            std::string path; /* The archive-relative path of the file.   */
+            fs::path source;  /* The path of the file on disk.            */
+            u32 size;         /* The size of the file when it was listed. */
+        };
+
+    private:
+        std::vector<Entry> m_entries;
+        u32 m_duplicate_count;
+        u64 m_deduplicated_size;
+
+    public:
+        Packer();
+
+        /* Adds all the regular files below `root` to the archive, named by their paths */
+        /* relative to it. Manifests left behind by incremental extraction are skipped. */
+        void AddDirectory(const fs::path &root, std::error_code &ec);
+
+        P_ALWAYS_INLINE u32 GetFileCount() const { return static_cast<u32>(m_entries.size()); }
+
+        /* Gets the combined size of all added files. */
+        u64 GetTotalSize() const;
+
+        /* Gets the amount of files which were written as references to earlier contents. */
+        P_ALWAYS_INLINE u32 GetDuplicateCount() const { return m_duplicate_count; }
+
+        /* Gets the amount of archive bytes saved by sharing contents between files. */
+        P_ALWAYS_INLINE u64 GetDeduplicatedSize() const { return m_deduplicated_size; }
+
+        /* Compresses all added files at the given `level` on the workers of `pool` and */
+        /* writes the archive to `path`. Files which don't get any smaller are stored.  */
+        /* Duplicates are found by size and CRC32, and confirmed by their contents.     */
+        /* The archive is built in a temporary file which replaces `path` on success.   */
+        void Write(const fs::path &path, util::ThreadPool &pool, u32 level, const ProgressCallbackType &progress, std::error_code &ec);
+    };
+
+}
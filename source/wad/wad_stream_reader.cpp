@@ -0,0 +1,294 @@
+/*
+ * Copyright (c) 2022 Valentin B.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "wad/wad_stream_reader.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <limits>
+#include <numeric>
+
+#include "util/util_encoding.hpp"
+#include "wad/wad_types.hpp"
+
+namespace ptor::wad {
+
+    namespace {
+
+        /* The magic, the version and the file count; version 2 adds a byte of flags. */
+        constexpr inline size_t BaseHeaderSize = 5 + 2 * sizeof(u32);
+
+        /* Paths are far shorter than this; anything longer means we're not reading an archive. */
+        constexpr inline u32 MaxPathLength = 64_KB;
+
+        /* Contents between the windows are read in chunks of this size and dropped. */
+        constexpr inline size_t DiscardChunkSize = 64_KB;
+
+        P_ALWAYS_INLINE u32 ReadU32(const u8 *ptr) {
+            return util::Decode<u32, std::endian::little>(ptr);
+        }
+
+    }
+
+    StreamReader::StreamReader(FILE *source)
+        : m_source{source}, m_position{0}, m_next_window{0}, m_next_spill_range{0},
+          m_buffer_offset{0}, m_buffer_length{0}, m_spill{nullptr} {}
+
+    StreamReader::~StreamReader() {
+        /* The spill file is only scratch space; the mapping must be gone before it can be removed. */
+        m_spill_mapped.reset();
+        if (m_spill != nullptr) {
+            std::fclose(m_spill);
+
+            std::error_code ec;
+            fs::remove(m_spill_path, ec);
+        }
+    }
+
+    void StreamReader::ReadTable(std::error_code &ec) {
+        /* Reset the error code back into a successful state. */
+        ec.clear();
+
+        /* Read and validate the header. */
+        m_table.resize(BaseHeaderSize);
+        if (this->ReadExact(m_table.data(), BaseHeaderSize, ec); ec) {
+            return;
+        }
+        if (std::memcmp(m_table.data(), ArchiveMagic, 5) != 0) {
+            ec = std::make_error_code(std::errc::illegal_byte_sequence);
+            return;
+        }
+
+        const u32 version    = ReadU32(m_table.data() + 5);
+        const u32 file_count = ReadU32(m_table.data() + 9);
+        if (version >= 2) {
+            m_table.resize(BaseHeaderSize + 1);
+            if (this->ReadExact(m_table.data() + BaseHeaderSize, 1, ec); ec) {
+                return;
+            }
+        }
+
+        /* Read the file table entry by entry; only the entries themselves tell how long it is. */
+        for (u32 i = 0; i < file_count; ++i) {
+            const size_t entry = m_table.size();
+            m_table.resize(entry + FileTable::EntryHeaderSize);
+            if (this->ReadExact(m_table.data() + entry, FileTable::EntryHeaderSize, ec); ec) {
+                return;
+            }
+
+            const u32 name_len = ReadU32(m_table.data() + entry + FileTable::EntryHeaderSize - sizeof(u32));
+            if (name_len > MaxPathLength || m_table.size() + name_len > std::numeric_limits<u32>::max()) {
+                ec = std::make_error_code(std::errc::illegal_byte_sequence);
+                return;
+            }
+
+            m_table.resize(entry + FileTable::EntryHeaderSize + name_len);
+            if (this->ReadExact(m_table.data() + entry + FileTable::EntryHeaderSize, name_len, ec); ec) {
+                return;
+            }
+        }
+
+        m_buffer_offset = m_position;
+    }
+
+    void StreamReader::Plan(const FileTable &files, size_t window_size, const fs::path &spill_path, std::error_code &ec) {
+        /* Reset the error code back into a successful state. */
+        ec.clear();
+
+        P_ASSERT(m_windows.empty() && m_spill == nullptr, "stream reader was already planned");
+
+        /* Visit the files in the order their contents appear in the archive. Empty files */
+        /* have no contents to wait for, so they are all handled with the first window.   */
+        std::vector<u32> order(files.GetCount());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&files](u32 lhs, u32 rhs) {
+            const u64 lhs_offset = files.GetStoredSize(lhs) != 0 ? files.GetOffset(lhs) : 0;
+            const u64 rhs_offset = files.GetStoredSize(rhs) != 0 ? files.GetOffset(rhs) : 0;
+            return lhs_offset < rhs_offset;
+        });
+
+        size_t max_window = 0;
+        m_order.reserve(order.size());
+        for (const u32 index : order) {
+            const u64 size  = files.GetStoredSize(index);
+            const u64 start = size != 0 ? files.GetOffset(index) : m_position;
+            const u64 end   = start + size;
+
+            /* The file table was consumed before we knew what it contains. */
+            if (start < m_position) {
+                ec = std::make_error_code(std::errc::illegal_byte_sequence);
+                return;
+            }
+
+            /* Files which would not fit into a window are copied to the spill file. */
+            if (size > window_size) {
+                m_spilled.push_back(index);
+                if (!m_spill_ranges.empty() && m_spill_ranges.back().end >= start) {
+                    m_spill_ranges.back().end = std::max(m_spill_ranges.back().end, end);
+                } else {
+                    m_spill_ranges.push_back({start, end, 0});
+                }
+                continue;
+            }
+
+            /* Extend the current window as long as it stays within its size limit. */
+            if (m_windows.empty() || end - m_windows.back().start > window_size) {
+                m_windows.push_back({start, end, static_cast<u32>(m_order.size()), 0});
+            }
+            auto &window = m_windows.back();
+            window.end    = std::max(window.end, end);
+            window.count += 1;
+            max_window    = std::max<size_t>(max_window, window.end - window.start);
+
+            m_order.push_back(index);
+        }
+
+        /* Spilled contents are stored back to back. */
+        u64 spill_offset = 0;
+        for (auto &range : m_spill_ranges) {
+            range.spill_offset = spill_offset;
+            spill_offset += range.end - range.start;
+        }
+
+        m_buffer = std::make_unique_for_overwrite<u8[]>(max_window);
+
+        if (!m_spill_ranges.empty()) {
+            if (m_spill = std::fopen(spill_path.string().c_str(), "w+b"); m_spill == nullptr) {
+                ec = std::make_error_code(std::errc::io_error);
+                return;
+            }
+            m_spill_path = spill_path;
+        }
+    }
+
+    bool StreamReader::NextWindow(Window &window, std::error_code &ec) {
+        /* Reset the error code back into a successful state. */
+        ec.clear();
+
+        /* Once all windows are through, stream in what's left of the spilled contents and map them. */
+        if (m_next_window == m_windows.size()) {
+            if (m_spill != nullptr && !m_spill_mapped.has_value()) {
+                if (this->ReadUntil(m_spill_ranges.back().end, nullptr, ec); ec) {
+                    return false;
+                }
+                if (std::fflush(m_spill) != 0) {
+                    ec = std::make_error_code(std::errc::io_error);
+                    return false;
+                }
+
+                auto mapped = io::ReadOnlyMapped::Map(m_spill, ec);
+                if (ec) {
+                    return false;
+                }
+                m_spill_mapped.emplace(std::move(mapped));
+            }
+            return false;
+        }
+
+        const auto &range = m_windows[m_next_window++];
+
+        /* Windows are ordered by their start, so any overlap with the previous one is at the end of */
+        /* the buffer. Keep that part around; everything before the window is no longer needed.      */
+        if (range.start < m_position) {
+            const size_t keep = static_cast<size_t>(m_position - range.start);
+            std::memmove(m_buffer.get(), m_buffer.get() + (range.start - m_buffer_offset), keep);
+            m_buffer_length = keep;
+        } else {
+            if (this->ReadUntil(range.start, nullptr, ec); ec) {
+                return false;
+            }
+            m_buffer_length = 0;
+        }
+        m_buffer_offset = range.start;
+
+        /* Read the rest of the window. */
+        if (range.end > m_position) {
+            if (this->ReadUntil(range.end, m_buffer.get() + m_buffer_length, ec); ec) {
+                return false;
+            }
+            m_buffer_length = static_cast<size_t>(range.end - range.start);
+        }
+
+        window = {range.start, m_buffer.get(), {m_order.data() + range.first, range.count}};
+        return true;
+    }
+
+    u8 *StreamReader::GetSpilledContentPtr(u32 offset_in_archive) {
+        /* Find the last range starting at or before the offset; it's the one holding the file. */
+        const auto it = std::upper_bound(m_spill_ranges.begin(), m_spill_ranges.end(), offset_in_archive, [](u64 offset, const SpillRange &range) {
+            return offset < range.start;
+        });
+        P_DEBUG_ASSERT(it != m_spill_ranges.begin());
+
+        const auto &range = *(it - 1);
+        return m_spill_mapped->GetPtr() + range.spill_offset + (offset_in_archive - range.start);
+    }
+
+    void StreamReader::ReadExact(u8 *out, size_t len, std::error_code &ec) {
+        if (std::fread(out, 1, len, m_source) != len) {
+            /* Running out of data means that the archive was cut short. */
+            ec = std::ferror(m_source) ? std::make_error_code(std::errc::io_error) : std::make_error_code(std::errc::illegal_byte_sequence);
+            return;
+        }
+
+        /* Everything passes by here exactly once, so that's where the spill file is fed. */
+        this->Spill(out, len, ec);
+        m_position += len;
+    }
+
+    void StreamReader::ReadUntil(u64 position, u8 *out, std::error_code &ec) {
+        if (out != nullptr) {
+            return this->ReadExact(out, static_cast<size_t>(position - m_position), ec);
+        }
+
+        /* Drop the contents nobody asked for; unless they're spilled, they are never looked at again. */
+        u8 scratch[DiscardChunkSize];
+        while (m_position < position && !ec) {
+            this->ReadExact(scratch, static_cast<size_t>(std::min<u64>(position - m_position, DiscardChunkSize)), ec);
+        }
+    }
+
+    void StreamReader::Spill(const u8 *data, size_t len, std::error_code &ec) {
+        const u64 start = m_position;
+        const u64 end   = m_position + len;
+
+        /* Copy the parts of the spill ranges within the data, in order, to the spill file. */
+        while (m_next_spill_range < m_spill_ranges.size()) {
+            const auto &range = m_spill_ranges[m_next_spill_range];
+            if (range.start >= end) {
+                break;
+            }
+
+            const u64 copy_start = std::max(range.start, start);
+            const u64 copy_end   = std::min(range.end, end);
+            if (copy_start < copy_end) {
+                const size_t copy_len = static_cast<size_t>(copy_end - copy_start);
+                if (std::fwrite(data + (copy_start - start), 1, copy_len, m_spill) != copy_len) {
+                    ec = std::make_error_code(std::errc::io_error);
+                    return;
+                }
+            }
+
+            /* The range continues in the next read. */
+            if (range.end > end) {
+                break;
+            }
+            ++m_next_spill_range;
+        }
+    }
+
+}
@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2022 Valentin B.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstdio>
+#include <memory>
+#include <optional>
+#include <span>
+#include <system_error>
+#include <vector>
+
+#include "io/io_memory_mapped.hpp"
+#include "ptor_defines.hpp"
+#include "ptor_types.hpp"
+#include "util/util_literals.hpp"
+#include "wad/wad_file_table.hpp"
+
+namespace ptor::wad {
+
+    /* Reads a KIWAD archive front to back from a source which can neither seek nor be mapped, */
+    /* such as a pipe. The header and the file table are read up front; the file contents are  */
+    /* then consumed in the order they appear in the archive, one bounded window at a time.    */
+    /* Files too large for a window are copied into a spill file while they stream past, and  */
+    /* become available from there once the whole archive was consumed.                       */
+    class StreamReader final {
+        P_DISALLOW_COPY_AND_ASSIGN(StreamReader);
+        P_DISALLOW_MOVE(StreamReader);
+
+    public:
+        /* The default limit for the amount of archive contents held in memory. */
+        static constexpr size_t DefaultWindowSize = 64_MB;
+
+        /* A range of the archive held in memory, along with the files completely inside of it. */
+        struct Window {
+            u64 offset;                 /* The offset of the range in the archive.         */
+            u8 *data;                   /* The contents of the range.                      */
+            std::span<const u32> files; /* Indices of the files in the planned file table. */
+
+            /* Empty files may claim any offset; they never access their contents. */
+            P_ALWAYS_INLINE u8 *GetContentPtr(u32 offset_in_archive) const {
+                return offset_in_archive >= this->offset ? data + (offset_in_archive - this->offset) : data;
+            }
+        };
+
+    private:
+        /* A planned window; `first` and `count` select from the planned order of files. */
+        struct WindowRange {
+            u64 start;
+            u64 end;
+            u32 first;
+            u32 count;
+        };
+
+        /* A range of the archive which is copied to the spill file, at `spill_offset`. */
+        struct SpillRange {
+            u64 start;
+            u64 end;
+            u64 spill_offset;
+        };
+
+    private:
+        FILE *m_source;
+        u64 m_position;
+        std::vector<u8> m_table;
+
+        /* The plan for consuming the archive. */
+        std::vector<u32> m_order;
+        std::vector<WindowRange> m_windows;
+        std::vector<u32> m_spilled;
+        std::vector<SpillRange> m_spill_ranges;
+        size_t m_next_window;
+        size_t m_next_spill_range;
+
+        /* The archive contents currently held in memory. */
+        std::unique_ptr<u8[]> m_buffer;
+        u64 m_buffer_offset;
+        size_t m_buffer_length;
+
+        /* The spill file, and its mapping once all of it was written. */
+        fs::path m_spill_path;
+        FILE *m_spill;
+        std::optional<io::ReadOnlyMapped> m_spill_mapped;
+
+    public:
+        /* Reads from `source`, which must be positioned at the start of the archive. */
+        explicit StreamReader(FILE *source);
+
+        ~StreamReader();
+
+        /* Reads the header and the file table of the archive. These are kept in memory and can */
+        /* be loaded with `Archive::Load()`; files then have to be accessed through this reader. */
+        void ReadTable(std::error_code &ec);
+
+        P_ALWAYS_INLINE u8 *GetTableData() { return m_table.data(); }
+
+        P_ALWAYS_INLINE size_t GetTableSize() const { return m_table.size(); }
+
+        /* Plans the windows for consuming the contents of all `files`, each holding no more than */
+        /* `window_size` bytes. Larger files are copied to a new file at `spill_path` instead.    */
+        void Plan(const FileTable &files, size_t window_size, const fs::path &spill_path, std::error_code &ec);
+
+        /* Reads the contents of the next window from the source. When all windows were consumed, */
+        /* finishes the spill file and returns false.                                            */
+        bool NextWindow(Window &window, std::error_code &ec);
+
+        /* Gets the files which were copied to the spill file; they are available once `NextWindow()` */
+        /* returned false.                                                                            */
+        P_ALWAYS_INLINE std::span<const u32> GetSpilledFiles() const { return m_spilled; }
+
+        /* Gets the spill file and its mapping; only valid when there are spilled files. */
+        P_ALWAYS_INLINE FILE *GetSpillFile() const { return m_spill; }
+
+        P_ALWAYS_INLINE io::ReadOnlyMapped &GetSpillMapping() { return *m_spill_mapped; }
+
+        /* Gets a pointer to the contents of a spilled file in the spill mapping. */
+        u8 *GetSpilledContentPtr(u32 offset_in_archive);
+
+    private:
+        void ReadExact(u8 *out, size_t len, std::error_code &ec);
+
+        void ReadUntil(u64 position, u8 *out, std::error_code &ec);
+
+        void Spill(const u8 *data, size_t len, std::error_code &ec);
+    };
+
+}
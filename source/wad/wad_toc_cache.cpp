@@ -0,0 +1,249 @@
+/*
+ * Copyright (c) 2022 Valentin B.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "wad/wad_toc_cache.hpp"
+
+#include <bit>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "fmt/format.h"
+
+#include "io/io_binary_buffer.hpp"
+#include "util/util_alignment.hpp"
+#include "util/util_scope_guard.hpp"
+#include "wad/wad_api.hpp"
+#include "wad/wad_archive.hpp"
+
+namespace ptor::wad {
+
+    /* The cache is a local artifact in host byte order; a foreign one fails the version check. */
+    /* The header is followed by the columns of the file table in the order they're declared,    */
+    /* padded to four bytes, and the buckets of the path index.                                  */
+    struct TocCache::CacheHeader {
+        char magic[8];
+        u32 format_version;
+        u32 file_count;
+        u32 archive_version;
+        u32 archive_flags;
+        u64 archive_size;
+        i64 archive_mtime;
+        u32 bucket_count;
+        u32 reserved;
+    };
+    static_assert(sizeof(TocCache::CacheHeader) == 48);
+
+    namespace {
+
+        constexpr inline char CacheMagic[8] = "PTORTOC";
+
+        /* Bump this whenever the layout of the cache changes. */
+        constexpr inline u32 CacheFormatVersion = 2;
+
+        P_ALWAYS_INLINE u64 HashPath(std::string_view path) {
+            /* FNV-1a; paths are short and this keeps the layout independent of the standard library. */
+            u64 hash = 0xCBF29CE484222325;
+            for (const char c : path) {
+                hash = (hash ^ static_cast<u8>(c)) * 0x100000001B3;
+            }
+            return hash;
+        }
+
+        P_ALWAYS_INLINE u32 GetBucketCount(u32 file_count) {
+            /* Keep the load factor at or below one half, which also leaves at least one empty bucket. */
+            return std::bit_ceil(static_cast<u32>(file_count * 2 + 1));
+        }
+
+        P_ALWAYS_INLINE size_t GetColumnsSize(u32 file_count) {
+            return util::AlignUp(FileTable::GetStorageSize(file_count), alignof(u32));
+        }
+
+        bool WriteColumn(FILE *file, const void *data, size_t size) {
+            return size == 0 || std::fwrite(data, 1, size, file) == size;
+        }
+
+    }
+
+    TocCache::TocCache() : m_header{nullptr}, m_columns{}, m_buckets{nullptr} {}
+
+    TocCache::Key TocCache::MakeKey(const fs::path &path, u8 *data, size_t len, std::error_code &ec) {
+        /* Reset the error code back into a successful state. */
+        ec.clear();
+
+        io::BinaryBuffer buffer{data, len};
+        const Header header = ReadHeader(buffer, ec);
+        if (ec) {
+            return {};
+        }
+
+        const auto mtime = fs::last_write_time(path, ec);
+        return {static_cast<u64>(len), static_cast<i64>(mtime.time_since_epoch().count()), header};
+    }
+
+    fs::path TocCache::GetCachePath(const fs::path &dir, const fs::path &path, std::error_code &ec) {
+        /* Name caches after the absolute path of their archive, so different spellings share one. */
+        const fs::path canonical = fs::canonical(path, ec);
+        if (ec) {
+            return {};
+        }
+
+        return dir / fmt::format("{:016x}.toc", HashPath(canonical.generic_string()));
+    }
+
+    void TocCache::Store(const fs::path &path, const Key &key, const Archive &archive, std::error_code &ec) {
+        /* Reset the error code back into a successful state. */
+        ec.clear();
+
+        const FileTable &files = archive.GetFiles();
+        const u32 file_count   = files.GetCount();
+        const u32 bucket_count = GetBucketCount(file_count);
+
+        /* Build the path index with linear probing; the first file with a path takes it. */
+        std::vector<u32> buckets(bucket_count);
+        for (u32 i = 0; i < file_count; ++i) {
+            const std::string_view file_path = files.GetPath(i);
+            for (u32 bucket = HashPath(file_path) & (bucket_count - 1); ; bucket = (bucket + 1) & (bucket_count - 1)) {
+                if (buckets[bucket] == 0) {
+                    buckets[bucket] = i + 1;
+                    break;
+                }
+                if (files.GetPath(buckets[bucket] - 1) == file_path) {
+                    break;
+                }
+            }
+        }
+
+        CacheHeader header{};
+        std::memcpy(header.magic, CacheMagic, sizeof(header.magic));
+        header.format_version  = CacheFormatVersion;
+        header.file_count      = file_count;
+        header.archive_version = key.header.version;
+        header.archive_flags   = key.header.archive_flags;
+        header.archive_size    = key.archive_size;
+        header.archive_mtime   = key.archive_mtime;
+        header.bucket_count    = bucket_count;
+
+        /* Write everything to a temporary file first and move it into place when complete. */
+        const fs::path temp_path = fs::path{path}.concat(fmt::format(".{:x}.tmp", std::chrono::steady_clock::now().time_since_epoch().count()));
+        FILE *file = std::fopen(temp_path.string().c_str(), "wb");
+        if (file == nullptr) {
+            ec = std::make_error_code(std::errc::io_error);
+            return;
+        }
+
+        const auto &columns       = files.GetColumns();
+        const size_t column_size  = static_cast<size_t>(file_count) * sizeof(u32);
+        const size_t padding_size = GetColumnsSize(file_count) - FileTable::GetStorageSize(file_count);
+        constexpr u8 Padding[alignof(u32)] = {};
+
+        bool success = std::fwrite(std::addressof(header), sizeof(header), 1, file) == 1;
+        success &= WriteColumn(file, columns.offsets, column_size);
+        success &= WriteColumn(file, columns.uncompressed_sizes, column_size);
+        success &= WriteColumn(file, columns.compressed_sizes, column_size);
+        success &= WriteColumn(file, columns.checksums, column_size);
+        success &= WriteColumn(file, columns.path_offsets, column_size);
+        success &= WriteColumn(file, columns.path_lengths, column_size);
+        success &= WriteColumn(file, columns.compressed, file_count);
+        success &= WriteColumn(file, Padding, padding_size);
+        success &= WriteColumn(file, buckets.data(), buckets.size() * sizeof(u32));
+        success &= std::fclose(file) == 0;
+
+        if (success) {
+            fs::rename(temp_path, path, ec);
+        } else {
+            ec = std::make_error_code(std::errc::io_error);
+        }
+
+        if (ec) {
+            std::error_code remove_ec;
+            fs::remove(temp_path, remove_ec);
+        }
+    }
+
+    bool TocCache::Open(const fs::path &path, const Key &key) {
+        P_ASSERT(!this->IsOpen(), "cache was already opened");
+
+        FILE *file = std::fopen(path.string().c_str(), "rb");
+        if (file == nullptr) {
+            return false;
+        }
+        P_ON_SCOPE_EXIT { std::fclose(file); };
+
+        std::error_code ec;
+        auto mapped = io::ReadOnlyMapped::Map(file, {.advice = io::Advice::WillNeed}, ec);
+        if (ec || mapped.GetLength() < sizeof(CacheHeader)) {
+            return false;
+        }
+
+        /* Check that the cache is intact and still describes the current state of the archive. */
+        const auto *header = reinterpret_cast<const CacheHeader *>(mapped.GetPtr());
+        if (std::memcmp(header->magic, CacheMagic, sizeof(header->magic)) != 0 || header->format_version != CacheFormatVersion) {
+            return false;
+        }
+        if (header->archive_size != key.archive_size || header->archive_mtime != key.archive_mtime) {
+            return false;
+        }
+        if (header->archive_version != key.header.version || header->file_count != key.header.file_count || header->archive_flags != key.header.archive_flags) {
+            return false;
+        }
+
+        const u32 count = header->file_count;
+        const u64 expected_len = sizeof(CacheHeader) + GetColumnsSize(count) + static_cast<u64>(header->bucket_count) * sizeof(u32);
+        if (header->bucket_count != GetBucketCount(count) || mapped.GetLength() != expected_len) {
+            return false;
+        }
+
+        /* The mapping stays where it is when moved, so the views remain valid. */
+        const u8 *base = m_mapped.emplace(std::move(mapped)).GetPtr();
+        const u32 *columns = reinterpret_cast<const u32 *>(base + sizeof(CacheHeader));
+
+        m_header  = reinterpret_cast<const CacheHeader *>(base);
+        m_columns = {
+            columns + 0 * static_cast<size_t>(count),
+            columns + 1 * static_cast<size_t>(count),
+            columns + 2 * static_cast<size_t>(count),
+            columns + 3 * static_cast<size_t>(count),
+            columns + 4 * static_cast<size_t>(count),
+            columns + 5 * static_cast<size_t>(count),
+            reinterpret_cast<const u8 *>(columns + 6 * static_cast<size_t>(count)),
+        };
+        m_buckets = reinterpret_cast<const u32 *>(base + sizeof(CacheHeader) + GetColumnsSize(count));
+        return true;
+    }
+
+    Header TocCache::GetHeader() const {
+        return {m_header->archive_version, m_header->file_count, static_cast<ArchiveFlags>(m_header->archive_flags)};
+    }
+
+    std::optional<u32> TocCache::Find(const FileTable &files, std::string_view path) const {
+        /* Bound the probe sequence in case the table was damaged and has no empty buckets left. */
+        const u32 mask = m_header->bucket_count - 1;
+        u32 bucket     = HashPath(path) & mask;
+        for (u32 probes = 0; probes < m_header->bucket_count && m_buckets[bucket] != 0; ++probes, bucket = (bucket + 1) & mask) {
+            const u32 index = m_buckets[bucket] - 1;
+            if (index >= files.GetCount()) {
+                break;
+            }
+            if (files.GetPath(index) == path) {
+                return index;
+            }
+        }
+        return std::nullopt;
+    }
+
+}
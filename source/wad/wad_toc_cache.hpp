@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2022 Valentin B.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <optional>
+#include <string_view>
+#include <system_error>
+
+#include "ptor_defines.hpp"
+#include "ptor_types.hpp"
+#include "io/io_memory_mapped.hpp"
+#include "wad/wad_file_table.hpp"
+#include "wad/wad_types.hpp"
+
+namespace ptor::wad {
+
+    class Archive;
+
+    /* A sidecar file which stores the pre-validated file table of an archive along with a hash */
+    /* index of its paths. It is mapped into memory and its columns are used in place, so       */
+    /* repeated runs over an unchanged archive neither parse its file table nor rebuild the     */
+    /* path index.                                                                               */
+    class TocCache final {
+        P_DISALLOW_COPY_AND_ASSIGN(TocCache);
+        P_DISALLOW_MOVE(TocCache);
+
+    public:
+        /* Identifies the state of an archive a cache was built from. */
+        struct Key {
+            u64 archive_size;
+            i64 archive_mtime;
+            Header header;
+        };
+
+        struct CacheHeader;
+
+    private:
+        std::optional<io::ReadOnlyMapped> m_mapped;
+        const CacheHeader *m_header;
+        FileTable::Columns m_columns;
+        const u32 *m_buckets;
+
+    public:
+        TocCache();
+
+        /* Computes the key for the archive at `path`, whose contents are at `data`. */
+        static Key MakeKey(const fs::path &path, u8 *data, size_t len, std::error_code &ec);
+
+        /* Gets the path of the cache file for the archive at `path` within `dir`. */
+        static fs::path GetCachePath(const fs::path &dir, const fs::path &path, std::error_code &ec);
+
+        /* Writes a cache for a loaded archive. The file is replaced atomically, */
+        /* so concurrent readers never observe a partially written cache.       */
+        static void Store(const fs::path &path, const Key &key, const Archive &archive, std::error_code &ec);
+
+        /* Opens the cache at `path`. Returns false if it doesn't exist, is */
+        /* malformed or was built from a different state of the archive.    */
+        bool Open(const fs::path &path, const Key &key);
+
+        P_ALWAYS_INLINE bool IsOpen() const { return m_header != nullptr; }
+
+        /* Gets the cached header of the archive. */
+        Header GetHeader() const;
+
+        /* Gets the cached columns of the file table, which live as long as the cache. */
+        P_ALWAYS_INLINE const FileTable::Columns &GetColumns() const { return m_columns; }
+
+        /* Looks up the index of a file by its archive-relative path in the cached */
+        /* index. `files` must be the table built from the cached columns.         */
+        std::optional<u32> Find(const FileTable &files, std::string_view path) const;
+    };
+
+}
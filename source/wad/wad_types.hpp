@@ -15,6 +15,8 @@
  */
 #pragma once
 
+#include <string_view>
+
 #include "ptor_types.hpp"
 
 namespace ptor::wad {
@@ -36,14 +38,14 @@ namespace ptor::wad {
         ArchiveFlags archive_flags; /* Optional; Only present in version >= 2. */
     };
 
-    /* Metadata for an archived file. */
+    /* Metadata for an archived file; the path views into the archive's file table. */
     struct File {
         u8 *content_ptr;       /* Pointer to the file contents in the archive.  */
         u32 uncompressed_size; /* The uncompressed size of the file contents.   */
         u32 compressed_size;   /* The compressed size of the file, if relevant. */
         bool compressed;       /* Whether the file contents are compressed.     */
         u32 checksum;          /* The CRC32 checksum of the file contents.      */
-        fs::path path;         /* The archive-relative path of the file.        */
+        std::string_view path; /* The archive-relative path of the file.        */
     };
 
 }